@@ -1,6 +1,7 @@
 #include "application.h"
 #include "board.h"
 #include "display.h"
+#include "display_metrics.h"
 #include "system_info.h"
 #include "audio_codec.h"
 #include "mqtt_protocol.h"
@@ -9,6 +10,8 @@
 #include "mcp_server.h"
 #include "assets.h"
 #include "settings.h"
+#include "boot_scheduler.h"
+#include "cpu_profiler.h"
 
 #include <cstring>
 #include <esp_log.h>
@@ -116,8 +119,11 @@ void Application::CheckAssetsVersion() {
 
     // Apply assets
     assets.Apply();
-    display->SetChatMessage("system", "");
-    display->SetEmotion("microchip_ai");
+    // Without a download the OTA step runs in parallel, leave the activation code and the OTA progress alone
+    if (!download_url.empty() || device_state_ == kDeviceStateStarting) {
+        display->SetChatMessage("system", "");
+        display->SetEmotion("microchip_ai");
+    }
 }
 
 void Application::CheckNewVersion(Ota& ota) {
@@ -213,7 +219,7 @@ void Application::ShowActivationCode(const std::string& code, const std::string&
         digit_sound{'9', Lang::Sounds::OGG_9}
     }};
 
-    // This sentence uses 9KB of SRAM, so we need to wait for it to finish
+    // Sounds are queued and played in order, reading the Ogg data in place
     Alert(Lang::Strings::ACTIVATION, message.c_str(), "link", Lang::Sounds::OGG_ACTIVATION);
 
     for (const auto& digit : code) {
@@ -347,6 +353,10 @@ void Application::StopListening() {
 
 void Application::Start() {
     auto& board = Board::GetInstance();
+    // The LED only shows the latest state, so the states it could not keep up with are skipped
+    DeviceStateEventManager::GetInstance().RegisterStateChangeCallback([&board](DeviceState, DeviceState) {
+        board.GetLed()->OnStateChanged();
+    }, true, "led");
     SetDeviceState(kDeviceStateStarting);
 
     /* Setup the display */
@@ -355,8 +365,22 @@ void Application::Start() {
     // Print board name/version info
     display->SetChatMessage("system", SystemInfo::GetUserAgent().c_str());
 
+#if CONFIG_USE_CPU_PROFILER
+    auto& profiler = CpuProfiler::GetInstance();
+    profiler.SetBudget("audio_input", CONFIG_CPU_PROFILER_AUDIO_INPUT_BUDGET);
+    profiler.SetBudget("opus_codec", CONFIG_CPU_PROFILER_OPUS_CODEC_BUDGET);
+    profiler.Start(CONFIG_CPU_PROFILER_PERIOD_MS);
+#endif
+
     /* Setup the audio service */
     auto codec = board.GetAudioCodec();
+#if CONFIG_USE_AUDIO_REPLAY
+    replay_codec_ = std::make_unique<ReplayAudioCodec>(CONFIG_AUDIO_REPLAY_SOURCE, CONFIG_AUDIO_REPLAY_SAMPLE_RATE,
+        CONFIG_AUDIO_REPLAY_CHANNELS, codec != nullptr ? codec->output_sample_rate() : 24000);
+    replay_codec_->SetSpeed(CONFIG_AUDIO_REPLAY_SPEED_PERCENT);
+    replay_codec_->SetLoop(CONFIG_AUDIO_REPLAY_LOOP);
+    codec = replay_codec_.get();
+#endif
     audio_service_.Initialize(codec);
     audio_service_.Start();
 
@@ -365,13 +389,27 @@ void Application::Start() {
         xEventGroupSetBits(event_group_, MAIN_EVENT_SEND_AUDIO);
     };
     callbacks.on_wake_word_detected = [this](const std::string& wake_word) {
+#if CONFIG_USE_AUDIO_REPLAY
+        replay_codec_->RecordWakeWord(wake_word);
+#endif
         xEventGroupSetBits(event_group_, MAIN_EVENT_WAKE_WORD_DETECTED);
     };
     callbacks.on_vad_change = [this](bool speaking) {
+#if CONFIG_USE_AUDIO_REPLAY
+        replay_codec_->RecordVad(speaking);
+#endif
         xEventGroupSetBits(event_group_, MAIN_EVENT_VAD_CHANGE);
     };
     audio_service_.SetCallbacks(callbacks);
 
+    // Decode the most frequently used prompt sounds in the background
+    for (const auto& sound : {Lang::Sounds::OGG_POPUP, Lang::Sounds::OGG_SUCCESS, Lang::Sounds::OGG_EXCLAMATION,
+        Lang::Sounds::OGG_VIBRATION, Lang::Sounds::OGG_0, Lang::Sounds::OGG_1, Lang::Sounds::OGG_2, Lang::Sounds::OGG_3,
+        Lang::Sounds::OGG_4, Lang::Sounds::OGG_5, Lang::Sounds::OGG_6, Lang::Sounds::OGG_7, Lang::Sounds::OGG_8,
+        Lang::Sounds::OGG_9, Lang::Sounds::OGG_ACTIVATION}) {
+        audio_service_.PreloadSound(sound);
+    }
+
     // Start the main event loop task with priority 3
     xTaskCreate([](void* arg) {
         ((Application*)arg)->MainEventLoop();
@@ -381,27 +419,49 @@ void Application::Start() {
     /* Start the clock timer to update the status bar */
     esp_timer_start_periodic(clock_timer_handle_, 1000000);
 
-    /* Wait for the network to be ready */
-    board.StartNetwork();
-
-    // Update the status bar immediately to show the network state
-    display->UpdateStatusBar(true);
-
-    // Check for new assets version
-    CheckAssetsVersion();
-
-    // Check for new firmware version or get the MQTT broker address
+    /*
+     * The local steps (assets, wake word, MCP tools) overlap with the network association and the OTA check.
+     * Downloading new assets needs the network, in which case assets are applied before the OTA check as before.
+     */
     Ota ota;
-    CheckNewVersion(ota);
+    bool assets_download_pending = !Settings("assets").GetString("download_url").empty();
+    BootScheduler boot_scheduler;
+    boot_scheduler.AddStep("network", {}, [&board, display]() {
+        board.StartNetwork();
+        // Update the status bar immediately to show the network state
+        display->UpdateStatusBar(true);
+    });
+    if (assets_download_pending) {
+        boot_scheduler.AddStep("assets", {"network"}, [this]() {
+            CheckAssetsVersion();
+        });
+        boot_scheduler.AddStep("ota", {"assets"}, [this, &ota]() {
+            CheckNewVersion(ota);
+        });
+    } else {
+        boot_scheduler.AddStep("assets", {}, [this]() {
+            CheckAssetsVersion();
+        }, 4096 * 2);
+        boot_scheduler.AddStep("ota", {"network"}, [this, &ota]() {
+            CheckNewVersion(ota);
+        });
+    }
+    // Load the wake word model without waiting for the network, detections are handled once the protocol is ready
+    boot_scheduler.AddStep("wake_word", {"assets"}, [this]() {
+        audio_service_.EnableWakeWordDetection(true);
+    }, 4096 * 2);
+    // Add MCP common tools before initializing the protocol
+    boot_scheduler.AddStep("mcp", {}, []() {
+        auto& mcp_server = McpServer::GetInstance();
+        mcp_server.AddCommonTools();
+        mcp_server.AddUserOnlyTools();
+    }, 4096);
+    boot_scheduler.Run();
+    boot_scheduler.PrintTimeline();
 
     // Initialize the protocol
     display->SetStatus(Lang::Strings::LOADING_PROTOCOL);
 
-    // Add MCP common tools before initializing the protocol
-    auto& mcp_server = McpServer::GetInstance();
-    mcp_server.AddCommonTools();
-    mcp_server.AddUserOnlyTools();
-
     if (ota.HasMqttConfig()) {
         protocol_ = std::make_unique<MqttProtocol>();
     } else if (ota.HasWebsocketConfig()) {
@@ -437,6 +497,8 @@ void Application::Start() {
             auto display = Board::GetInstance().GetDisplay();
             display->SetChatMessage("system", "");
             SetDeviceState(kDeviceStateIdle);
+            // The user is likely to continue the conversation soon
+            protocol_->Prewarm();
         });
     });
     protocol_->OnIncomingJson([this, display](const cJSON* root) {
@@ -532,6 +594,13 @@ void Application::Start() {
 
     SystemInfo::PrintHeapStats();
     SetDeviceState(kDeviceStateIdle);
+    ESP_LOGI(TAG, "Ready in %d ms since boot", int(esp_timer_get_time() / 1000));
+
+    // Wake words are handled by the main loop from now on, the one detected while booting is replayed
+    ready_ = true;
+    if (wake_word_pending_.exchange(false)) {
+        xEventGroupSetBits(event_group_, MAIN_EVENT_WAKE_WORD_DETECTED);
+    }
 
     has_server_time_ = ota.HasServerTime();
     if (protocol_started) {
@@ -540,6 +609,7 @@ void Application::Start() {
         display->SetChatMessage("system", "");
         // Play the success sound to indicate the device is ready
         audio_service_.PlaySound(Lang::Sounds::OGG_SUCCESS);
+        protocol_->Prewarm();
     }
 }
 
@@ -607,13 +677,19 @@ void Application::MainEventLoop() {
                 // SystemInfo::PrintTaskCpuUsage(pdMS_TO_TICKS(1000));
                 // SystemInfo::PrintTaskList();
                 SystemInfo::PrintHeapStats();
+                if (display->metrics()) {
+                    display->metrics()->LogSummary();
+                }
+                DeviceStateEventManager::GetInstance().PrintStatistics();
             }
         }
     }
 }
 
 void Application::OnWakeWordDetected() {
-    if (!protocol_) {
+    // Start() still sets up the protocol and the device state on another task
+    if (!ready_) {
+        wake_word_pending_ = true;
         return;
     }
 
@@ -678,8 +754,6 @@ void Application::SetDeviceState(DeviceState state) {
 
     auto& board = Board::GetInstance();
     auto display = board.GetDisplay();
-    auto led = board.GetLed();
-    led->OnStateChanged();
     switch (state) {
         case kDeviceStateUnknown:
         case kDeviceStateIdle:
@@ -697,6 +771,9 @@ void Application::SetDeviceState(DeviceState state) {
             display->SetStatus(Lang::Strings::LISTENING);
             display->SetEmotion("neutral");
 
+            // The server detects the end of speech itself in auto stop mode and needs the whole stream
+            audio_service_.EnableUplinkGate(listening_mode_ != kListeningModeAutoStop);
+
             // Make sure the audio processor is running
             if (!audio_service_.IsAudioProcessorRunning()) {
                 // Send the start listening command
@@ -10,11 +10,15 @@
 #include <mutex>
 #include <deque>
 #include <memory>
+#include <atomic>
 
 #include "protocol.h"
 #include "ota.h"
 #include "audio_service.h"
 #include "device_state_event.h"
+#if CONFIG_USE_AUDIO_REPLAY
+#include "codecs/replay_audio_codec.h"
+#endif
 
 
 #define MAIN_EVENT_SCHEDULE (1 << 0)
@@ -78,9 +82,15 @@ private:
     AecMode aec_mode_ = kAecOff;
     std::string last_error_message_;
     AudioService audio_service_;
+#if CONFIG_USE_AUDIO_REPLAY
+    std::unique_ptr<ReplayAudioCodec> replay_codec_;
+#endif
 
     bool has_server_time_ = false;
     bool aborted_ = false;
+    // Set once Start() finished booting, a wake word detected before is kept pending until then
+    std::atomic<bool> ready_ = false;
+    std::atomic<bool> wake_word_pending_ = false;
     int clock_ticks_ = 0;
     TaskHandle_t check_new_version_task_handle_ = nullptr;
     TaskHandle_t main_event_loop_task_handle_ = nullptr;
@@ -9,6 +9,7 @@
 #include <spi_flash_mmap.h>
 #include <esp_timer.h>
 #include <cbin_font.h>
+#include <cstring>
 
 
 #define TAG "Assets"
@@ -33,6 +34,39 @@ Assets::~Assets() {
     }
 }
 
+const esp_partition_t* Assets::FindRawAsset(const char* name, size_t& offset, size_t& size, int& width, int& height) {
+    auto partition = esp_partition_find_first(ESP_PARTITION_TYPE_ANY, ESP_PARTITION_SUBTYPE_ANY, "assets");
+    if (partition == nullptr) {
+        return nullptr;
+    }
+
+    uint32_t stored_files = 0;
+    if (esp_partition_read(partition, 0, &stored_files, sizeof(stored_files)) != ESP_OK ||
+        12 + stored_files * sizeof(mmap_assets_table) > partition->size) {
+        return nullptr;
+    }
+
+    size_t data_offset = 12 + sizeof(mmap_assets_table) * stored_files;
+    for (uint32_t i = 0; i < stored_files; i++) {
+        mmap_assets_table item;
+        if (esp_partition_read(partition, 12 + i * sizeof(mmap_assets_table), &item, sizeof(item)) != ESP_OK) {
+            return nullptr;
+        }
+        if (strncmp(item.asset_name, name, sizeof(item.asset_name)) != 0) {
+            continue;
+        }
+        if (data_offset + item.asset_offset + item.asset_size > partition->size) {
+            return nullptr;
+        }
+        offset = data_offset + item.asset_offset;
+        size = item.asset_size;
+        width = item.asset_width;
+        height = item.asset_height;
+        return partition;
+    }
+    return nullptr;
+}
+
 uint32_t Assets::CalculateChecksum(const char* data, uint32_t length) {
     uint32_t checksum = 0;
     for (uint32_t i = 0; i < length; i++) {
@@ -127,16 +161,18 @@ bool Assets::Apply() {
     if (cJSON_IsString(srmodels)) {
         std::string srmodels_file = srmodels->valuestring;
         if (GetAssetData(srmodels_file, ptr, size)) {
-            if (models_list_ != nullptr) {
-                esp_srmodel_deinit(models_list_);
-                models_list_ = nullptr;
-            }
+            // The old models are freed after the wake word engines using them are replaced
+            auto old_models_list = models_list_;
             models_list_ = srmodel_load(static_cast<uint8_t*>(ptr));
-            if (models_list_ != nullptr) {
+            if (models_list_ == nullptr) {
+                ESP_LOGE(TAG, "Failed to load srmodels.bin");
+            }
+            if (models_list_ != nullptr || old_models_list != nullptr) {
                 auto& app = Application::GetInstance();
                 app.GetAudioService().SetModelsList(models_list_);
-            } else {
-                ESP_LOGE(TAG, "Failed to load srmodels.bin");
+            }
+            if (old_models_list != nullptr) {
+                esp_srmodel_deinit(old_models_list);
             }
         } else {
             ESP_LOGE(TAG, "The srmodels file %s is not found", srmodels_file.c_str());
@@ -157,6 +193,7 @@ bool Assets::Apply() {
                 ESP_LOGE(TAG, "Failed to load fonts.bin");
                 return false;
             }
+            text_font->EnableGlyphCache();
             if (light_theme != nullptr) {
                 light_theme->set_text_font(text_font);
             }
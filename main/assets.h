@@ -27,6 +27,10 @@ public:
     bool Apply();
     bool GetAssetData(const std::string& name, void*& ptr, size_t& size);
 
+    // Locate an asset by reading the partition table directly, without mapping the partition or verifying
+    // the checksum, so that it can be used before the assets are loaded (e.g. for the boot splash)
+    static const esp_partition_t* FindRawAsset(const char* name, size_t& offset, size_t& size, int& width, int& height);
+
     inline bool partition_valid() const { return partition_valid_; }
     inline bool checksum_valid() const { return checksum_valid_; }
     inline std::string default_assets_url() const { return default_assets_url_; }
@@ -3,6 +3,7 @@
 #include "settings.h"
 
 #include <esp_log.h>
+#include <esp_timer.h>
 #include <cstring>
 #include <driver/i2s_common.h>
 
@@ -15,17 +16,90 @@ AudioCodec::~AudioCodec() {
 }
 
 void AudioCodec::OutputData(std::vector<int16_t>& data) {
+    // The silence the DMA sent while there was no data counts as written, so an underrun is only seen once
+    portENTER_CRITICAL(&position_lock_);
+    bool sent_events = output_sent_time_us_ != 0;
+    uint64_t sent_frames = output_sent_frames_;
+    portEXIT_CRITICAL(&position_lock_);
+    if (sent_events && sent_frames > output_written_frames_) {
+        output_written_frames_ = sent_frames;
+    }
     Write(data.data(), data.size());
+    output_written_frames_ += data.size();
 }
 
 bool AudioCodec::InputData(std::vector<int16_t>& data) {
     int samples = Read(data.data(), data.size());
     if (samples > 0) {
+        input_read_frames_ += samples / input_channels_;
         return true;
     }
     return false;
 }
 
+bool IRAM_ATTR AudioCodec::OnOutputSent(i2s_chan_handle_t handle, i2s_event_data_t* event, void* user_ctx) {
+    auto codec = static_cast<AudioCodec*>(user_ctx);
+    portENTER_CRITICAL_ISR(&codec->position_lock_);
+    codec->output_sent_frames_ += AUDIO_CODEC_DMA_FRAME_NUM;
+    codec->output_sent_time_us_ = esp_timer_get_time();
+    portEXIT_CRITICAL_ISR(&codec->position_lock_);
+    if (codec->callback_io_) {
+        return codec->OnOutputBufferSent(event->dma_buf, event->size);
+    }
+    return false;
+}
+
+bool IRAM_ATTR AudioCodec::OnInputReceived(i2s_chan_handle_t handle, i2s_event_data_t* event, void* user_ctx) {
+    auto codec = static_cast<AudioCodec*>(user_ctx);
+    portENTER_CRITICAL_ISR(&codec->position_lock_);
+    codec->input_received_frames_ += AUDIO_CODEC_DMA_FRAME_NUM;
+    codec->input_received_time_us_ = esp_timer_get_time();
+    portEXIT_CRITICAL_ISR(&codec->position_lock_);
+    if (codec->callback_io_) {
+        return codec->OnInputBufferReceived(event->dma_buf, event->size);
+    }
+    return false;
+}
+
+void AudioCodec::GetOutputPosition(uint64_t& sent_frames, int64_t& time_us) {
+    portENTER_CRITICAL(&position_lock_);
+    sent_frames = output_sent_frames_;
+    time_us = output_sent_time_us_;
+    portEXIT_CRITICAL(&position_lock_);
+    if (time_us == 0) {
+        uint64_t depth = AUDIO_CODEC_DMA_DESC_NUM * AUDIO_CODEC_DMA_FRAME_NUM;
+        sent_frames = output_written_frames_ > depth ? output_written_frames_ - depth : 0;
+        time_us = esp_timer_get_time();
+    }
+}
+
+bool AudioCodec::OutputUnderrun() {
+    portENTER_CRITICAL(&position_lock_);
+    uint64_t sent_frames = output_sent_frames_;
+    int64_t time_us = output_sent_time_us_;
+    portEXIT_CRITICAL(&position_lock_);
+    return time_us != 0 && sent_frames > output_written_frames_;
+}
+
+int64_t AudioCodec::GetInputCaptureTime() {
+    portENTER_CRITICAL(&position_lock_);
+    uint64_t received_frames = input_received_frames_;
+    int64_t time_us = input_received_time_us_;
+    portEXIT_CRITICAL(&position_lock_);
+    if (time_us == 0) {
+        return esp_timer_get_time();
+    }
+
+    // Frames received but not read yet were captured before the last DMA event
+    uint64_t depth = AUDIO_CODEC_DMA_DESC_NUM * AUDIO_CODEC_DMA_FRAME_NUM + input_buffer_frames_;
+    if (received_frames > input_read_frames_ + depth) {
+        // The buffers overflowed and frames were dropped
+        input_read_frames_ = received_frames - depth;
+    }
+    int64_t backlog = received_frames > input_read_frames_ ? received_frames - input_read_frames_ : 0;
+    return time_us - backlog * 1000000 / input_sample_rate_;
+}
+
 void AudioCodec::Start() {
     Settings settings("audio", false);
     output_volume_ = settings.GetInt("output_volume", output_volume_);
@@ -34,6 +108,24 @@ void AudioCodec::Start() {
         output_volume_ = 10;
     }
 
+    /* Follow the DMA, so the uplink can be aligned with what is being played and output underruns are seen,
+       or move the audio in its callbacks */
+#if CONFIG_USE_SERVER_AEC || CONFIG_USE_CPU_PROFILER
+    bool dma_events = true;
+#else
+    bool dma_events = callback_io_;
+#endif
+    if (dma_events && tx_handle_ != nullptr) {
+        i2s_event_callbacks_t callbacks = {};
+        callbacks.on_sent = OnOutputSent;
+        ESP_ERROR_CHECK_WITHOUT_ABORT(i2s_channel_register_event_callback(tx_handle_, &callbacks, this));
+    }
+    if (dma_events && rx_handle_ != nullptr) {
+        i2s_event_callbacks_t callbacks = {};
+        callbacks.on_recv = OnInputReceived;
+        ESP_ERROR_CHECK_WITHOUT_ABORT(i2s_channel_register_event_callback(rx_handle_, &callbacks, this));
+    }
+
     if (tx_handle_ != nullptr) {
         ESP_ERROR_CHECK(i2s_channel_enable(tx_handle_));
     }
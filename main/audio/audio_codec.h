@@ -25,9 +25,21 @@ public:
     virtual void EnableOutput(bool enable);
 
     virtual void OutputData(std::vector<int16_t>& data);
+    // Drop the output buffered ahead of the DMA, when playback is aborted
+    virtual void FlushOutput() {}
     virtual bool InputData(std::vector<int16_t>& data);
     virtual void Start();
 
+    // Output frames sent by the I2S DMA and the time the last buffer was sent, used to align server AEC.
+    // Without DMA events, the frames written minus the DMA buffer depth at the current time
+    void GetOutputPosition(uint64_t& sent_frames, int64_t& time_us);
+    // Capture time of the last sample returned by InputData
+    int64_t GetInputCaptureTime();
+    // Whether the DMA sent more frames than were written since the last OutputData, i.e. the speaker
+    // played silence for lack of data. Always false without DMA events, which are followed with server AEC,
+    // the CPU profiler or callback I/O
+    bool OutputUnderrun();
+
     inline bool duplex() const { return duplex_; }
     inline bool input_reference() const { return input_reference_; }
     inline int input_sample_rate() const { return input_sample_rate_; }
@@ -38,6 +50,11 @@ public:
     inline float input_gain() const { return input_gain_; }
     inline bool input_enabled() const { return input_enabled_; }
     inline bool output_enabled() const { return output_enabled_; }
+    // Silent frames the DMA sends before data written after an underrun starts playing. Blocking writes
+    // wait for the next free buffer, callback I/O refills the buffer just sent, queued behind the others
+    inline size_t output_underrun_frames() const {
+        return callback_io_ ? (AUDIO_CODEC_DMA_DESC_NUM - 1) * AUDIO_CODEC_DMA_FRAME_NUM : AUDIO_CODEC_DMA_FRAME_NUM;
+    }
 
 protected:
     i2s_chan_handle_t tx_handle_ = nullptr;
@@ -56,6 +73,27 @@ protected:
 
     virtual int Read(int16_t* dest, int samples) = 0;
     virtual int Write(const int16_t* data, int samples) = 0;
+
+    // With callback I/O the codec fills each sent DMA buffer and consumes each received one
+    // from the I2S interrupt, return true if a higher priority task was woken
+    bool callback_io_ = false;
+    // Input frames the codec can buffer beyond the DMA buffers
+    size_t input_buffer_frames_ = 0;
+    virtual bool OnOutputBufferSent(void* dma_buf, size_t size) { return false; }
+    virtual bool OnInputBufferReceived(void* dma_buf, size_t size) { return false; }
+
+private:
+    // Updated from the I2S interrupts
+    portMUX_TYPE position_lock_ = portMUX_INITIALIZER_UNLOCKED;
+    uint64_t output_sent_frames_ = 0;
+    int64_t output_sent_time_us_ = 0;
+    uint64_t input_received_frames_ = 0;
+    int64_t input_received_time_us_ = 0;
+    uint64_t output_written_frames_ = 0;
+    uint64_t input_read_frames_ = 0;
+
+    static bool OnOutputSent(i2s_chan_handle_t handle, i2s_event_data_t* event, void* user_ctx);
+    static bool OnInputReceived(i2s_chan_handle_t handle, i2s_event_data_t* event, void* user_ctx);
 };
 
 #endif // _AUDIO_CODEC_H
@@ -0,0 +1,40 @@
+#ifndef AUDIO_FRAME_H
+#define AUDIO_FRAME_H
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+
+/*
+ * A view of interleaved 16-bit PCM owned by the caller, e.g. the input buffer the audio service reads
+ * every frame into. It is only valid during the call it is passed to, keep a copy to use it later.
+ * Channel 0 is the microphone, a second channel is the playback reference.
+ */
+struct AudioFrame {
+    const int16_t* data = nullptr;
+    size_t frames = 0;      // Samples per channel
+    int channels = 1;
+
+    AudioFrame() = default;
+    AudioFrame(const int16_t* data, size_t samples, int channels)
+        : data(data), frames(samples / channels), channels(channels) {}
+    AudioFrame(const std::vector<int16_t>& pcm, int channels)
+        : AudioFrame(pcm.data(), pcm.size(), channels) {}
+
+    inline size_t samples() const { return frames * channels; }
+
+    // The microphone channel as contiguous samples, only copied into `buffer` when interleaved
+    const int16_t* Mic(std::vector<int16_t>& buffer) const {
+        if (channels == 1) {
+            return data;
+        }
+        buffer.resize(frames);
+        for (size_t i = 0, j = 0; i < frames; ++i, j += channels) {
+            buffer[i] = data[j];
+        }
+        return buffer.data();
+    }
+};
+
+#endif // AUDIO_FRAME_H
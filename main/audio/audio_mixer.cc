@@ -0,0 +1,111 @@
+#include "audio_mixer.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+#define UNITY_GAIN 32768
+#define FADE_MS 5
+#define DUCKING_RAMP_MS 50
+// The limiter gain recovers to unity over this time once the sum is back within full scale
+#define LIMITER_RELEASE_MS 100
+
+
+static inline int32_t PercentToGain(int percent) {
+    return std::clamp(percent, 0, 200) * UNITY_GAIN / 100;
+}
+
+AudioMixer::AudioMixer() {
+    Configure(16000);
+}
+
+void AudioMixer::Configure(int sample_rate) {
+    fade_step_ = std::max(1, UNITY_GAIN / (sample_rate * FADE_MS / 1000));
+    ducking_step_ = std::max(1, UNITY_GAIN / (sample_rate * DUCKING_RAMP_MS / 1000));
+    release_step_ = std::max(1, UNITY_GAIN / (sample_rate * LIMITER_RELEASE_MS / 1000));
+}
+
+void AudioMixer::SetGain(MixerStream stream, int percent) {
+    streams_[stream].gain = PercentToGain(percent);
+}
+
+void AudioMixer::SetDuckingLevel(int percent) {
+    ducking_level_ = std::min(PercentToGain(percent), UNITY_GAIN);
+}
+
+void AudioMixer::Restart(MixerStream stream) {
+    streams_[stream].restart = true;
+}
+
+void AudioMixer::SetInput(MixerStream stream, const int16_t* pcm, size_t samples) {
+    streams_[stream].input = pcm;
+    streams_[stream].samples = samples;
+}
+
+void AudioMixer::Mix(int16_t* output, size_t samples) {
+    bool ducking = streams_[kMixerStreamAlert].input != nullptr && streams_[kMixerStreamAlert].samples > 0;
+    for (int i = 0; i < kMixerStreamCount; i++) {
+        auto& stream = streams_[i];
+        if (stream.input == nullptr) {
+            // Idle streams fade in when they come back
+            stream.active = false;
+            stream.level = 0;
+            continue;
+        }
+        int32_t target = stream.gain;
+        if (i == kMixerStreamSpeech && ducking) {
+            target = target * ducking_level_ / UNITY_GAIN;
+        }
+        if (stream.restart.exchange(false) || !stream.active) {
+            stream.active = true;
+            stream.level = 0;
+            stream.step = fade_step_;
+        } else if (target != stream.target) {
+            stream.step = ducking_step_;
+        }
+        stream.target = target;
+    }
+
+    for (size_t n = 0; n < samples; n++) {
+        int32_t sum = 0;
+        for (auto& stream : streams_) {
+            if (stream.input == nullptr) {
+                continue;
+            }
+            if (n < stream.samples) {
+                sum += (int32_t(stream.input[n]) * stream.level) >> 15;
+            }
+            if (stream.level < stream.target) {
+                stream.level = std::min(stream.level + stream.step, stream.target);
+            } else if (stream.level > stream.target) {
+                stream.level = std::max(stream.level - stream.step, stream.target);
+            }
+        }
+        output[n] = Limit(sum);
+    }
+
+    for (auto& stream : streams_) {
+        stream.input = nullptr;
+        stream.samples = 0;
+    }
+}
+
+int16_t AudioMixer::Limit(int32_t sample) {
+    // Attack at once so the sample fits full scale, release slowly, unity gain passes the sum unchanged
+    int32_t magnitude = std::abs(sample);
+    if (magnitude > INT16_MAX) {
+        limiter_gain_ = std::min(limiter_gain_, int32_t(int64_t(INT16_MAX) * UNITY_GAIN / magnitude));
+    }
+    if (limiter_gain_ < UNITY_GAIN) {
+        sample = int32_t((int64_t(sample) * limiter_gain_) >> 15);
+        limiter_gain_ = std::min(limiter_gain_ + release_step_, UNITY_GAIN);
+    }
+    return std::clamp(sample, -INT16_MAX, int32_t(INT16_MAX));
+}
+
+void AudioMixer::FadeOut(std::vector<int16_t>& pcm, size_t samples) {
+    samples = std::min(samples, pcm.size());
+    for (size_t i = 0; i < samples; i++) {
+        pcm[i] = int32_t(pcm[i]) * int32_t(samples - i) / int32_t(samples);
+    }
+    pcm.resize(samples);
+}
@@ -0,0 +1,63 @@
+#ifndef AUDIO_MIXER_H
+#define AUDIO_MIXER_H
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <atomic>
+
+
+enum MixerStream {
+    kMixerStreamSpeech,
+    kMixerStreamAlert,
+    kMixerStreamCount,
+};
+
+/*
+ * Fixed-point mixer for the playback streams, run once per output frame.
+ * Each stream has its own gain, the speech is ducked while an alert plays, a stream fades in when it starts
+ * (after being idle or restarted) and a gain-envelope limiter pulls the sum back under full scale instead of
+ * hard clipping. The limiter only engages when the sum exceeds full scale, otherwise samples pass unchanged.
+ * Gains are ramped per sample, so changes do not click. Mixing does not allocate.
+ */
+class AudioMixer {
+public:
+    AudioMixer();
+
+    void Configure(int sample_rate);
+    void SetGain(MixerStream stream, int percent);
+    void SetDuckingLevel(int percent);
+    // Fade the stream in again at its next frame, may be called from another task
+    void Restart(MixerStream stream);
+
+    // Inputs for the next Mix call, streams without input are idle in that frame
+    void SetInput(MixerStream stream, const int16_t* pcm, size_t samples);
+    // `output` may be one of the inputs
+    void Mix(int16_t* output, size_t samples);
+
+    // Fade `pcm` out over its first `samples` and drop the rest
+    static void FadeOut(std::vector<int16_t>& pcm, size_t samples);
+
+private:
+    struct Stream {
+        const int16_t* input = nullptr;
+        size_t samples = 0;
+        int32_t gain = 32768;   // Q15
+        int32_t target = 0;     // Q15, gain after ducking
+        int32_t level = 0;      // Q15, ramps towards the target
+        int32_t step = 0;
+        bool active = false;
+        std::atomic<bool> restart = false;
+    };
+
+    int16_t Limit(int32_t sample);
+
+    Stream streams_[kMixerStreamCount];
+    int32_t ducking_level_ = 32768;
+    int32_t fade_step_ = 1;
+    int32_t ducking_step_ = 1;
+    int32_t limiter_gain_ = 32768;  // Q15
+    int32_t release_step_ = 1;
+};
+
+#endif // AUDIO_MIXER_H
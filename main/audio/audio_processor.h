@@ -7,13 +7,15 @@
 
 #include <model_path.h>
 #include "audio_codec.h"
+#include "audio_frame.h"
 
 class AudioProcessor {
 public:
     virtual ~AudioProcessor() = default;
     
     virtual void Initialize(AudioCodec* codec, int frame_duration_ms, srmodel_list_t* models_list) = 0;
-    virtual void Feed(std::vector<int16_t>&& data) = 0;
+    // The frame is interleaved like the codec input, at 16 kHz
+    virtual void Feed(const AudioFrame& frame) = 0;
     virtual void Start() = 0;
     virtual void Stop() = 0;
     virtual bool IsRunning() = 0;
@@ -1,6 +1,11 @@
 #include "audio_service.h"
+#include "memory_accounting.h"
+#include "cpu_profiler.h"
+#include "settings.h"
 #include <esp_log.h>
 #include <cstring>
+#include <algorithm>
+#include <cstdlib>
 
 #if CONFIG_USE_AUDIO_PROCESSOR
 #include "processors/afe_audio_processor.h"
@@ -17,6 +22,8 @@
 
 #define TAG "AudioService"
 
+static const char* const kWakeWordEngineNames[kWakeWordEngineCount] = {"wakenet", "multinet"};
+
 
 AudioService::AudioService() {
     event_group_ = xEventGroupCreate();
@@ -26,6 +33,10 @@ AudioService::~AudioService() {
     if (event_group_ != nullptr) {
         vEventGroupDelete(event_group_);
     }
+    if (opus_encoder_ != nullptr) {
+        MemoryAccounting::Release(kMemoryTagOpus, opus_encoder_);
+        opus_encoder_destroy(opus_encoder_);
+    }
 }
 
 
@@ -35,8 +46,46 @@ void AudioService::Initialize(AudioCodec* codec) {
 
     /* Setup the audio codec */
     opus_decoder_ = std::make_unique<OpusDecoderWrapper>(codec->output_sample_rate(), 1, OPUS_FRAME_DURATION_MS);
-    opus_encoder_ = std::make_unique<OpusEncoderWrapper>(16000, 1, OPUS_FRAME_DURATION_MS);
-    opus_encoder_->SetComplexity(0);
+    int error = 0;
+    opus_encoder_ = opus_encoder_create(16000, 1, OPUS_APPLICATION_VOIP, &error);
+    if (opus_encoder_ == nullptr) {
+        ESP_LOGE(TAG, "Failed to create opus encoder: %d", error);
+    } else {
+        MemoryAccounting::Record(kMemoryTagOpus, opus_encoder_);
+        ApplyEncoderProfile(OpusEncoderProfile());
+    }
+#if CONFIG_USE_ADAPTIVE_OPUS_ENCODER
+    encoder_controller_ = std::make_unique<OpusEncoderController>(CONFIG_OPUS_ENCODER_MAX_COMPLEXITY,
+        CONFIG_OPUS_ENCODER_FRAME_DURATION_MS);
+#endif
+
+#if CONFIG_USE_SOUND_CACHE
+#if CONFIG_SOUND_CACHE_ADPCM
+    sound_cache_ = std::make_unique<SoundCache>(CONFIG_SOUND_CACHE_SIZE_KB * 1024, true);
+#else
+    sound_cache_ = std::make_unique<SoundCache>(CONFIG_SOUND_CACHE_SIZE_KB * 1024, false);
+#endif
+#endif
+
+    aec_aligner_.Configure(codec->output_sample_rate(), 16000, codec->output_underrun_frames());
+
+#if CONFIG_USE_WAKE_WORD_ENERGY_GATE
+    // The wake word is fed interleaved frames, the gate counts the samples of all channels
+    wake_word_gate_.Configure(16000 * codec->input_channels(), CONFIG_WAKE_WORD_GATE_HANGOVER_MS, CONFIG_WAKE_WORD_GATE_PREROLL_MS, 0);
+    wake_word_gate_.SetEnabled(true);
+    // Frames move between the pre-roll and the detector, their buffers are reused for the next reads
+    wake_word_gate_.KeepSpareBuffers(2);
+#endif
+
+#if CONFIG_USE_UPLINK_VAD_GATE
+    uplink_gate_.Configure(16000, CONFIG_UPLINK_VAD_HANGOVER_MS, CONFIG_UPLINK_VAD_PREROLL_MS,
+        CONFIG_UPLINK_COMFORT_NOISE_INTERVAL_MS);
+#endif
+
+    mixer_.Configure(codec->output_sample_rate());
+    mixer_.SetGain(kMixerStreamSpeech, CONFIG_AUDIO_SPEECH_GAIN_PERCENT);
+    mixer_.SetGain(kMixerStreamAlert, CONFIG_AUDIO_ALERT_GAIN_PERCENT);
+    mixer_.SetDuckingLevel(CONFIG_AUDIO_DUCKING_PERCENT);
 
     if (codec->input_sample_rate() != 16000) {
         input_resampler_.Configure(codec->input_sample_rate(), 16000);
@@ -49,7 +98,14 @@ void AudioService::Initialize(AudioCodec* codec) {
     audio_processor_ = std::make_unique<NoAudioProcessor>();
 #endif
 
+#if CONFIG_USE_AUDIO_DEBUGGER
+    audio_debugger_ = std::make_unique<AudioDebugger>();
+#endif
+
     audio_processor_->OnOutput([this](std::vector<int16_t>&& data) {
+#if CONFIG_USE_AUDIO_DEBUGGER
+        audio_debugger_->Feed(kAudioDebugTapAfe, data, 16000, 1);
+#endif
         PushTaskToEncodeQueue(kAudioTaskTypeEncodeToSendQueue, std::move(data));
     });
 
@@ -129,6 +185,8 @@ void AudioService::Stop() {
     audio_decode_queue_.clear();
     audio_playback_queue_.clear();
     audio_testing_queue_.clear();
+    sound_queue_.clear();
+    preload_queue_.clear();
     audio_queue_cv_.notify_all();
 }
 
@@ -140,30 +198,27 @@ bool AudioService::ReadAudioData(std::vector<int16_t>& data, int sample_rate, in
     }
 
     if (codec_->input_sample_rate() != sample_rate) {
-        data.resize(samples * codec_->input_sample_rate() / sample_rate * codec_->input_channels());
-        if (!codec_->InputData(data)) {
+        /* Read and resample through buffers kept across calls, the input task runs this every few milliseconds */
+        input_pcm_.resize(samples * codec_->input_sample_rate() / sample_rate * codec_->input_channels());
+        if (!codec_->InputData(input_pcm_)) {
             return false;
         }
         if (codec_->input_channels() == 2) {
-            auto mic_channel = std::vector<int16_t>(data.size() / 2);
-            auto reference_channel = std::vector<int16_t>(data.size() / 2);
-            for (size_t i = 0, j = 0; i < mic_channel.size(); ++i, j += 2) {
-                mic_channel[i] = data[j];
-                reference_channel[i] = data[j + 1];
+            input_mic_pcm_.resize(input_pcm_.size() / 2);
+            input_reference_pcm_.resize(input_pcm_.size() / 2);
+            for (size_t i = 0, j = 0; i < input_mic_pcm_.size(); ++i, j += 2) {
+                input_mic_pcm_[i] = input_pcm_[j];
+                input_reference_pcm_[i] = input_pcm_[j + 1];
             }
-            auto resampled_mic = std::vector<int16_t>(input_resampler_.GetOutputSamples(mic_channel.size()));
-            auto resampled_reference = std::vector<int16_t>(reference_resampler_.GetOutputSamples(reference_channel.size()));
-            input_resampler_.Process(mic_channel.data(), mic_channel.size(), resampled_mic.data());
-            reference_resampler_.Process(reference_channel.data(), reference_channel.size(), resampled_reference.data());
-            data.resize(resampled_mic.size() + resampled_reference.size());
-            for (size_t i = 0, j = 0; i < resampled_mic.size(); ++i, j += 2) {
-                data[j] = resampled_mic[i];
-                data[j + 1] = resampled_reference[i];
+            input_resampler_.Process(input_mic_pcm_.data(), input_mic_pcm_.size(), resampled_mic_pcm_);
+            reference_resampler_.Process(input_reference_pcm_.data(), input_reference_pcm_.size(), resampled_reference_pcm_);
+            data.resize(resampled_mic_pcm_.size() * 2);
+            for (size_t i = 0, j = 0; i < resampled_mic_pcm_.size(); ++i, j += 2) {
+                data[j] = resampled_mic_pcm_[i];
+                data[j + 1] = resampled_reference_pcm_[i];
             }
         } else {
-            auto resampled = std::vector<int16_t>(input_resampler_.GetOutputSamples(data.size()));
-            input_resampler_.Process(data.data(), data.size(), resampled.data());
-            data = std::move(resampled);
+            input_resampler_.Process(input_pcm_.data(), input_pcm_.size(), data);
         }
     } else {
         data.resize(samples * codec_->input_channels());
@@ -178,10 +233,7 @@ bool AudioService::ReadAudioData(std::vector<int16_t>& data, int sample_rate, in
 
 #if CONFIG_USE_AUDIO_DEBUGGER
     // 音频调试：发送原始音频数据
-    if (audio_debugger_ == nullptr) {
-        audio_debugger_ = std::make_unique<AudioDebugger>();
-    }
-    audio_debugger_->Feed(data);
+    audio_debugger_->Feed(kAudioDebugTapMic, data, sample_rate, codec_->input_channels());
 #endif
 
     return true;
@@ -227,11 +279,25 @@ void AudioService::AudioInputTask() {
 
         /* Feed the wake word */
         if (bits & AS_EVENT_WAKE_WORD_RUNNING) {
-            std::vector<int16_t> data;
-            int samples = wake_word_->GetFeedSize();
+            WakeWord* wake_word = nullptr;
+            int samples = 0;
+            {
+                std::lock_guard<std::mutex> lock(wake_word_mutex_);
+                wake_word = wake_word_;
+                samples = wake_word != nullptr ? wake_word->GetFeedSize() : 0;
+            }
+            if (wake_word == nullptr) {
+                /* Switched off by SetWakeWordEngine in the meantime */
+                continue;
+            }
+            /* The mutex is only held to feed, SetWakeWordEngine does not wait for the microphone */
             if (samples > 0) {
-                if (ReadAudioData(data, 16000, samples)) {
-                    wake_word_->Feed(data);
+                if (ReadAudioData(input_data_, 16000, samples)) {
+                    std::lock_guard<std::mutex> lock(wake_word_mutex_);
+                    /* The engine may have been switched in the meantime, it is fed only frames of its size */
+                    if (wake_word_ != nullptr && wake_word_->GetFeedSize() == samples) {
+                        FeedWakeWord(AudioFrame(input_data_, codec_->input_channels()));
+                    }
                     continue;
                 }
             }
@@ -239,11 +305,13 @@ void AudioService::AudioInputTask() {
 
         /* Feed the audio processor */
         if (bits & AS_EVENT_AUDIO_PROCESSOR_RUNNING) {
-            std::vector<int16_t> data;
             int samples = audio_processor_->GetFeedSize();
             if (samples > 0) {
-                if (ReadAudioData(data, 16000, samples)) {
-                    audio_processor_->Feed(std::move(data));
+                if (ReadAudioData(input_data_, 16000, samples)) {
+#if CONFIG_USE_SERVER_AEC
+                    aec_aligner_.RecordInput(samples, codec_->GetInputCaptureTime());
+#endif
+                    audio_processor_->Feed(AudioFrame(input_data_, codec_->input_channels()));
                     continue;
                 }
             }
@@ -259,6 +327,15 @@ void AudioService::AudioInputTask() {
 void AudioService::AudioOutputTask() {
     while (true) {
         std::unique_lock<std::mutex> lock(audio_queue_mutex_);
+#if CONFIG_USE_CPU_PROFILER
+        bool decode_pending = false;
+#endif
+        if (audio_playback_queue_.empty()) {
+            output_level_ = 0;
+#if CONFIG_USE_CPU_PROFILER
+            decode_pending = !audio_decode_queue_.empty();
+#endif
+        }
         audio_queue_cv_.wait(lock, [this]() { return !audio_playback_queue_.empty() || service_stopped_; });
         if (service_stopped_) {
             break;
@@ -274,6 +351,20 @@ void AudioService::AudioOutputTask() {
             esp_timer_start_periodic(audio_power_timer_, AUDIO_POWER_CHECK_INTERVAL_MS * 1000);
             codec_->EnableOutput(true);
         }
+#if CONFIG_USE_SERVER_AEC
+        size_t frames = task->pcm.size();
+        uint64_t sent_frames;
+        int64_t sent_time_us;
+        codec_->GetOutputPosition(sent_frames, sent_time_us);
+        aec_aligner_.UpdateOutputPosition(sent_frames, sent_time_us);
+#endif
+#if CONFIG_USE_CPU_PROFILER
+        /* The codec task did not decode the next frame before the speaker ran out of data */
+        if (decode_pending && codec_->OutputUnderrun()) {
+            CpuProfiler::GetInstance().ReportDeadlineMiss("opus_codec");
+        }
+#endif
+        output_level_ = GetPcmLevel(task->pcm);
         codec_->OutputData(task->pcm);
 
         /* Update the last output time */
@@ -281,11 +372,8 @@ void AudioService::AudioOutputTask() {
         debug_statistics_.playback_count++;
 
 #if CONFIG_USE_SERVER_AEC
-        /* Record the timestamp for server AEC */
-        if (task->timestamp > 0) {
-            lock.lock();
-            timestamp_queue_.push_back(task->timestamp);
-        }
+        /* Record which output frames carry the timestamp for server AEC */
+        aec_aligner_.RecordOutput(frames, task->timestamp);
 #endif
     }
 
@@ -297,8 +385,9 @@ void AudioService::OpusCodecTask() {
         std::unique_lock<std::mutex> lock(audio_queue_mutex_);
         audio_queue_cv_.wait(lock, [this]() {
             return service_stopped_ ||
-                (!audio_encode_queue_.empty() && audio_send_queue_.size() < MAX_SEND_PACKETS_IN_QUEUE) ||
-                (!audio_decode_queue_.empty() && audio_playback_queue_.size() < MAX_PLAYBACK_TASKS_IN_QUEUE);
+                (!audio_encode_queue_.empty() && audio_send_queue_.size() < MaxSendPackets()) ||
+                ((!audio_decode_queue_.empty() || HasPendingSound()) && audio_playback_queue_.size() < MAX_PLAYBACK_TASKS_IN_QUEUE) ||
+                (!preload_queue_.empty() && audio_decode_queue_.empty() && !HasPendingSound());
         });
         if (service_stopped_) {
             break;
@@ -308,6 +397,7 @@ void AudioService::OpusCodecTask() {
         if (!audio_decode_queue_.empty() && audio_playback_queue_.size() < MAX_PLAYBACK_TASKS_IN_QUEUE) {
             auto packet = std::move(audio_decode_queue_.front());
             audio_decode_queue_.pop_front();
+            bool mix_sound = HasPendingSound();
             audio_queue_cv_.notify_all();
             lock.unlock();
 
@@ -316,13 +406,20 @@ void AudioService::OpusCodecTask() {
             task->timestamp = packet->timestamp;
 
             SetDecodeSampleRate(packet->sample_rate, packet->frame_duration);
-            if (opus_decoder_->Decode(std::move(packet->payload), task->pcm)) {
-                // Resample if the sample rate is different
-                if (opus_decoder_->sample_rate() != codec_->output_sample_rate()) {
-                    int target_size = output_resampler_.GetOutputSamples(task->pcm.size());
-                    std::vector<int16_t> resampled(target_size);
-                    output_resampler_.Process(task->pcm.data(), task->pcm.size(), resampled.data());
-                    task->pcm = std::move(resampled);
+            // Decode into a reused buffer when the PCM is resampled into the task afterwards
+            bool resample = opus_decoder_->sample_rate() != codec_->output_sample_rate();
+            auto& decoded = resample ? decode_pcm_ : task->pcm;
+            if (opus_decoder_->Decode(std::move(packet->payload), decoded)) {
+                if (resample) {
+                    output_resampler_.Process(decoded.data(), decoded.size(), task->pcm);
+                }
+#if CONFIG_USE_AUDIO_DEBUGGER
+                audio_debugger_->Feed(kAudioDebugTapDownlink, task->pcm, codec_->output_sample_rate(), 1);
+#endif
+                /* Notification sounds are mixed over the speech */
+                MixPlayback(task->pcm, mix_sound);
+                if (mix_sound) {
+                    sound_active_ = current_sound_ || !sound_pcm_.empty();
                 }
 
                 lock.lock();
@@ -333,42 +430,132 @@ void AudioService::OpusCodecTask() {
                 lock.lock();
             }
             debug_statistics_.decode_count++;
+        } else if (HasPendingSound() && audio_playback_queue_.size() < MAX_PLAYBACK_TASKS_IN_QUEUE) {
+            /* Play the sound on its own when there is no speech to mix with */
+            lock.unlock();
+            if (sound_pcm_.empty()) {
+                DecodeSoundPacket();
+            }
+            if (!sound_pcm_.empty()) {
+                auto task = std::make_unique<AudioTask>();
+                task->type = kAudioTaskTypeDecodeToPlaybackQueue;
+                task->pcm = std::move(sound_pcm_);
+                sound_pcm_.clear();
+                mixer_.SetInput(kMixerStreamAlert, task->pcm.data(), task->pcm.size());
+                mixer_.Mix(task->pcm.data(), task->pcm.size());
+                lock.lock();
+                audio_playback_queue_.push_back(std::move(task));
+                audio_queue_cv_.notify_all();
+            } else {
+                lock.lock();
+            }
+            sound_active_ = current_sound_ || !sound_pcm_.empty();
+        } else if (!preload_queue_.empty() && audio_decode_queue_.empty() && !HasPendingSound()) {
+            /* Fill the sound cache when there is nothing to play */
+            auto ogg = preload_queue_.front();
+            preload_queue_.pop_front();
+            lock.unlock();
+            DecodeSoundToCache(ogg);
+            lock.lock();
         }
         
         /* Encode the audio to send queue */
-        if (!audio_encode_queue_.empty() && audio_send_queue_.size() < MAX_SEND_PACKETS_IN_QUEUE) {
+        if (!audio_encode_queue_.empty() && audio_send_queue_.size() < MaxSendPackets()) {
             auto task = std::move(audio_encode_queue_.front());
             audio_encode_queue_.pop_front();
             audio_queue_cv_.notify_all();
             lock.unlock();
+            EncodeTask(std::move(task));
+            lock.lock();
+        }
+    }
 
-            auto packet = std::make_unique<AudioStreamPacket>();
-            packet->frame_duration = OPUS_FRAME_DURATION_MS;
-            packet->sample_rate = 16000;
-            packet->timestamp = task->timestamp;
-            if (!opus_encoder_->Encode(std::move(task->pcm), packet->payload)) {
-                ESP_LOGE(TAG, "Failed to encode audio");
-                continue;
-            }
+    ESP_LOGW(TAG, "Opus codec task stopped");
+}
 
-            if (task->type == kAudioTaskTypeEncodeToSendQueue) {
-                {
-                    std::lock_guard<std::mutex> lock(audio_queue_mutex_);
-                    audio_send_queue_.push_back(std::move(packet));
-                }
-                if (callbacks_.on_send_queue_available) {
-                    callbacks_.on_send_queue_available();
-                }
-            } else if (task->type == kAudioTaskTypeEncodeToTestingQueue) {
+void AudioService::EncodeTask(std::unique_ptr<AudioTask> task) {
+    if (opus_encoder_ == nullptr) {
+        return;
+    }
+
+    /* Switch to the frame duration of the new audio channel, or the other queue, without carrying samples over */
+    int frame_duration = negotiated_frame_duration_;
+    if (frame_duration != encode_frame_duration_ || task->type != encode_pcm_type_ || task->discontinuous) {
+        encode_frame_duration_ = frame_duration;
+        encode_pcm_type_ = task->type;
+        encode_pcm_.clear();
+    }
+
+    /* The first frame starts with the samples left over from the previous task, they were captured earlier */
+    uint32_t timestamp = task->timestamp;
+    if (timestamp != 0) {
+        timestamp -= encode_pcm_.size() * 1000 / 16000;
+    }
+    if (encode_pcm_.empty()) {
+        encode_pcm_ = std::move(task->pcm);
+    } else {
+        encode_pcm_.insert(encode_pcm_.end(), task->pcm.begin(), task->pcm.end());
+    }
+
+    size_t frame_samples = 16000 * encode_frame_duration_ / 1000;
+    size_t offset = 0;
+    while (encode_pcm_.size() - offset >= frame_samples) {
+        auto packet = std::make_unique<AudioStreamPacket>();
+        packet->frame_duration = encode_frame_duration_;
+        packet->sample_rate = 16000;
+        packet->timestamp = timestamp;
+        packet->payload.resize(MAX_OPUS_PACKET_SIZE);
+
+        int64_t start_time = esp_timer_get_time();
+        int bytes = opus_encode(opus_encoder_, encode_pcm_.data() + offset, frame_samples, packet->payload.data(), packet->payload.size());
+        int64_t encode_time = esp_timer_get_time() - start_time;
+        offset += frame_samples;
+        if (timestamp != 0) {
+            timestamp += encode_frame_duration_;
+        }
+        if (bytes < 0) {
+            ESP_LOGE(TAG, "Failed to encode audio: %d", bytes);
+            continue;
+        }
+        packet->payload.resize(bytes);
+
+        if (encode_pcm_type_ == kAudioTaskTypeEncodeToSendQueue) {
+            size_t send_queue_depth;
+            {
                 std::lock_guard<std::mutex> lock(audio_queue_mutex_);
-                audio_testing_queue_.push_back(std::move(packet));
+                send_queue_depth = audio_send_queue_.size();
+                audio_send_queue_.push_back(std::move(packet));
             }
-            debug_statistics_.encode_count++;
-            lock.lock();
+            if (callbacks_.on_send_queue_available) {
+                callbacks_.on_send_queue_available();
+            }
+            if (encoder_controller_ && encoder_controller_->RecordFrame(encode_time, encode_frame_duration_,
+                    send_queue_depth, MaxSendPackets())) {
+                ApplyEncoderProfile(encoder_controller_->profile());
+            }
+        } else if (encode_pcm_type_ == kAudioTaskTypeEncodeToTestingQueue) {
+            std::lock_guard<std::mutex> lock(audio_queue_mutex_);
+            audio_testing_queue_.push_back(std::move(packet));
         }
+        debug_statistics_.encode_count++;
     }
+    encode_pcm_.erase(encode_pcm_.begin(), encode_pcm_.begin() + offset);
+}
 
-    ESP_LOGW(TAG, "Opus codec task stopped");
+void AudioService::ApplyEncoderProfile(const OpusEncoderProfile& profile) {
+    opus_encoder_ctl(opus_encoder_, OPUS_SET_COMPLEXITY(profile.complexity));
+    opus_encoder_ctl(opus_encoder_, OPUS_SET_BITRATE(profile.bitrate > 0 ? profile.bitrate : OPUS_AUTO));
+    opus_encoder_ctl(opus_encoder_, OPUS_SET_INBAND_FEC(profile.fec ? 1 : 0));
+    opus_encoder_ctl(opus_encoder_, OPUS_SET_PACKET_LOSS_PERC(profile.packet_loss_percent));
+}
+
+int AudioService::NegotiateEncoderFrameDuration() {
+    int frame_duration = OPUS_FRAME_DURATION_MS;
+    if (encoder_controller_) {
+        frame_duration = encoder_controller_->PreferredFrameDuration();
+    }
+    negotiated_frame_duration_ = frame_duration;
+    return frame_duration;
 }
 
 void AudioService::SetDecodeSampleRate(int sample_rate, int frame_duration) {
@@ -387,28 +574,52 @@ void AudioService::SetDecodeSampleRate(int sample_rate, int frame_duration) {
 }
 
 void AudioService::PushTaskToEncodeQueue(AudioTaskType type, std::vector<int16_t>&& pcm) {
+    uint32_t timestamp = 0;
+#if CONFIG_USE_SERVER_AEC
+    /* The timestamp of the downlink audio that was playing when this audio was captured */
+    if (type == kAudioTaskTypeEncodeToSendQueue) {
+        timestamp = aec_aligner_.MapUplinkFrame(pcm.size());
+    }
+#endif
+
+    if (type != kAudioTaskTypeEncodeToSendQueue) {
+        PushEncodeTask(type, std::move(pcm), timestamp, false);
+        return;
+    }
+
+    /* Only the speech, its pre-roll and hangover and the comfort noise frames are encoded when the gate is enabled */
+    uint32_t sequence = ++uplink_sequence_;
+    gated_frames_.clear();
+    uplink_gate_.Process(UplinkGate::Frame{std::move(pcm), timestamp, sequence}, voice_detected_, gated_frames_);
+    for (auto& frame : gated_frames_) {
+        /* Frames skipped by the gate or a restart of the processor leave a gap in the audio */
+        bool discontinuous = uplink_restarted_.exchange(false) || frame.sequence != last_encoded_sequence_ + 1;
+        last_encoded_sequence_ = frame.sequence;
+        PushEncodeTask(type, std::move(frame.pcm), frame.timestamp, discontinuous);
+    }
+}
+
+void AudioService::PushEncodeTask(AudioTaskType type, std::vector<int16_t>&& pcm, uint32_t timestamp, bool discontinuous) {
     auto task = std::make_unique<AudioTask>();
     task->type = type;
     task->pcm = std::move(pcm);
-    
+    task->timestamp = timestamp;
+    task->discontinuous = discontinuous;
+
     /* Push the task to the encode queue */
     std::unique_lock<std::mutex> lock(audio_queue_mutex_);
 
-    /* If the task is to send queue, we need to set the timestamp */
-    if (type == kAudioTaskTypeEncodeToSendQueue && !timestamp_queue_.empty()) {
-        if (timestamp_queue_.size() <= MAX_TIMESTAMPS_IN_QUEUE) {
-            task->timestamp = timestamp_queue_.front();
-        } else {
-            ESP_LOGW(TAG, "Timestamp queue (%u) is full, dropping timestamp", timestamp_queue_.size());
-        }
-        timestamp_queue_.pop_front();
-    }
-
     audio_queue_cv_.wait(lock, [this]() { return audio_encode_queue_.size() < MAX_ENCODE_TASKS_IN_QUEUE; });
     audio_encode_queue_.push_back(std::move(task));
     audio_queue_cv_.notify_all();
 }
 
+void AudioService::EnableUplinkGate(bool enable) {
+#if CONFIG_USE_UPLINK_VAD_GATE
+    uplink_gate_.SetEnabled(enable);
+#endif
+}
+
 bool AudioService::PushPacketToDecodeQueue(std::unique_ptr<AudioStreamPacket> packet, bool wait) {
     std::unique_lock<std::mutex> lock(audio_queue_mutex_);
     if (audio_decode_queue_.size() >= MAX_DECODE_PACKETS_IN_QUEUE) {
@@ -453,19 +664,21 @@ std::unique_ptr<AudioStreamPacket> AudioService::PopWakeWordPacket() {
 }
 
 void AudioService::EnableWakeWordDetection(bool enable) {
+    std::lock_guard<std::mutex> lock(wake_word_mutex_);
     if (!wake_word_) {
         return;
     }
 
     ESP_LOGD(TAG, "%s wake word detection", enable ? "Enabling" : "Disabling");
     if (enable) {
-        if (!wake_word_initialized_) {
+        if (!wake_word_initialized_[wake_word_engine_]) {
             if (!wake_word_->Initialize(codec_, models_list_)) {
                 ESP_LOGE(TAG, "Failed to initialize wake word");
                 return;
             }
-            wake_word_initialized_ = true;
+            wake_word_initialized_[wake_word_engine_] = true;
         }
+        wake_word_gate_.Reset();
         wake_word_->Start();
         xEventGroupSetBits(event_group_, AS_EVENT_WAKE_WORD_RUNNING);
     } else {
@@ -485,6 +698,11 @@ void AudioService::EnableVoiceProcessing(bool enable) {
         /* We should make sure no audio is playing */
         ResetDecoder();
         audio_input_need_warmup_ = true;
+        uplink_gate_.Reset();
+        uplink_restarted_ = true;
+#if CONFIG_USE_SERVER_AEC
+        aec_aligner_.ResetInput();
+#endif
         audio_processor_->Start();
         xEventGroupSetBits(event_group_, AS_EVENT_AUDIO_PROCESSOR_RUNNING);
     } else {
@@ -527,113 +745,190 @@ void AudioService::PlaySound(const std::string_view& ogg) {
         codec_->EnableOutput(true);
     }
 
-    const uint8_t* buf = reinterpret_cast<const uint8_t*>(ogg.data());
-    size_t size = ogg.size();
-    size_t offset = 0;
-
-    auto find_page = [&](size_t start)->size_t {
-        for (size_t i = start; i + 4 <= size; ++i) {
-            if (buf[i] == 'O' && buf[i+1] == 'g' && buf[i+2] == 'g' && buf[i+3] == 'S') return i;
-        }
-        return static_cast<size_t>(-1);
-    };
-
-    bool seen_head = false;
-    bool seen_tags = false;
-    int sample_rate = 16000; // 默认值
+    std::lock_guard<std::mutex> lock(audio_queue_mutex_);
+    /* The sound is decoded, or read from the cache, by the opus codec task, so the caller does not wait for the playback */
+    auto sound = std::make_unique<OggOpusReader>(ogg);
+    if (!sound->Open()) {
+        ESP_LOGE(TAG, "Invalid sound data");
+        return;
+    }
+    if (sound_queue_.size() >= MAX_SOUNDS_IN_QUEUE) {
+        ESP_LOGW(TAG, "Sound queue is full, dropping sound");
+        return;
+    }
+    sound_queue_.push_back(std::move(sound));
+    audio_queue_cv_.notify_all();
+}
 
+bool AudioService::DecodeSoundPacket() {
     while (true) {
-        size_t pos = find_page(offset);
-        if (pos == static_cast<size_t>(-1)) break;
-        offset = pos;
-        if (offset + 27 > size) break;
-
-        const uint8_t* page = buf + offset;
-        uint8_t page_segments = page[26];
-        size_t seg_table_off = offset + 27;
-        if (seg_table_off + page_segments > size) break;
-
-        size_t body_size = 0;
-        for (size_t i = 0; i < page_segments; ++i) body_size += page[27 + i];
-
-        size_t body_off = seg_table_off + page_segments;
-        if (body_off + body_size > size) break;
-
-        // Parse packets using lacing
-        size_t cur = body_off;
-        size_t seg_idx = 0;
-        while (seg_idx < page_segments) {
-            size_t pkt_len = 0;
-            size_t pkt_start = cur;
-            bool continued = false;
-            do {
-                uint8_t l = page[27 + seg_idx++];
-                pkt_len += l;
-                cur += l;
-                continued = (l == 255);
-            } while (continued && seg_idx < page_segments);
-
-            if (pkt_len == 0) continue;
-            const uint8_t* pkt_ptr = buf + pkt_start;
-
-            if (!seen_head) {
-                // 解析OpusHead包
-                if (pkt_len >= 19 && std::memcmp(pkt_ptr, "OpusHead", 8) == 0) {
-                    seen_head = true;
-                    
-                    // OpusHead结构：[0-7] "OpusHead", [8] version, [9] channel_count, [10-11] pre_skip
-                    // [12-15] input_sample_rate, [16-17] output_gain, [18] mapping_family
-                    if (pkt_len >= 12) {
-                        uint8_t version = pkt_ptr[8];
-                        uint8_t channel_count = pkt_ptr[9];
-                        
-                        if (pkt_len >= 16) {
-                            // 读取输入采样率 (little-endian)
-                            sample_rate = pkt_ptr[12] | (pkt_ptr[13] << 8) | 
-                                        (pkt_ptr[14] << 16) | (pkt_ptr[15] << 24);
-                            ESP_LOGI(TAG, "OpusHead: version=%d, channels=%d, sample_rate=%d", 
-                                   version, channel_count, sample_rate);
-                        }
-                    }
-                }
-                continue;
+        if (!current_sound_) {
+            std::lock_guard<std::mutex> lock(audio_queue_mutex_);
+            if (sound_queue_.empty()) {
+                CloseSoundDecoder();
+                return false;
             }
-            if (!seen_tags) {
-                // Expect OpusTags in second packet
-                if (pkt_len >= 8 && std::memcmp(pkt_ptr, "OpusTags", 8) == 0) {
-                    seen_tags = true;
-                }
-                continue;
+            current_sound_ = std::move(sound_queue_.front());
+            sound_queue_.pop_front();
+            sound_active_ = true;
+            sound_cached_ = sound_cache_ && sound_cache_->Open(current_sound_->ogg(), sound_cursor_);
+            if (!sound_cached_ && sound_decoder_ != nullptr) {
+                opus_decoder_ctl(sound_decoder_, OPUS_RESET_STATE);
             }
+        }
+
+        if (sound_cached_) {
+            /* One frame at a time, so the playback queue stays bounded like for decoded sounds */
+            size_t frame_samples = codec_->output_sample_rate() * OPUS_FRAME_DURATION_MS / 1000;
+            if (sound_cache_->Read(sound_cursor_, frame_samples, sound_pcm_)) {
+                return true;
+            }
+        } else if (DecodeOggPacket(*current_sound_, sound_pcm_)) {
+            return true;
+        }
+        current_sound_.reset();
+    }
+}
+
+bool AudioService::DecodeOggPacket(OggOpusReader& sound, std::vector<int16_t>& pcm) {
+    /* Decode at the codec rate when Opus supports it, otherwise at the rate of the sound and resample */
+    int output_sample_rate = codec_->output_sample_rate();
+    int sample_rate = output_sample_rate;
+    if (sample_rate != 8000 && sample_rate != 12000 && sample_rate != 16000 && sample_rate != 24000 && sample_rate != 48000) {
+        sample_rate = sound.sample_rate();
+        if (sample_rate != 8000 && sample_rate != 12000 && sample_rate != 16000 && sample_rate != 24000) {
+            sample_rate = 48000;
+        }
+    }
+    if (sound_decoder_ == nullptr || sound_decoder_sample_rate_ != sample_rate) {
+        CloseSoundDecoder();
+        int error = 0;
+        sound_decoder_ = opus_decoder_create(sample_rate, 1, &error);
+        if (sound_decoder_ == nullptr) {
+            ESP_LOGE(TAG, "Failed to create sound decoder: %d", error);
+            return false;
+        }
+        MemoryAccounting::Record(kMemoryTagOpus, sound_decoder_);
+        sound_decoder_sample_rate_ = sample_rate;
+        sound_frame_.resize(MAX_SOUND_FRAME_SAMPLES);
+        if (sample_rate != output_sample_rate) {
+            sound_resampler_.Configure(sample_rate, output_sample_rate);
+        }
+    }
+
+    const uint8_t* packet;
+    size_t size;
+    while (sound.NextPacket(packet, size)) {
+        int samples = opus_decode(sound_decoder_, packet, size, sound_frame_.data(), MAX_SOUND_FRAME_SAMPLES, 0);
+        if (samples < 0) {
+            ESP_LOGE(TAG, "Failed to decode sound packet: %d", samples);
+            continue;
+        }
+        if (sample_rate != output_sample_rate) {
+            size_t offset = pcm.size();
+            pcm.resize(offset + sound_resampler_.GetOutputSamples(samples));
+            pcm.resize(offset + sound_resampler_.Process(sound_frame_.data(), samples, pcm.data() + offset));
+        } else {
+            pcm.insert(pcm.end(), sound_frame_.begin(), sound_frame_.begin() + samples);
+        }
+        return true;
+    }
+    return false;
+}
 
-            // Audio packet (Opus)
-            auto packet = std::make_unique<AudioStreamPacket>();
-            packet->sample_rate = sample_rate;
-            packet->frame_duration = 60;
-            packet->payload.resize(pkt_len);
-            std::memcpy(packet->payload.data(), pkt_ptr, pkt_len);
-            PushPacketToDecodeQueue(std::move(packet), true);
+void AudioService::PreloadSound(const std::string_view& ogg) {
+    if (!sound_cache_ || sound_cache_->Contains(ogg)) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(audio_queue_mutex_);
+    preload_queue_.push_back(ogg);
+    audio_queue_cv_.notify_all();
+}
+
+void AudioService::DecodeSoundToCache(const std::string_view& ogg) {
+    OggOpusReader sound(ogg);
+    if (!sound.Open()) {
+        return;
+    }
+    if (sound_decoder_ != nullptr) {
+        opus_decoder_ctl(sound_decoder_, OPUS_RESET_STATE);
+    }
+
+    std::vector<int16_t> pcm;
+    while (DecodeOggPacket(sound, pcm)) {
+    }
+    sound_cache_->Add(ogg, pcm);
+    CloseSoundDecoder();
+}
+
+void AudioService::MixPlayback(std::vector<int16_t>& pcm, bool mix_sound) {
+    mixer_.SetInput(kMixerStreamSpeech, pcm.data(), pcm.size());
+    size_t samples = 0;
+    if (mix_sound) {
+        while (sound_pcm_.size() < pcm.size() && DecodeSoundPacket()) {
+        }
+        samples = std::min(pcm.size(), sound_pcm_.size());
+        if (samples > 0) {
+            mixer_.SetInput(kMixerStreamAlert, sound_pcm_.data(), samples);
         }
+    }
+    mixer_.Mix(pcm.data(), pcm.size());
+    sound_pcm_.erase(sound_pcm_.begin(), sound_pcm_.begin() + samples);
+}
 
-        offset = body_off + body_size;
+void AudioService::CloseSoundDecoder() {
+    if (sound_decoder_ != nullptr) {
+        MemoryAccounting::Release(kMemoryTagOpus, sound_decoder_);
+        opus_decoder_destroy(sound_decoder_);
+        sound_decoder_ = nullptr;
+        sound_decoder_sample_rate_ = 0;
+        sound_frame_.clear();
+        sound_frame_.shrink_to_fit();
     }
 }
 
 bool AudioService::IsIdle() {
     std::lock_guard<std::mutex> lock(audio_queue_mutex_);
-    return audio_encode_queue_.empty() && audio_decode_queue_.empty() && audio_playback_queue_.empty() && audio_testing_queue_.empty();
+    return audio_encode_queue_.empty() && audio_decode_queue_.empty() && audio_playback_queue_.empty() && audio_testing_queue_.empty() &&
+        sound_queue_.empty() && !sound_active_;
 }
 
 void AudioService::ResetDecoder() {
     std::lock_guard<std::mutex> lock(audio_queue_mutex_);
     opus_decoder_->ResetState();
-    timestamp_queue_.clear();
+    aec_aligner_.Reset();
     audio_decode_queue_.clear();
+    // Keep the head of the playback queue as a short fade out instead of cutting the speech
+    std::unique_ptr<AudioTask> tail;
+    if (!audio_playback_queue_.empty() && audio_playback_queue_.front()->type == kAudioTaskTypeDecodeToPlaybackQueue) {
+        tail = std::move(audio_playback_queue_.front());
+        AudioMixer::FadeOut(tail->pcm, codec_->output_sample_rate() * PLAYBACK_FADE_OUT_MS / 1000);
+    }
     audio_playback_queue_.clear();
+    /* The speech buffered ahead of the DMA would keep playing after a barge-in */
+    codec_->FlushOutput();
+    if (tail && !tail->pcm.empty()) {
+        audio_playback_queue_.push_back(std::move(tail));
+    }
+    mixer_.Restart(kMixerStreamSpeech);
     audio_testing_queue_.clear();
     audio_queue_cv_.notify_all();
 }
 
+uint8_t AudioService::GetPcmLevel(const std::vector<int16_t>& pcm) {
+    int peak = 0;
+    for (auto sample : pcm) {
+        peak = std::max(peak, std::abs(int(sample)));
+    }
+    if (peak < 256) {
+        return 0;
+    }
+    // 32 steps per 6dB over the top 48dB, from the highest bit and the next 3 bits of the peak
+    int bits = 32 - __builtin_clz(peak);
+    int fraction = (peak >> (bits - 4)) & 7;
+    return std::min(255, (bits - 9) * 32 + fraction * 4);
+}
+
 void AudioService::CheckAndUpdateAudioPowerState() {
     auto now = std::chrono::steady_clock::now();
     auto input_elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(now - last_input_time_).count();
@@ -650,36 +945,147 @@ void AudioService::CheckAndUpdateAudioPowerState() {
 }
 
 void AudioService::SetModelsList(srmodel_list_t* models_list) {
+    std::lock_guard<std::mutex> lock(wake_word_mutex_);
+    bool running = xEventGroupGetBits(event_group_) & AS_EVENT_WAKE_WORD_RUNNING;
+    if (running && wake_word_ != nullptr) {
+        wake_word_->Stop();
+    }
     models_list_ = models_list;
+    for (int i = 0; i < kWakeWordEngineCount; i++) {
+        wake_words_[i].reset();
+        wake_word_initialized_[i] = false;
+    }
+    wake_word_ = nullptr;
 
-#if CONFIG_IDF_TARGET_ESP32S3 || CONFIG_IDF_TARGET_ESP32P4
-    if (esp_srmodel_filter(models_list_, ESP_MN_PREFIX, NULL) != nullptr) {
-        wake_word_ = std::make_unique<CustomWakeWord>();
-    } else if (esp_srmodel_filter(models_list_, ESP_WN_PREFIX, NULL) != nullptr) {
-        wake_word_ = std::make_unique<AfeWakeWord>();
-    } else {
-        wake_word_ = nullptr;
+    auto engines = GetWakeWordEngines();
+    if (engines.empty()) {
+        xEventGroupClearBits(event_group_, AS_EVENT_WAKE_WORD_RUNNING);
+        return;
     }
-#else
-    if (esp_srmodel_filter(models_list_, ESP_WN_PREFIX, NULL) != nullptr) {
-        wake_word_ = std::make_unique<EspWakeWord>();
+    // The saved engine if its models are there, otherwise the command words are preferred as before
+    std::string name = Settings("wake_word").GetString("engine");
+    if (std::find(engines.begin(), engines.end(), name) == engines.end()) {
+        name = engines.back();
+    }
+    ActivateWakeWord(name == kWakeWordEngineNames[kWakeWordEngineMultiNet] ? kWakeWordEngineMultiNet : kWakeWordEngineWakeNet,
+        running);
+}
+
+void AudioService::ActivateWakeWord(WakeWordEngine engine, bool running) {
+    wake_word_engine_ = engine;
+    wake_word_ = CreateWakeWord(engine);
+    if (!running) {
+        return;
+    }
+    if (wake_word_ != nullptr && !wake_word_initialized_[engine]) {
+        wake_word_initialized_[engine] = wake_word_->Initialize(codec_, models_list_);
+    }
+    if (wake_word_ != nullptr && wake_word_initialized_[engine]) {
+        wake_word_gate_.Reset();
+        wake_word_->Start();
     } else {
+        ESP_LOGE(TAG, "Failed to initialize wake word");
         wake_word_ = nullptr;
+        xEventGroupClearBits(event_group_, AS_EVENT_WAKE_WORD_RUNNING);
     }
-#endif
+}
 
-    if (wake_word_) {
-        wake_word_->OnWakeWordDetected([this](const std::string& wake_word) {
+WakeWord* AudioService::CreateWakeWord(WakeWordEngine engine) {
+    if (!wake_words_[engine]) {
+#if CONFIG_IDF_TARGET_ESP32S3 || CONFIG_IDF_TARGET_ESP32P4
+        if (engine == kWakeWordEngineMultiNet) {
+            wake_words_[engine] = std::make_unique<CustomWakeWord>();
+        } else {
+            wake_words_[engine] = std::make_unique<AfeWakeWord>();
+        }
+#else
+        if (engine == kWakeWordEngineWakeNet) {
+            wake_words_[engine] = std::make_unique<EspWakeWord>();
+        } else {
+            return nullptr;
+        }
+#endif
+        wake_words_[engine]->OnWakeWordDetected([this](const std::string& wake_word) {
             if (callbacks_.on_wake_word_detected) {
                 callbacks_.on_wake_word_detected(wake_word);
             }
         });
     }
+    return wake_words_[engine].get();
+}
+
+std::vector<std::string> AudioService::GetWakeWordEngines() {
+    std::vector<std::string> engines;
+    if (models_list_ == nullptr) {
+        return engines;
+    }
+    if (esp_srmodel_filter(models_list_, ESP_WN_PREFIX, NULL) != nullptr) {
+        engines.push_back(kWakeWordEngineNames[kWakeWordEngineWakeNet]);
+    }
+#if CONFIG_IDF_TARGET_ESP32S3 || CONFIG_IDF_TARGET_ESP32P4
+    if (esp_srmodel_filter(models_list_, ESP_MN_PREFIX, NULL) != nullptr) {
+        engines.push_back(kWakeWordEngineNames[kWakeWordEngineMultiNet]);
+    }
+#endif
+    return engines;
+}
+
+std::string AudioService::GetWakeWordEngine() {
+    std::lock_guard<std::mutex> lock(wake_word_mutex_);
+    return wake_word_ != nullptr ? kWakeWordEngineNames[wake_word_engine_] : "";
+}
+
+bool AudioService::SetWakeWordEngine(const std::string& name) {
+    auto engines = GetWakeWordEngines();
+    if (std::find(engines.begin(), engines.end(), name) == engines.end()) {
+        ESP_LOGW(TAG, "Wake word engine %s is not available", name.c_str());
+        return false;
+    }
+    auto engine = name == kWakeWordEngineNames[kWakeWordEngineMultiNet] ? kWakeWordEngineMultiNet : kWakeWordEngineWakeNet;
+
+    /* The input task feeds the engine with the mutex held, so the old engine is idle once the mutex is taken */
+    std::lock_guard<std::mutex> lock(wake_word_mutex_);
+    if (engine != wake_word_engine_ || wake_word_ == nullptr) {
+        bool running = xEventGroupGetBits(event_group_) & AS_EVENT_WAKE_WORD_RUNNING;
+        if (running && wake_word_ != nullptr) {
+            wake_word_->Stop();
+        }
+        /* Free the models, tasks and buffers of the engine switched away from, only one is resident */
+        if (engine != wake_word_engine_) {
+            wake_word_ = nullptr;
+            wake_words_[wake_word_engine_].reset();
+            wake_word_initialized_[wake_word_engine_] = false;
+        }
+        ActivateWakeWord(engine, running);
+        ESP_LOGI(TAG, "Wake word engine switched to %s", name.c_str());
+    }
+    Settings("wake_word", true).SetString("engine", name);
+    return wake_word_ != nullptr;
+}
+
+void AudioService::FeedWakeWord(const AudioFrame& frame) {
+#if CONFIG_USE_WAKE_WORD_ENERGY_GATE
+    /* A cheap energy VAD runs first, the detector only gets the audio around speech with its pre-roll */
+    bool speaking = wake_word_vad_.Process(frame.Mic(wake_word_mic_), frame.frames);
+
+    /* The gate keeps frames for the pre-roll, so they are copied into buffers it hands back */
+    UplinkGate::Frame copy{wake_word_gate_.TakeSpare(), 0};
+    copy.pcm.assign(frame.data, frame.data + frame.samples());
+    wake_word_frames_.clear();
+    wake_word_gate_.Process(std::move(copy), speaking, wake_word_frames_);
+    for (auto& f : wake_word_frames_) {
+        wake_word_->Feed(AudioFrame(f.pcm, frame.channels));
+        wake_word_gate_.Recycle(std::move(f.pcm));
+    }
+#else
+    wake_word_->Feed(frame);
+#endif
 }
 
 bool AudioService::IsAfeWakeWord() {
 #if CONFIG_IDF_TARGET_ESP32S3 || CONFIG_IDF_TARGET_ESP32P4
-    return wake_word_ != nullptr && dynamic_cast<AfeWakeWord*>(wake_word_.get()) != nullptr;
+    std::lock_guard<std::mutex> lock(wake_word_mutex_);
+    return wake_word_ != nullptr && dynamic_cast<AfeWakeWord*>(wake_word_) != nullptr;
 #else
     return false;
 #endif
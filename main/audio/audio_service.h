@@ -6,6 +6,7 @@
 #include <condition_variable>
 #include <chrono>
 #include <mutex>
+#include <atomic>
 
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
@@ -15,10 +16,18 @@
 
 #include <opus_encoder.h>
 #include <opus_decoder.h>
-#include <opus_resampler.h>
+#include <opus.h>
 
 #include "audio_codec.h"
 #include "audio_processor.h"
+#include "ogg_opus_reader.h"
+#include "sound_cache.h"
+#include "opus_encoder_controller.h"
+#include "polyphase_resampler.h"
+#include "server_aec_aligner.h"
+#include "audio_mixer.h"
+#include "uplink_gate.h"
+#include "processors/energy_vad.h"
 #include "processors/audio_debugger.h"
 #include "wake_word.h"
 #include "protocol.h"
@@ -32,6 +41,10 @@
  * We use one task for MIC / Speaker / Processors, and one task for Opus Encoder / Opus Decoder.
  * 
  * Decode Queue and Send Queue are the main queues, because Opus packets are quite smaller than PCM packets.
+ *
+ * Sounds played with PlaySound are read packet by packet from the Ogg data in place and decoded on demand
+ * by the Opus codec task with their own decoder, so they can be mixed over the TTS stream. Sounds in the
+ * sound cache are read from it a frame at a time instead of being decoded.
  * 
  */
 
@@ -39,9 +52,12 @@
 #define MAX_ENCODE_TASKS_IN_QUEUE 2
 #define MAX_PLAYBACK_TASKS_IN_QUEUE 2
 #define MAX_DECODE_PACKETS_IN_QUEUE (2400 / OPUS_FRAME_DURATION_MS)
-#define MAX_SEND_PACKETS_IN_QUEUE (2400 / OPUS_FRAME_DURATION_MS)
+#define MAX_SEND_QUEUE_DURATION_MS 2400
 #define AUDIO_TESTING_MAX_DURATION_MS 10000
-#define MAX_TIMESTAMPS_IN_QUEUE 3
+#define MAX_SOUNDS_IN_QUEUE 16
+#define MAX_SOUND_FRAME_SAMPLES 5760 // 120ms at 48kHz
+#define MAX_OPUS_PACKET_SIZE 1500
+#define PLAYBACK_FADE_OUT_MS 10
 
 #define AUDIO_POWER_TIMEOUT_MS 15000
 #define AUDIO_POWER_CHECK_INTERVAL_MS 1000
@@ -52,6 +68,12 @@
 #define AS_EVENT_AUDIO_PROCESSOR_RUNNING    (1 << 2)
 #define AS_EVENT_PLAYBACK_NOT_EMPTY         (1 << 3)
 
+enum WakeWordEngine {
+    kWakeWordEngineWakeNet,     // AfeWakeWord, or EspWakeWord on chips without the AFE
+    kWakeWordEngineMultiNet,    // CustomWakeWord, command words from the assets
+    kWakeWordEngineCount,
+};
+
 struct AudioServiceCallbacks {
     std::function<void(void)> on_send_queue_available;
     std::function<void(const std::string&)> on_wake_word_detected;
@@ -69,7 +91,9 @@ enum AudioTaskType {
 struct AudioTask {
     AudioTaskType type;
     std::vector<int16_t> pcm;
-    uint32_t timestamp;
+    uint32_t timestamp = 0;
+    // The PCM does not follow the previous task, samples left over from it must not be joined to it
+    bool discontinuous = false;
 };
 
 struct DebugStatistics {
@@ -91,6 +115,8 @@ public:
     std::unique_ptr<AudioStreamPacket> PopWakeWordPacket();
     const std::string& GetLastWakeWord() const;
     bool IsVoiceDetected() const { return voice_detected_; }
+    // Level of the audio being played, 0-255 on a log scale
+    uint8_t GetOutputLevel() const { return output_level_; }
     bool IsIdle();
     bool IsWakeWordRunning() const { return xEventGroupGetBits(event_group_) & AS_EVENT_WAKE_WORD_RUNNING; }
     bool IsAudioProcessorRunning() const { return xEventGroupGetBits(event_group_) & AS_EVENT_AUDIO_PROCESSOR_RUNNING; }
@@ -101,26 +127,53 @@ public:
     void EnableAudioTesting(bool enable);
     void EnableDeviceAec(bool enable);
 
+    // Send only the detected speech while listening, see UplinkGate
+    void EnableUplinkGate(bool enable);
     void SetCallbacks(AudioServiceCallbacks& callbacks);
 
     bool PushPacketToDecodeQueue(std::unique_ptr<AudioStreamPacket> packet, bool wait = false);
     std::unique_ptr<AudioStreamPacket> PopPacketFromSendQueue();
     void PlaySound(const std::string_view& sound);
+    // Decode a sound into the sound cache in the background, if the cache is enabled
+    void PreloadSound(const std::string_view& sound);
     bool ReadAudioData(std::vector<int16_t>& data, int sample_rate, int samples);
     void ResetDecoder();
+    // Called when a new audio channel is negotiated, returns the uplink frame duration to announce
+    int NegotiateEncoderFrameDuration();
     void SetModelsList(srmodel_list_t* models_list);
+    // Engines the models list has models for, by name ("wakenet", "multinet")
+    std::vector<std::string> GetWakeWordEngines();
+    std::string GetWakeWordEngine();
+    // Switch the wake word engine without a reboot, the choice is saved
+    bool SetWakeWordEngine(const std::string& name);
 
 private:
     AudioCodec* codec_ = nullptr;
     AudioServiceCallbacks callbacks_;
     std::unique_ptr<AudioProcessor> audio_processor_;
-    std::unique_ptr<WakeWord> wake_word_;
+    // Engines are created when first used, the inactive one is destroyed when switching
+    std::unique_ptr<WakeWord> wake_words_[kWakeWordEngineCount];
+    bool wake_word_initialized_[kWakeWordEngineCount] = {};
+    WakeWord* wake_word_ = nullptr;
+    WakeWordEngine wake_word_engine_ = kWakeWordEngineWakeNet;
+    // Held while the active engine is fed or switched
+    std::mutex wake_word_mutex_;
     std::unique_ptr<AudioDebugger> audio_debugger_;
-    std::unique_ptr<OpusEncoderWrapper> opus_encoder_;
+    OpusEncoder* opus_encoder_ = nullptr;
+    std::unique_ptr<OpusEncoderController> encoder_controller_;
     std::unique_ptr<OpusDecoderWrapper> opus_decoder_;
-    OpusResampler input_resampler_;
-    OpusResampler reference_resampler_;
-    OpusResampler output_resampler_;
+    PolyphaseResampler input_resampler_;
+    PolyphaseResampler reference_resampler_;
+    PolyphaseResampler output_resampler_;
+    // Buffers reused by ReadAudioData and the decoder, so resampling does not allocate per frame
+    std::vector<int16_t> input_pcm_;
+    std::vector<int16_t> input_mic_pcm_;
+    std::vector<int16_t> input_reference_pcm_;
+    std::vector<int16_t> resampled_mic_pcm_;
+    std::vector<int16_t> resampled_reference_pcm_;
+    std::vector<int16_t> decode_pcm_;
+    // Every read of the input task for the wake word and the processor lands here, they are fed views of it
+    std::vector<int16_t> input_data_;
     DebugStatistics debug_statistics_;
     srmodel_list_t* models_list_ = nullptr;
 
@@ -137,15 +190,51 @@ private:
     std::deque<std::unique_ptr<AudioStreamPacket>> audio_testing_queue_;
     std::deque<std::unique_ptr<AudioTask>> audio_encode_queue_;
     std::deque<std::unique_ptr<AudioTask>> audio_playback_queue_;
+    std::deque<std::unique_ptr<OggOpusReader>> sound_queue_;
     // For server AEC
-    std::deque<uint32_t> timestamp_queue_;
+    ServerAecAligner aec_aligner_;
 
-    bool wake_word_initialized_ = false;
     bool audio_processor_initialized_ = false;
     bool voice_detected_ = false;
+    std::atomic<uint8_t> output_level_ = 0;
     bool service_stopped_ = true;
     bool audio_input_need_warmup_ = false;
 
+    // Sound playback, only accessed by the opus codec task
+    std::unique_ptr<OggOpusReader> current_sound_;
+    std::atomic<bool> sound_active_ = false;
+    OpusDecoder* sound_decoder_ = nullptr;
+    int sound_decoder_sample_rate_ = 0;
+    PolyphaseResampler sound_resampler_;
+    std::vector<int16_t> sound_frame_;
+    std::vector<int16_t> sound_pcm_;
+    std::unique_ptr<SoundCache> sound_cache_;
+    // Read position when the current sound is played from the cache
+    bool sound_cached_ = false;
+    SoundCache::Cursor sound_cursor_;
+    AudioMixer mixer_;
+
+    // Uplink encoding, only accessed by the opus codec task except the negotiated frame duration
+    std::atomic<int> negotiated_frame_duration_ = OPUS_FRAME_DURATION_MS;
+    int encode_frame_duration_ = OPUS_FRAME_DURATION_MS;
+    std::vector<int16_t> encode_pcm_;
+    AudioTaskType encode_pcm_type_ = kAudioTaskTypeEncodeToSendQueue;
+
+    // Uplink gating, only accessed by the task delivering the processor output
+    UplinkGate uplink_gate_;
+    std::vector<UplinkGate::Frame> gated_frames_;
+    uint32_t uplink_sequence_ = 0;
+    uint32_t last_encoded_sequence_ = 0;
+    // Set when voice processing restarts, the next uplink frame starts a new stream
+    std::atomic<bool> uplink_restarted_ = true;
+    std::deque<std::string_view> preload_queue_;
+
+    // The wake word is only fed around speech when its energy gate is enabled, only accessed by the input task
+    UplinkGate wake_word_gate_;
+    EnergyVad wake_word_vad_;
+    std::vector<int16_t> wake_word_mic_;
+    std::vector<UplinkGate::Frame> wake_word_frames_;
+
     esp_timer_handle_t audio_power_timer_ = nullptr;
     std::chrono::steady_clock::time_point last_input_time_;
     std::chrono::steady_clock::time_point last_output_time_;
@@ -154,8 +243,30 @@ private:
     void AudioOutputTask();
     void OpusCodecTask();
     void PushTaskToEncodeQueue(AudioTaskType type, std::vector<int16_t>&& pcm);
+    void PushEncodeTask(AudioTaskType type, std::vector<int16_t>&& pcm, uint32_t timestamp, bool discontinuous);
+    // The send queue holds MAX_SEND_QUEUE_DURATION_MS of audio in packets of the encoder frame duration
+    size_t MaxSendPackets() const { return MAX_SEND_QUEUE_DURATION_MS / encode_frame_duration_; }
     void SetDecodeSampleRate(int sample_rate, int frame_duration);
+    // Encode the task PCM in frames of the negotiated duration, leftover samples wait for the next task
+    void EncodeTask(std::unique_ptr<AudioTask> task);
+    void ApplyEncoderProfile(const OpusEncoderProfile& profile);
+    // Called with audio_queue_mutex_ held
+    bool HasPendingSound() const { return current_sound_ || !sound_queue_.empty() || !sound_pcm_.empty(); }
+    // Decode the next packet of the playing sound, or read its next frame from the cache, into sound_pcm_.
+    // Returns false if no sound is left
+    bool DecodeSoundPacket();
+    bool DecodeOggPacket(OggOpusReader& sound, std::vector<int16_t>& pcm);
+    void DecodeSoundToCache(const std::string_view& ogg);
+    // Apply the speech gain and mix the pending sound into `pcm` if `mix_sound`
+    void MixPlayback(std::vector<int16_t>& pcm, bool mix_sound);
+    void CloseSoundDecoder();
     void CheckAndUpdateAudioPowerState();
+    // Called with wake_word_mutex_ held
+    WakeWord* CreateWakeWord(WakeWordEngine engine);
+    // Make `engine` the active one and start it if detection is `running`, called with wake_word_mutex_ held
+    void ActivateWakeWord(WakeWordEngine engine, bool running);
+    void FeedWakeWord(const AudioFrame& frame);
+    static uint8_t GetPcmLevel(const std::vector<int16_t>& pcm);
 };
 
 #endif
\ No newline at end of file
@@ -1,11 +1,24 @@
 #include "no_audio_codec.h"
 
 #include <esp_log.h>
+#include <esp_attr.h>
 #include <cmath>
 #include <cstring>
+#include <algorithm>
 
 #define TAG "NoAudioCodec"
 
+#define RING_WAIT_TIMEOUT_MS 100
+// DMA buffers of output the ring holds at most beyond the DMA descriptors
+#define OUTPUT_RING_AHEAD_BUFFERS 2
+
+#if CONFIG_USE_I2S_CALLBACK_IO
+// The output is written into the DMA buffers by the sent callback and must not be cleared afterwards
+#define TX_AUTO_CLEAR_AFTER_CB false
+#else
+#define TX_AUTO_CLEAR_AFTER_CB true
+#endif
+
 NoAudioCodec::~NoAudioCodec() {
     if (rx_handle_ != nullptr) {
         ESP_ERROR_CHECK(i2s_channel_disable(rx_handle_));
@@ -25,7 +38,7 @@ NoAudioCodecDuplex::NoAudioCodecDuplex(int input_sample_rate, int output_sample_
         .role = I2S_ROLE_MASTER,
         .dma_desc_num = AUDIO_CODEC_DMA_DESC_NUM,
         .dma_frame_num = AUDIO_CODEC_DMA_FRAME_NUM,
-        .auto_clear_after_cb = true,
+        .auto_clear_after_cb = TX_AUTO_CLEAR_AFTER_CB,
         .auto_clear_before_cb = false,
         .intr_priority = 0,
     };
@@ -72,6 +85,7 @@ NoAudioCodecDuplex::NoAudioCodecDuplex(int input_sample_rate, int output_sample_
     ESP_ERROR_CHECK(i2s_channel_init_std_mode(tx_handle_, &std_cfg));
     ESP_ERROR_CHECK(i2s_channel_init_std_mode(rx_handle_, &std_cfg));
     ESP_LOGI(TAG, "Duplex channels created");
+    EnableCallbackIo(sizeof(int32_t));
 }
 
 
@@ -86,7 +100,7 @@ NoAudioCodecSimplex::NoAudioCodecSimplex(int input_sample_rate, int output_sampl
         .role = I2S_ROLE_MASTER,
         .dma_desc_num = AUDIO_CODEC_DMA_DESC_NUM,
         .dma_frame_num = AUDIO_CODEC_DMA_FRAME_NUM,
-        .auto_clear_after_cb = true,
+        .auto_clear_after_cb = TX_AUTO_CLEAR_AFTER_CB,
         .auto_clear_before_cb = false,
         .intr_priority = 0,
     };
@@ -142,6 +156,7 @@ NoAudioCodecSimplex::NoAudioCodecSimplex(int input_sample_rate, int output_sampl
     std_cfg.gpio_cfg.din = mic_din;
     ESP_ERROR_CHECK(i2s_channel_init_std_mode(rx_handle_, &std_cfg));
     ESP_LOGI(TAG, "Simplex channels created");
+    EnableCallbackIo(sizeof(int32_t));
 }
 
 NoAudioCodecSimplex::NoAudioCodecSimplex(int input_sample_rate, int output_sample_rate, gpio_num_t spk_bclk, gpio_num_t spk_ws, gpio_num_t spk_dout, i2s_std_slot_mask_t spk_slot_mask, gpio_num_t mic_sck, gpio_num_t mic_ws, gpio_num_t mic_din, i2s_std_slot_mask_t mic_slot_mask){
@@ -155,7 +170,7 @@ NoAudioCodecSimplex::NoAudioCodecSimplex(int input_sample_rate, int output_sampl
         .role = I2S_ROLE_MASTER,
         .dma_desc_num = AUDIO_CODEC_DMA_DESC_NUM,
         .dma_frame_num = AUDIO_CODEC_DMA_FRAME_NUM,
-        .auto_clear_after_cb = true,
+        .auto_clear_after_cb = TX_AUTO_CLEAR_AFTER_CB,
         .auto_clear_before_cb = false,
         .intr_priority = 0,
     };
@@ -212,48 +227,218 @@ NoAudioCodecSimplex::NoAudioCodecSimplex(int input_sample_rate, int output_sampl
     std_cfg.gpio_cfg.din = mic_din;
     ESP_ERROR_CHECK(i2s_channel_init_std_mode(rx_handle_, &std_cfg));
     ESP_LOGI(TAG, "Simplex channels created");
+    EnableCallbackIo(sizeof(int32_t));
+}
+
+void NoAudioCodec::UpdateVolumeFactor() {
+    // output_volume_: 0-100
+    // volume_factor_: 0-65536
+    volume_factor_ = pow(double(output_volume_) / 100.0, 2) * 65536;
 }
 
 int NoAudioCodec::Write(const int16_t* data, int samples) {
+    if (callback_io_) {
+        return WriteToRing(data, samples);
+    }
+
     std::lock_guard<std::mutex> lock(data_if_mutex_);
-    std::vector<int32_t> buffer(samples);
+    write_buffer_.resize(samples);
 
-    // output_volume_: 0-100
-    // volume_factor_: 0-65536
-    int32_t volume_factor = pow(double(output_volume_) / 100.0, 2) * 65536;
+    UpdateVolumeFactor();
+    int32_t volume_factor = volume_factor_;
     for (int i = 0; i < samples; i++) {
         int64_t temp = int64_t(data[i]) * volume_factor; // 使用 int64_t 进行乘法运算
         if (temp > INT32_MAX) {
-            buffer[i] = INT32_MAX;
+            write_buffer_[i] = INT32_MAX;
         } else if (temp < INT32_MIN) {
-            buffer[i] = INT32_MIN;
+            write_buffer_[i] = INT32_MIN;
         } else {
-            buffer[i] = static_cast<int32_t>(temp);
+            write_buffer_[i] = static_cast<int32_t>(temp);
         }
     }
 
     size_t bytes_written;
-    ESP_ERROR_CHECK(i2s_channel_write(tx_handle_, buffer.data(), samples * sizeof(int32_t), &bytes_written, portMAX_DELAY));
+    ESP_ERROR_CHECK(i2s_channel_write(tx_handle_, write_buffer_.data(), samples * sizeof(int32_t), &bytes_written, portMAX_DELAY));
     return bytes_written / sizeof(int32_t);
 }
 
 int NoAudioCodec::Read(int16_t* dest, int samples) {
-    size_t bytes_read;
+    if (callback_io_) {
+        return ReadFromRing(dest, samples);
+    }
 
-    std::vector<int32_t> bit32_buffer(samples);
-    if (i2s_channel_read(rx_handle_, bit32_buffer.data(), samples * sizeof(int32_t), &bytes_read, portMAX_DELAY) != ESP_OK) {
+    size_t bytes_read;
+    read_buffer_.resize(samples);
+    if (i2s_channel_read(rx_handle_, read_buffer_.data(), samples * sizeof(int32_t), &bytes_read, portMAX_DELAY) != ESP_OK) {
         ESP_LOGE(TAG, "Read Failed!");
         return 0;
     }
 
     samples = bytes_read / sizeof(int32_t);
     for (int i = 0; i < samples; i++) {
-        int32_t value = bit32_buffer[i] >> 12;
+        int32_t value = read_buffer_[i] >> 12;
         dest[i] = (value > INT16_MAX) ? INT16_MAX : (value < -INT16_MAX) ? -INT16_MAX : (int16_t)value;
     }
     return samples;
 }
 
+void NoAudioCodec::EnableCallbackIo(size_t input_sample_bytes) {
+#if CONFIG_USE_I2S_CALLBACK_IO
+    input_sample_bytes_ = input_sample_bytes;
+    if (tx_handle_ != nullptr) {
+        output_ring_ = std::make_unique<PcmRing>(CONFIG_I2S_CALLBACK_IO_RING_SAMPLES);
+    }
+    if (rx_handle_ != nullptr) {
+        input_ring_ = std::make_unique<PcmRing>(CONFIG_I2S_CALLBACK_IO_RING_SAMPLES);
+    }
+    if ((output_ring_ && output_ring_->capacity() == 0) || (input_ring_ && input_ring_->capacity() == 0)) {
+        // An empty ring never fills, keep the blocking channel reads and writes
+        ESP_LOGE(TAG, "Failed to allocate the callback I/O rings, using blocking I/O");
+        output_ring_.reset();
+        input_ring_.reset();
+        return;
+    }
+    if (output_ring_) {
+        output_fill_limit_ = std::min<size_t>(output_ring_->capacity(), OUTPUT_RING_AHEAD_BUFFERS * AUDIO_CODEC_DMA_FRAME_NUM);
+    }
+    if (input_ring_) {
+        input_buffer_frames_ = input_ring_->capacity();
+    }
+    UpdateVolumeFactor();
+    callback_io_ = true;
+    ESP_LOGI(TAG, "Callback I/O enabled, ring of %d samples", CONFIG_I2S_CALLBACK_IO_RING_SAMPLES);
+#endif
+}
+
+static bool IRAM_ATTR NotifyWaiter(std::atomic<TaskHandle_t>& waiter) {
+    TaskHandle_t task = waiter.exchange(nullptr);
+    if (task == nullptr) {
+        return false;
+    }
+    BaseType_t woken = pdFALSE;
+    vTaskNotifyGiveFromISR(task, &woken);
+    return woken == pdTRUE;
+}
+
+bool IRAM_ATTR NoAudioCodec::OnOutputBufferSent(void* dma_buf, size_t size) {
+    /* Refill the buffer just sent, it is sent again after the other DMA buffers */
+    int32_t* dest = static_cast<int32_t*>(dma_buf);
+    size_t frames = size / sizeof(int32_t);
+    // 32767 * 65536 still fits in 32 bits
+    int32_t volume_factor = volume_factor_.load(std::memory_order_relaxed);
+    if (output_flush_.exchange(false, std::memory_order_acquire)) {
+        output_ring_->CommitRead(output_ring_->available());
+    }
+    size_t filled = 0;
+    while (filled < frames) {
+        size_t count = frames - filled;
+        const int16_t* src = output_ring_->PeekRead(count);
+        if (count == 0) {
+            break;
+        }
+        for (size_t i = 0; i < count; i++) {
+            dest[filled + i] = int32_t(src[i]) * volume_factor;
+        }
+        output_ring_->CommitRead(count);
+        filled += count;
+    }
+    if (filled < frames) {
+        // Underrun, play silence
+        memset(dest + filled, 0, (frames - filled) * sizeof(int32_t));
+    }
+
+    if (output_waiter_.load(std::memory_order_acquire) != nullptr &&
+        output_ring_->available() + output_wanted_ <= output_fill_limit_) {
+        return NotifyWaiter(output_waiter_);
+    }
+    return false;
+}
+
+bool IRAM_ATTR NoAudioCodec::OnInputBufferReceived(void* dma_buf, size_t size) {
+    size_t frames = size / input_sample_bytes_;
+    size_t stored = 0;
+    while (stored < frames) {
+        size_t count = frames - stored;
+        int16_t* dest = input_ring_->PeekWrite(count);
+        if (count == 0) {
+            break;
+        }
+        if (input_sample_bytes_ == sizeof(int32_t)) {
+            const int32_t* src = static_cast<const int32_t*>(dma_buf) + stored;
+            for (size_t i = 0; i < count; i++) {
+                int32_t value = src[i] >> 12;
+                dest[i] = (value > INT16_MAX) ? INT16_MAX : (value < -INT16_MAX) ? -INT16_MAX : (int16_t)value;
+            }
+        } else {
+            memcpy(dest, static_cast<const int16_t*>(dma_buf) + stored, count * sizeof(int16_t));
+        }
+        input_ring_->CommitWrite(count);
+        stored += count;
+    }
+    if (stored < frames) {
+        // Overrun, the reader is too slow and the newest samples are dropped
+        input_overrun_samples_.fetch_add(frames - stored, std::memory_order_relaxed);
+    }
+
+    if (input_waiter_.load(std::memory_order_acquire) != nullptr && input_ring_->available() >= input_wanted_) {
+        return NotifyWaiter(input_waiter_);
+    }
+    return false;
+}
+
+int NoAudioCodec::WriteToRing(const int16_t* data, int samples) {
+    UpdateVolumeFactor();
+    int written = 0;
+    while (written < samples) {
+        size_t available = output_ring_->available();
+        size_t room = output_fill_limit_ > available ? output_fill_limit_ - available : 0;
+        written += output_ring_->Write(data + written, std::min<size_t>(room, samples - written));
+        if (written == samples) {
+            break;
+        }
+        // Sleep until the DMA has drained room for the rest, or half of the fill limit
+        output_wanted_ = std::min<size_t>(samples - written, output_fill_limit_ / 2);
+        output_waiter_ = xTaskGetCurrentTaskHandle();
+        if (output_ring_->available() + output_wanted_ > output_fill_limit_) {
+            ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(RING_WAIT_TIMEOUT_MS));
+        }
+        output_waiter_ = nullptr;
+    }
+    return written;
+}
+
+void NoAudioCodec::FlushOutput() {
+    // The interrupt owns the read side, it drops the ring on its next refill
+    if (output_ring_) {
+        output_flush_ = true;
+    }
+}
+
+int NoAudioCodec::ReadFromRing(int16_t* dest, int samples) {
+    int read = 0;
+    while (read < samples) {
+        // Sleep until the whole request, or half of the ring, has been received
+        size_t wanted = std::min<size_t>(samples - read, input_ring_->capacity() / 2);
+        if (input_ring_->available() < wanted) {
+            input_wanted_ = wanted;
+            input_waiter_ = xTaskGetCurrentTaskHandle();
+            if (input_ring_->available() < wanted) {
+                ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(RING_WAIT_TIMEOUT_MS));
+            }
+            input_waiter_ = nullptr;
+            continue;
+        }
+        read += input_ring_->Read(dest + read, wanted);
+    }
+
+    uint32_t overrun = input_overrun_samples_.load(std::memory_order_relaxed);
+    if (overrun != reported_overrun_samples_) {
+        ESP_LOGW(TAG, "Input ring overrun, %lu samples dropped", overrun - reported_overrun_samples_);
+        reported_overrun_samples_ = overrun;
+    }
+    return read;
+}
+
 // Delegating constructor: calls the main constructor with default slot mask
 NoAudioCodecSimplexPdm::NoAudioCodecSimplexPdm(int input_sample_rate, int output_sample_rate, gpio_num_t spk_bclk, gpio_num_t spk_ws, gpio_num_t spk_dout, gpio_num_t mic_sck, gpio_num_t mic_din) 
     : NoAudioCodecSimplexPdm(input_sample_rate, output_sample_rate, spk_bclk, spk_ws, spk_dout, I2S_STD_SLOT_LEFT, mic_sck, mic_din) {
@@ -269,7 +454,7 @@ NoAudioCodecSimplexPdm::NoAudioCodecSimplexPdm(int input_sample_rate, int output
     i2s_chan_config_t tx_chan_cfg = I2S_CHANNEL_DEFAULT_CONFIG((i2s_port_t)1, I2S_ROLE_MASTER);
     tx_chan_cfg.dma_desc_num = AUDIO_CODEC_DMA_DESC_NUM;
     tx_chan_cfg.dma_frame_num = AUDIO_CODEC_DMA_FRAME_NUM;
-    tx_chan_cfg.auto_clear_after_cb = true;
+    tx_chan_cfg.auto_clear_after_cb = TX_AUTO_CLEAR_AFTER_CB;
     tx_chan_cfg.auto_clear_before_cb = false;
     tx_chan_cfg.intr_priority = 0;
     ESP_ERROR_CHECK(i2s_new_channel(&tx_chan_cfg, &tx_handle_, NULL));
@@ -336,18 +521,24 @@ NoAudioCodecSimplexPdm::NoAudioCodecSimplexPdm(int input_sample_rate, int output
     ESP_LOGE(TAG, "PDM is not supported");
 #endif
     ESP_LOGI(TAG, "Simplex channels created");
+    // PDM samples are demodulated to 16 bits
+    EnableCallbackIo(sizeof(int16_t));
 }
 
 int NoAudioCodecSimplexPdm::Read(int16_t* dest, int samples) {
-    size_t bytes_read;
+    if (callback_io_) {
+        samples = ReadFromRing(dest, samples);
+    } else {
+        size_t bytes_read;
+
+        // PDM 解调后的数据位宽为 16 位，直接读取到目标缓冲区
+        if (i2s_channel_read(rx_handle_, dest, samples * sizeof(int16_t), &bytes_read, portMAX_DELAY) != ESP_OK) {
+            ESP_LOGE(TAG, "Read Failed!");
+            return 0;
+        }
 
-    // PDM 解调后的数据位宽为 16 位，直接读取到目标缓冲区
-    if (i2s_channel_read(rx_handle_, dest, samples * sizeof(int16_t), &bytes_read, portMAX_DELAY) != ESP_OK) {
-        ESP_LOGE(TAG, "Read Failed!");
-        return 0;
+        samples = bytes_read / sizeof(int16_t);
     }
-
-    samples = bytes_read / sizeof(int16_t);
     if (input_gain_ > 0) {
         int gain_factor = (int)input_gain_;
         for (int i = 0; i < samples; i++) {
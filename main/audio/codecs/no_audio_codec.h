@@ -2,20 +2,52 @@
 #define _NO_AUDIO_CODEC_H
 
 #include "audio_codec.h"
+#include "pcm_ring.h"
 
 #include <driver/gpio.h>
 #include <driver/i2s_pdm.h>
+#include <freertos/task.h>
 #include <mutex>
+#include <memory>
+#include <atomic>
+#include <vector>
 
 class NoAudioCodec : public AudioCodec {
 protected:
     std::mutex data_if_mutex_;
+    // Conversion buffers kept across calls
+    std::vector<int32_t> write_buffer_;
+    std::vector<int32_t> read_buffer_;
+
+    // With CONFIG_USE_I2S_CALLBACK_IO, the I2S interrupt converts between the DMA buffers and these rings,
+    // and wakes the reading or writing task once enough samples or space are available
+    std::unique_ptr<PcmRing> output_ring_;
+    std::unique_ptr<PcmRing> input_ring_;
+    size_t input_sample_bytes_ = sizeof(int32_t);
+    std::atomic<int32_t> volume_factor_ = 0;
+    std::atomic<TaskHandle_t> output_waiter_ = nullptr;
+    std::atomic<TaskHandle_t> input_waiter_ = nullptr;
+    std::atomic<size_t> output_wanted_ = 0;
+    // The output ring is only filled this far ahead of the DMA buffers, to keep the playout latency low
+    size_t output_fill_limit_ = 0;
+    std::atomic<bool> output_flush_ = false;
+    std::atomic<size_t> input_wanted_ = 0;
+    std::atomic<uint32_t> input_overrun_samples_ = 0;
+    uint32_t reported_overrun_samples_ = 0;
+
+    void EnableCallbackIo(size_t input_sample_bytes);
+    int WriteToRing(const int16_t* data, int samples);
+    int ReadFromRing(int16_t* dest, int samples);
+    void UpdateVolumeFactor();
+    virtual bool OnOutputBufferSent(void* dma_buf, size_t size) override;
+    virtual bool OnInputBufferReceived(void* dma_buf, size_t size) override;
 
     virtual int Write(const int16_t* data, int samples) override;
     virtual int Read(int16_t* dest, int samples) override;
 
 public:
     virtual ~NoAudioCodec();
+    virtual void FlushOutput() override;
 };
 
 class NoAudioCodecDuplex : public NoAudioCodec {
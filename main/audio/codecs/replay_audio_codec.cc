@@ -0,0 +1,226 @@
+#include "replay_audio_codec.h"
+#include "assets.h"
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <cstring>
+#include <algorithm>
+
+#define TAG "ReplayAudioCodec"
+
+#define ASSET_PREFIX "asset:"
+#define WAV_HEADER_PROBE_SIZE 512
+
+
+ReplayAudioCodec::ReplayAudioCodec(const void* data, size_t size, int sample_rate, int channels, int output_sample_rate) {
+    Configure(sample_rate, channels, output_sample_rate);
+    data_ = static_cast<const uint8_t*>(data);
+    data_size_ = size;
+    size_t wav_offset, wav_size;
+    if (ParseWavHeader(data_, size, wav_offset, wav_size)) {
+        data_offset_ = wav_offset;
+        data_size_ = std::min(wav_size, size - wav_offset);
+    }
+    ESP_LOGI(TAG, "Replaying %lu bytes from memory, %d Hz, %d channels", (unsigned long)data_size_, input_sample_rate_, input_channels_);
+}
+
+ReplayAudioCodec::ReplayAudioCodec(const std::string& source, int sample_rate, int channels, int output_sample_rate) {
+    Configure(sample_rate, channels, output_sample_rate);
+    if (source.rfind(ASSET_PREFIX, 0) == 0) {
+        void* ptr = nullptr;
+        size_t size = 0;
+        if (!Assets::GetInstance().GetAssetData(source.substr(strlen(ASSET_PREFIX)), ptr, size)) {
+            ESP_LOGE(TAG, "Asset not found: %s", source.c_str());
+            finished_ = true;
+            return;
+        }
+        data_ = static_cast<const uint8_t*>(ptr);
+        data_size_ = size;
+        size_t wav_offset, wav_size;
+        if (ParseWavHeader(data_, size, wav_offset, wav_size)) {
+            data_offset_ = wav_offset;
+            data_size_ = std::min(wav_size, size - wav_offset);
+        }
+    } else {
+        file_ = fopen(source.c_str(), "rb");
+        if (file_ == nullptr) {
+            ESP_LOGE(TAG, "Failed to open %s", source.c_str());
+            finished_ = true;
+            return;
+        }
+        uint8_t header[WAV_HEADER_PROBE_SIZE];
+        size_t size = fread(header, 1, sizeof(header), file_);
+        size_t wav_offset, wav_size;
+        if (ParseWavHeader(header, size, wav_offset, wav_size)) {
+            file_data_offset_ = wav_offset;
+            data_size_ = wav_size;
+        } else {
+            fseek(file_, 0, SEEK_END);
+            data_size_ = ftell(file_);
+        }
+        fseek(file_, file_data_offset_, SEEK_SET);
+    }
+    ESP_LOGI(TAG, "Replaying %lu bytes from %s, %d Hz, %d channels", (unsigned long)data_size_, source.c_str(),
+        input_sample_rate_, input_channels_);
+}
+
+ReplayAudioCodec::~ReplayAudioCodec() {
+    if (file_ != nullptr) {
+        fclose(file_);
+    }
+}
+
+void ReplayAudioCodec::Configure(int sample_rate, int channels, int output_sample_rate) {
+    duplex_ = true;
+    input_sample_rate_ = sample_rate;
+    input_channels_ = channels;
+    input_reference_ = channels == 2;
+    output_sample_rate_ = output_sample_rate;
+}
+
+bool ReplayAudioCodec::ParseWavHeader(const uint8_t* header, size_t size, size_t& data_offset, size_t& data_size) {
+    if (size < 12 || memcmp(header, "RIFF", 4) != 0 || memcmp(header + 8, "WAVE", 4) != 0) {
+        return false;
+    }
+    size_t offset = 12;
+    while (offset + 8 <= size) {
+        uint32_t chunk_size;
+        memcpy(&chunk_size, header + offset + 4, sizeof(chunk_size));
+        if (memcmp(header + offset, "fmt ", 4) == 0 && offset + 8 + 16 <= size) {
+            uint16_t channels, bits;
+            uint32_t sample_rate;
+            memcpy(&channels, header + offset + 10, sizeof(channels));
+            memcpy(&sample_rate, header + offset + 12, sizeof(sample_rate));
+            memcpy(&bits, header + offset + 22, sizeof(bits));
+            if (bits != 16 || channels < 1 || channels > 2) {
+                ESP_LOGE(TAG, "Unsupported WAV format: %u channels, %u bits", channels, bits);
+                return false;
+            }
+            input_sample_rate_ = sample_rate;
+            input_channels_ = channels;
+            input_reference_ = channels == 2;
+        } else if (memcmp(header + offset, "data", 4) == 0) {
+            data_offset = offset + 8;
+            data_size = chunk_size;
+            return true;
+        }
+        // Chunks are padded to an even size
+        offset += 8 + chunk_size + (chunk_size & 1);
+    }
+    return false;
+}
+
+size_t ReplayAudioCodec::ReadSource(int16_t* dest, size_t bytes) {
+    bytes = std::min(bytes, data_size_ - read_offset_);
+    if (file_ != nullptr) {
+        bytes = fread(dest, 1, bytes, file_);
+    } else if (data_ != nullptr) {
+        memcpy(dest, data_ + data_offset_ + read_offset_, bytes);
+    } else {
+        bytes = 0;
+    }
+    read_offset_ += bytes;
+    return bytes;
+}
+
+void ReplayAudioCodec::WaitUntil(int64_t& start_time, uint64_t frames, int sample_rate) {
+    int64_t now = esp_timer_get_time();
+    if (start_time == 0) {
+        start_time = now;
+    }
+    int speed = speed_percent_;
+    if (speed <= 0) {
+        // Let the lower priority tasks run
+        vTaskDelay(1);
+        return;
+    }
+    int64_t due = start_time + (int64_t)(frames * 1000000ULL * 100 / ((uint64_t)sample_rate * speed));
+    if (due - now >= portTICK_PERIOD_MS * 1000) {
+        vTaskDelay(pdMS_TO_TICKS((due - now) / 1000));
+    }
+}
+
+int ReplayAudioCodec::Read(int16_t* dest, int samples) {
+    size_t bytes = samples * sizeof(int16_t);
+    size_t read = 0;
+    while (read < bytes && !finished_) {
+        size_t n = ReadSource(dest + read / sizeof(int16_t), bytes - read);
+        read += n;
+        if (read < bytes && (n == 0 || read_offset_ >= data_size_)) {
+            if (loop_ && data_size_ > 0) {
+                read_offset_ = 0;
+                if (file_ != nullptr) {
+                    fseek(file_, file_data_offset_, SEEK_SET);
+                }
+            } else {
+                finished_ = true;
+                ESP_LOGI(TAG, "Replay finished");
+                PrintSummary();
+            }
+        }
+    }
+    // Silence after the end of the recording
+    memset((uint8_t*)dest + read, 0, bytes - read);
+
+    input_position_ += samples / input_channels_;
+    WaitUntil(input_start_time_, input_position_, input_sample_rate_);
+    return samples;
+}
+
+int ReplayAudioCodec::Write(const int16_t* data, int samples) {
+    output_position_ += samples / output_channels_;
+    WaitUntil(output_start_time_, output_position_, output_sample_rate_);
+    return samples;
+}
+
+void ReplayAudioCodec::RecordWakeWord(const std::string& wake_word) {
+    uint64_t frame = input_position_;
+    ESP_LOGI(TAG, "Wake word '%s' at %.3f s (frame %llu)", wake_word.c_str(),
+        (double)frame / input_sample_rate_, (unsigned long long)frame);
+    std::lock_guard<std::mutex> lock(events_mutex_);
+    events_.push_back({frame, true, false, wake_word});
+}
+
+void ReplayAudioCodec::RecordVad(bool speaking) {
+    uint64_t frame = input_position_;
+    ESP_LOGI(TAG, "VAD %s at %.3f s (frame %llu)", speaking ? "speech" : "silence",
+        (double)frame / input_sample_rate_, (unsigned long long)frame);
+    std::lock_guard<std::mutex> lock(events_mutex_);
+    events_.push_back({frame, false, speaking, std::string()});
+}
+
+void ReplayAudioCodec::PrintSummary() {
+    std::lock_guard<std::mutex> lock(events_mutex_);
+    double duration = (double)input_position_ / input_sample_rate_;
+    int wake_words = 0;
+    int speech_segments = 0;
+    int latency_count = 0;
+    double latency_sum = 0;
+    double latency_max = 0;
+    // Frame of the speech onset the following detection belongs to, if any
+    int64_t speech_onset = -1;
+    for (const auto& event : events_) {
+        if (!event.wake_word) {
+            if (event.speaking) {
+                speech_segments++;
+                speech_onset = event.frame;
+            }
+            continue;
+        }
+        wake_words++;
+        if (speech_onset >= 0) {
+            double latency = (double)(event.frame - speech_onset) * 1000 / input_sample_rate_;
+            latency_sum += latency;
+            latency_max = std::max(latency_max, latency);
+            latency_count++;
+            speech_onset = -1;
+        }
+    }
+
+    ESP_LOGI(TAG, "Replayed %.1f s: %d speech segments, %d wake words (%.1f per hour)", duration, speech_segments,
+        wake_words, duration > 0 ? wake_words * 3600 / duration : 0.0);
+    if (latency_count > 0) {
+        ESP_LOGI(TAG, "Detection delay after speech onset: average %.0f ms, max %.0f ms",
+            latency_sum / latency_count, latency_max);
+    }
+}
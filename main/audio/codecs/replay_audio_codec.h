@@ -0,0 +1,80 @@
+#ifndef _REPLAY_AUDIO_CODEC_H
+#define _REPLAY_AUDIO_CODEC_H
+
+#include "audio_codec.h"
+
+#include <cstdio>
+#include <mutex>
+#include <atomic>
+#include <string>
+#include <vector>
+
+/*
+ * Feeds recorded audio to the pipeline instead of a microphone, so wake word and AEC problems can be
+ * reproduced without a live mic. The recording is 16-bit PCM, mono or interleaved mic + reference,
+ * either raw or in a WAV file, read from memory, a file or the assets partition ("asset:<name>").
+ * It is replayed at `speed_percent` of real time, 0 runs as fast as one read per tick.
+ * Output is discarded at the same pace.
+ *
+ * Pipeline events are recorded with the input frame at which they happened and summarized when the
+ * recording ends: wake word count and rate per hour (the false trigger rate on recordings without
+ * the wake word), and the delay between the speech onset and the detection.
+ */
+class ReplayAudioCodec : public AudioCodec {
+public:
+    // `data` must stay valid while the codec is used
+    ReplayAudioCodec(const void* data, size_t size, int sample_rate, int channels, int output_sample_rate);
+    ReplayAudioCodec(const std::string& source, int sample_rate, int channels, int output_sample_rate);
+    virtual ~ReplayAudioCodec();
+
+    void SetSpeed(int speed_percent) { speed_percent_ = speed_percent; }
+    void SetLoop(bool loop) { loop_ = loop; }
+    bool finished() const { return finished_; }
+    // Input frames delivered so far
+    uint64_t input_position() const { return input_position_; }
+
+    // Called by the application when a wake word is detected or the VAD state changes
+    void RecordWakeWord(const std::string& wake_word);
+    void RecordVad(bool speaking);
+    void PrintSummary();
+
+private:
+    struct Event {
+        uint64_t frame;
+        bool wake_word;     // Otherwise a VAD change
+        bool speaking;
+        std::string detail;
+    };
+
+    // Memory source, or the mapped asset
+    const uint8_t* data_ = nullptr;
+    size_t data_offset_ = 0;
+    size_t data_size_ = 0;
+    // File source
+    FILE* file_ = nullptr;
+    long file_data_offset_ = 0;
+
+    size_t read_offset_ = 0;
+    std::atomic<int> speed_percent_ = 100;
+    std::atomic<bool> loop_ = false;
+    std::atomic<bool> finished_ = false;
+    std::atomic<uint64_t> input_position_ = 0;
+    uint64_t output_position_ = 0;
+    int64_t input_start_time_ = 0;
+    int64_t output_start_time_ = 0;
+
+    std::mutex events_mutex_;
+    std::vector<Event> events_;
+
+    void Configure(int sample_rate, int channels, int output_sample_rate);
+    // Take the format and data range from a WAV header, returns false if `header` is not a WAV file
+    bool ParseWavHeader(const uint8_t* header, size_t size, size_t& data_offset, size_t& data_size);
+    size_t ReadSource(int16_t* dest, size_t bytes);
+    // Sleep until `frames` frames after `start_time` are due at the replay speed
+    void WaitUntil(int64_t& start_time, uint64_t frames, int sample_rate);
+
+    virtual int Read(int16_t* dest, int samples) override;
+    virtual int Write(const int16_t* data, int samples) override;
+};
+
+#endif // _REPLAY_AUDIO_CODEC_H
@@ -0,0 +1,32 @@
+#include "frame_chunker.h"
+
+#include <algorithm>
+
+
+void FrameChunker::Configure(size_t frame_samples) {
+    frame_samples_ = frame_samples;
+    Reset();
+}
+
+void FrameChunker::Reset() {
+    frame_.clear();
+    frame_.reserve(frame_samples_);
+}
+
+void FrameChunker::Push(const int16_t* data, size_t samples, const std::function<void(std::vector<int16_t>&&)>& emit) {
+    if (frame_samples_ == 0) {
+        return;
+    }
+    while (samples > 0) {
+        size_t count = std::min(samples, frame_samples_ - frame_.size());
+        frame_.insert(frame_.end(), data, data + count);
+        data += count;
+        samples -= count;
+        if (frame_.size() == frame_samples_) {
+            emit(std::move(frame_));
+            // The moved-from vector is empty, start the next frame at full capacity
+            frame_ = std::vector<int16_t>();
+            frame_.reserve(frame_samples_);
+        }
+    }
+}
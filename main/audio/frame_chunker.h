@@ -0,0 +1,30 @@
+#ifndef FRAME_CHUNKER_H
+#define FRAME_CHUNKER_H
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <functional>
+
+
+/*
+ * Cuts a stream of chunks of any size into frames of a fixed size, e.g. the 512 sample AFE fetches
+ * into 960 sample (60ms) encoder frames. Every sample is copied once, straight into the frame it
+ * belongs to, and the frame buffers are allocated at their final size, so frames keep the sample
+ * positions of the stream without shifting leftovers around.
+ */
+class FrameChunker {
+public:
+    void Configure(size_t frame_samples);
+    // Drop the partial frame
+    void Reset();
+    // Call `emit` with every frame completed by `samples`, the frame is moved out
+    void Push(const int16_t* data, size_t samples, const std::function<void(std::vector<int16_t>&&)>& emit);
+    size_t pending() const { return frame_.size(); }
+
+private:
+    size_t frame_samples_ = 0;
+    std::vector<int16_t> frame_;
+};
+
+#endif // FRAME_CHUNKER_H
@@ -0,0 +1,158 @@
+#include "ogg_opus_reader.h"
+
+#include <esp_log.h>
+#include <cstring>
+
+#define TAG "OggOpusReader"
+
+#define OGG_PAGE_HEADER_SIZE 27
+#define OGG_HEADER_TYPE_CONTINUED 0x01
+
+
+OggOpusReader::OggOpusReader(const std::string_view& ogg)
+    : data_(reinterpret_cast<const uint8_t*>(ogg.data())), size_(ogg.size()) {
+}
+
+void OggOpusReader::Rewind() {
+    next_page_offset_ = 0;
+    segment_table_ = nullptr;
+    segment_count_ = 0;
+    segment_index_ = 0;
+    body_offset_ = 0;
+    skip_continued_ = false;
+    partial_packet_.clear();
+    partial_packet_returned_ = false;
+    finished_ = false;
+}
+
+bool OggOpusReader::Open() {
+    Rewind();
+
+    const uint8_t* packet;
+    size_t size;
+    // OpusHead: [0-7] "OpusHead", [8] version, [9] channel_count, [10-11] pre_skip,
+    // [12-15] input_sample_rate, [16-17] output_gain, [18] mapping_family
+    if (!NextRawPacket(packet, size) || size < 19 || memcmp(packet, "OpusHead", 8) != 0) {
+        ESP_LOGE(TAG, "OpusHead not found");
+        return false;
+    }
+    channels_ = packet[9];
+    sample_rate_ = packet[12] | (packet[13] << 8) | (packet[14] << 16) | (packet[15] << 24);
+
+    // OpusTags may span several pages, NextRawPacket assembles it
+    if (!NextRawPacket(packet, size) || size < 8 || memcmp(packet, "OpusTags", 8) != 0) {
+        ESP_LOGE(TAG, "OpusTags not found");
+        return false;
+    }
+    ESP_LOGD(TAG, "OpusHead: channels=%d, sample_rate=%d", channels_, sample_rate_);
+    return true;
+}
+
+bool OggOpusReader::NextPacket(const uint8_t*& packet, size_t& size) {
+    while (NextRawPacket(packet, size)) {
+        if (size > 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool OggOpusReader::LoadNextPage() {
+    size_t offset = next_page_offset_;
+    // Resynchronize on the capture pattern if the stream is corrupted
+    while (offset + OGG_PAGE_HEADER_SIZE <= size_ && memcmp(data_ + offset, "OggS", 4) != 0) {
+        auto next = static_cast<const uint8_t*>(memchr(data_ + offset + 1, 'O', size_ - offset - 1));
+        if (next == nullptr) {
+            offset = size_;
+            break;
+        }
+        offset = next - data_;
+        partial_packet_.clear();
+    }
+    if (offset + OGG_PAGE_HEADER_SIZE > size_) {
+        return false;
+    }
+
+    const uint8_t* page = data_ + offset;
+    int segment_count = page[26];
+    size_t body_offset = offset + OGG_PAGE_HEADER_SIZE + segment_count;
+    if (body_offset > size_) {
+        return false;
+    }
+    size_t body_size = 0;
+    for (int i = 0; i < segment_count; i++) {
+        body_size += page[OGG_PAGE_HEADER_SIZE + i];
+    }
+    if (body_offset + body_size > size_) {
+        ESP_LOGW(TAG, "Truncated page at %u", offset);
+        return false;
+    }
+
+    // A continued packet without its beginning can not be decoded
+    if ((page[5] & OGG_HEADER_TYPE_CONTINUED) == 0) {
+        skip_continued_ = false;
+        partial_packet_.clear();
+    } else if (partial_packet_.empty()) {
+        skip_continued_ = true;
+    }
+
+    segment_table_ = page + OGG_PAGE_HEADER_SIZE;
+    segment_count_ = segment_count;
+    segment_index_ = 0;
+    body_offset_ = body_offset;
+    next_page_offset_ = body_offset + body_size;
+    return true;
+}
+
+bool OggOpusReader::NextRawPacket(const uint8_t*& packet, size_t& size) {
+    if (partial_packet_returned_) {
+        partial_packet_.clear();
+        partial_packet_returned_ = false;
+    }
+
+    while (true) {
+        if (segment_index_ >= segment_count_) {
+            if (!LoadNextPage()) {
+                finished_ = true;
+                return false;
+            }
+            continue;
+        }
+
+        // Lacing values of 255 mean the packet continues in the next segment
+        size_t start = body_offset_;
+        size_t length = 0;
+        uint8_t lacing = 0;
+        do {
+            lacing = segment_table_[segment_index_++];
+            length += lacing;
+        } while (lacing == 255 && segment_index_ < segment_count_);
+        body_offset_ += length;
+        bool complete = lacing < 255;
+
+        if (skip_continued_) {
+            if (complete) {
+                skip_continued_ = false;
+            }
+            continue;
+        }
+
+        if (!complete) {
+            // The packet continues on the next page
+            partial_packet_.insert(partial_packet_.end(), data_ + start, data_ + start + length);
+            continue;
+        }
+
+        if (!partial_packet_.empty()) {
+            partial_packet_.insert(partial_packet_.end(), data_ + start, data_ + start + length);
+            partial_packet_returned_ = true;
+            packet = partial_packet_.data();
+            size = partial_packet_.size();
+            return true;
+        }
+
+        packet = data_ + start;
+        size = length;
+        return true;
+    }
+}
@@ -0,0 +1,53 @@
+#ifndef OGG_OPUS_READER_H
+#define OGG_OPUS_READER_H
+
+#include <cstdint>
+#include <cstddef>
+#include <string_view>
+#include <vector>
+
+
+/*
+ * Reads Opus packets from an Ogg stream in memory, such as a sound embedded in the
+ * firmware or mapped from the assets partition. Pages are located through their
+ * segment tables, and the returned packets point directly into the stream unless a
+ * packet spans several pages, in which case it is assembled in an internal buffer.
+ */
+class OggOpusReader {
+public:
+    OggOpusReader(const std::string_view& ogg);
+
+    // Parse OpusHead and skip OpusTags, returns false if the stream is not Ogg Opus
+    bool Open();
+    // The returned packet is valid until the next call
+    bool NextPacket(const uint8_t*& packet, size_t& size);
+    void Rewind();
+
+    inline int sample_rate() const { return sample_rate_; }
+    inline int channels() const { return channels_; }
+    inline bool finished() const { return finished_; }
+    inline std::string_view ogg() const { return std::string_view(reinterpret_cast<const char*>(data_), size_); }
+
+private:
+    const uint8_t* data_;
+    size_t size_;
+
+    size_t next_page_offset_ = 0;
+    const uint8_t* segment_table_ = nullptr;
+    int segment_count_ = 0;
+    int segment_index_ = 0;
+    size_t body_offset_ = 0;
+    bool skip_continued_ = false;
+
+    std::vector<uint8_t> partial_packet_;
+    bool partial_packet_returned_ = false;
+
+    int sample_rate_ = 16000;
+    int channels_ = 1;
+    bool finished_ = false;
+
+    bool LoadNextPage();
+    bool NextRawPacket(const uint8_t*& packet, size_t& size);
+};
+
+#endif // OGG_OPUS_READER_H
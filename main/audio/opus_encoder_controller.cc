@@ -0,0 +1,84 @@
+#include "opus_encoder_controller.h"
+
+#include <esp_log.h>
+#include <algorithm>
+
+#define TAG "OpusEncoderController"
+
+#define EVALUATION_WINDOW_FRAMES 25
+#define HIGH_CPU_LOAD_PERCENT 50
+#define LOW_CPU_LOAD_PERCENT 15
+#define CONGESTED_QUEUE_PERCENT 25
+#define CLEAR_QUEUE_PERCENT 5
+#define RECOVERY_WINDOWS 4
+#define FEC_PACKET_LOSS_PERCENT 10
+
+// Level 0 lets the encoder choose, about 17kbps for 16kHz mono speech
+static const int kBitrateLevels[] = { 0, 14000, 12000, 10000, 8000 };
+static const int kBitrateLevelCount = sizeof(kBitrateLevels) / sizeof(kBitrateLevels[0]);
+
+
+OpusEncoderController::OpusEncoderController(int max_complexity, int preferred_frame_duration)
+    : max_complexity_(max_complexity), preferred_frame_duration_(preferred_frame_duration) {
+}
+
+void OpusEncoderController::Reset() {
+    frames_ = 0;
+    encode_time_us_ = 0;
+    realtime_us_ = 0;
+    queue_depth_sum_ = 0;
+    queue_capacity_ = 0;
+}
+
+int OpusEncoderController::PreferredFrameDuration() const {
+    return congested_ ? 60 : preferred_frame_duration_;
+}
+
+bool OpusEncoderController::RecordFrame(int64_t encode_time_us, int frame_duration_ms, size_t send_queue_depth, size_t send_queue_capacity) {
+    frames_++;
+    encode_time_us_ += encode_time_us;
+    realtime_us_ += frame_duration_ms * 1000;
+    queue_depth_sum_ += send_queue_depth;
+    queue_capacity_ = send_queue_capacity;
+    if (frames_ < EVALUATION_WINDOW_FRAMES) {
+        return false;
+    }
+    bool changed = Evaluate();
+    Reset();
+    return changed;
+}
+
+bool OpusEncoderController::Evaluate() {
+    int cpu_load = realtime_us_ > 0 ? int(encode_time_us_ * 100 / realtime_us_) : 0;
+    int queue_load = queue_capacity_ > 0 ? int(queue_depth_sum_ * 100 / (frames_ * queue_capacity_)) : 0;
+    OpusEncoderProfile last = profile_;
+
+    // The encoder shares the CPU with the audio processor, back off quickly and raise slowly
+    if (cpu_load > HIGH_CPU_LOAD_PERCENT) {
+        profile_.complexity = std::max(0, profile_.complexity - 2);
+    } else if (cpu_load < LOW_CPU_LOAD_PERCENT && queue_load < CLEAR_QUEUE_PERCENT) {
+        profile_.complexity = std::min(max_complexity_, profile_.complexity + 1);
+    }
+
+    if (queue_load > CONGESTED_QUEUE_PERCENT) {
+        bitrate_level_ = std::min(kBitrateLevelCount - 1, bitrate_level_ + 1);
+        congested_ = true;
+        good_windows_ = 0;
+    } else if (queue_load < CLEAR_QUEUE_PERCENT && congested_) {
+        if (++good_windows_ >= RECOVERY_WINDOWS) {
+            good_windows_ = 0;
+            bitrate_level_ = std::max(0, bitrate_level_ - 1);
+            congested_ = bitrate_level_ > 0;
+        }
+    }
+    profile_.bitrate = kBitrateLevels[bitrate_level_];
+    profile_.fec = congested_;
+    profile_.packet_loss_percent = congested_ ? FEC_PACKET_LOSS_PERCENT : 0;
+
+    if (profile_.complexity == last.complexity && profile_.bitrate == last.bitrate && profile_.fec == last.fec) {
+        return false;
+    }
+    ESP_LOGI(TAG, "cpu %d%%, queue %d%% -> complexity %d, bitrate %d, fec %d",
+        cpu_load, queue_load, profile_.complexity, profile_.bitrate, profile_.fec);
+    return true;
+}
@@ -0,0 +1,51 @@
+#ifndef OPUS_ENCODER_CONTROLLER_H
+#define OPUS_ENCODER_CONTROLLER_H
+
+#include <cstdint>
+#include <cstddef>
+
+
+struct OpusEncoderProfile {
+    int complexity = 0;
+    int bitrate = 0;    // 0 lets the encoder choose
+    bool fec = false;
+    int packet_loss_percent = 0;
+};
+
+/*
+ * Chooses the uplink encoder parameters from what is measured while encoding.
+ * The encode time per frame tells how much CPU headroom is left, and the depth of the send queue
+ * tells whether the link keeps up. Complexity follows the CPU headroom, the bitrate steps down and
+ * in-band FEC is enabled while the send queue backs up, and both recover after a few good windows.
+ * The frame duration can only change when a new audio channel is negotiated, long frames are
+ * preferred after congestion because they have less packet overhead.
+ */
+class OpusEncoderController {
+public:
+    OpusEncoderController(int max_complexity, int preferred_frame_duration);
+
+    // Returns true when the profile changed at the end of an evaluation window
+    bool RecordFrame(int64_t encode_time_us, int frame_duration_ms, size_t send_queue_depth, size_t send_queue_capacity);
+    const OpusEncoderProfile& profile() const { return profile_; }
+    int PreferredFrameDuration() const;
+    void Reset();
+
+private:
+    int max_complexity_;
+    int preferred_frame_duration_;
+    OpusEncoderProfile profile_;
+    int bitrate_level_ = 0;
+    bool congested_ = false;
+    int good_windows_ = 0;
+
+    // Current evaluation window
+    int frames_ = 0;
+    int64_t encode_time_us_ = 0;
+    int64_t realtime_us_ = 0;
+    size_t queue_depth_sum_ = 0;
+    size_t queue_capacity_ = 0;
+
+    bool Evaluate();
+};
+
+#endif // OPUS_ENCODER_CONTROLLER_H
@@ -0,0 +1,83 @@
+#include "pcm_ring.h"
+#include "memory_accounting.h"
+
+#include <esp_log.h>
+#include <esp_heap_caps.h>
+#include <esp_attr.h>
+#include <algorithm>
+#include <cstring>
+
+#define TAG "PcmRing"
+
+
+PcmRing::PcmRing(size_t capacity) {
+    // A power of two keeps the offsets continuous when the counters wrap around
+    capacity_ = 1;
+    while (capacity_ < capacity) {
+        capacity_ <<= 1;
+    }
+    // Accessed from the I2S interrupt, keep it in internal RAM
+    buffer_ = static_cast<int16_t*>(MemoryAccounting::Malloc(kMemoryTagAudio, capacity_ * sizeof(int16_t), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT));
+    if (buffer_ == nullptr) {
+        ESP_LOGE(TAG, "Failed to allocate %u samples", capacity_);
+        capacity_ = 0;
+    }
+}
+
+PcmRing::~PcmRing() {
+    MemoryAccounting::Free(kMemoryTagAudio, buffer_);
+}
+
+int16_t* IRAM_ATTR PcmRing::PeekWrite(size_t& samples) {
+    size_t head = head_.load(std::memory_order_relaxed);
+    size_t free = capacity_ - (head - tail_.load(std::memory_order_acquire));
+    size_t offset = head & (capacity_ - 1);
+    samples = std::min({samples, free, capacity_ - offset});
+    return buffer_ + offset;
+}
+
+void IRAM_ATTR PcmRing::CommitWrite(size_t samples) {
+    head_.store(head_.load(std::memory_order_relaxed) + samples, std::memory_order_release);
+}
+
+const int16_t* IRAM_ATTR PcmRing::PeekRead(size_t& samples) {
+    size_t tail = tail_.load(std::memory_order_relaxed);
+    size_t filled = head_.load(std::memory_order_acquire) - tail;
+    size_t offset = tail & (capacity_ - 1);
+    samples = std::min({samples, filled, capacity_ - offset});
+    return buffer_ + offset;
+}
+
+void IRAM_ATTR PcmRing::CommitRead(size_t samples) {
+    tail_.store(tail_.load(std::memory_order_relaxed) + samples, std::memory_order_release);
+}
+
+size_t PcmRing::Write(const int16_t* data, size_t samples) {
+    size_t written = 0;
+    while (written < samples) {
+        size_t count = samples - written;
+        int16_t* dest = PeekWrite(count);
+        if (count == 0) {
+            break;
+        }
+        memcpy(dest, data + written, count * sizeof(int16_t));
+        CommitWrite(count);
+        written += count;
+    }
+    return written;
+}
+
+size_t PcmRing::Read(int16_t* data, size_t samples) {
+    size_t read = 0;
+    while (read < samples) {
+        size_t count = samples - read;
+        const int16_t* src = PeekRead(count);
+        if (count == 0) {
+            break;
+        }
+        memcpy(data + read, src, count * sizeof(int16_t));
+        CommitRead(count);
+        read += count;
+    }
+    return read;
+}
@@ -0,0 +1,43 @@
+#ifndef PCM_RING_H
+#define PCM_RING_H
+
+#include <cstdint>
+#include <cstddef>
+#include <atomic>
+
+
+/*
+ * Lock-free ring of 16-bit samples for one producer and one consumer, one of which may be an interrupt.
+ * PeekWrite / PeekRead expose the contiguous part of the free or filled space, so samples can be converted
+ * straight between the ring and a DMA buffer.
+ */
+class PcmRing {
+public:
+    explicit PcmRing(size_t capacity);
+    ~PcmRing();
+    PcmRing(const PcmRing&) = delete;
+    PcmRing& operator=(const PcmRing&) = delete;
+
+    inline size_t capacity() const { return capacity_; }
+    inline size_t available() const { return head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_acquire); }
+    inline size_t space() const { return capacity_ - available(); }
+
+    // Producer side
+    int16_t* PeekWrite(size_t& samples);
+    void CommitWrite(size_t samples);
+    size_t Write(const int16_t* data, size_t samples);
+
+    // Consumer side
+    const int16_t* PeekRead(size_t& samples);
+    void CommitRead(size_t samples);
+    size_t Read(int16_t* data, size_t samples);
+
+private:
+    int16_t* buffer_ = nullptr;
+    size_t capacity_;
+    // Total samples written and read, the difference is the fill level
+    std::atomic<size_t> head_ = 0;
+    std::atomic<size_t> tail_ = 0;
+};
+
+#endif // PCM_RING_H
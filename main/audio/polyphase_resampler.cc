@@ -0,0 +1,175 @@
+#include "polyphase_resampler.h"
+
+#include <esp_log.h>
+#include <algorithm>
+#include <numeric>
+#include <cstring>
+#include <cmath>
+#include <mutex>
+
+#define TAG "PolyphaseResampler"
+
+#define BASE_TAPS 32
+#define MAX_TAPS 128
+#define MAX_PHASES 512
+#define COEFFICIENT_SHIFT 14
+// Pass band edge relative to the lower of the two Nyquist frequencies
+#define CUTOFF_RATIO 0.9
+
+
+struct PolyphaseResampler::FilterTable {
+    int up;
+    int down;
+    int taps;
+    // Phase-major, each phase stored in the order of the input samples it is applied to
+    std::vector<int16_t> coefficients;
+};
+
+static std::shared_ptr<const PolyphaseResampler::FilterTable> BuildFilterTable(int up, int down) {
+    auto table = std::make_shared<PolyphaseResampler::FilterTable>();
+    table->up = up;
+    table->down = down;
+    // Decimation needs a longer filter to keep the same transition band at the output rate
+    table->taps = std::min(MAX_TAPS, BASE_TAPS * std::max(1, (down + up - 1) / up));
+    table->coefficients.resize(up * table->taps);
+
+    int length = up * table->taps;
+    double cutoff = CUTOFF_RATIO * 0.5 / std::max(up, down);
+    double center = (length - 1) / 2.0;
+    std::vector<double> prototype(length);
+    for (int k = 0; k < length; k++) {
+        double x = k - center;
+        double sinc = x == 0 ? 2 * cutoff : sin(2 * M_PI * cutoff * x) / (M_PI * x);
+        double window = 0.42 - 0.5 * cos(2 * M_PI * (k + 0.5) / length) + 0.08 * cos(4 * M_PI * (k + 0.5) / length);
+        prototype[k] = sinc * window;
+    }
+
+    for (int phase = 0; phase < up; phase++) {
+        // Normalize each phase to unity gain at DC, then quantize keeping the sum exact
+        double sum = 0;
+        for (int j = 0; j < table->taps; j++) {
+            sum += prototype[j * up + phase];
+        }
+        int16_t* coefficients = &table->coefficients[phase * table->taps];
+        int total = 0;
+        int largest = 0;
+        for (int t = 0; t < table->taps; t++) {
+            // Tap t multiplies the t-th oldest of the input samples in the window
+            double value = prototype[(table->taps - 1 - t) * up + phase] / sum;
+            coefficients[t] = static_cast<int16_t>(lround(value * (1 << COEFFICIENT_SHIFT)));
+            total += coefficients[t];
+            if (abs(coefficients[t]) > abs(coefficients[largest])) {
+                largest = t;
+            }
+        }
+        coefficients[largest] += (1 << COEFFICIENT_SHIFT) - total;
+    }
+    return table;
+}
+
+static std::shared_ptr<const PolyphaseResampler::FilterTable> GetFilterTable(int up, int down) {
+    static std::mutex mutex;
+    static std::vector<std::weak_ptr<const PolyphaseResampler::FilterTable>> tables;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto it = tables.begin(); it != tables.end();) {
+        auto table = it->lock();
+        if (!table) {
+            it = tables.erase(it);
+            continue;
+        }
+        if (table->up == up && table->down == down) {
+            return table;
+        }
+        ++it;
+    }
+    auto table = BuildFilterTable(up, down);
+    tables.push_back(table);
+    ESP_LOGI(TAG, "Built filter %d/%d with %d taps per phase", up, down, table->taps);
+    return table;
+}
+
+
+PolyphaseResampler::PolyphaseResampler() {
+}
+
+PolyphaseResampler::~PolyphaseResampler() {
+}
+
+void PolyphaseResampler::Configure(int input_sample_rate, int output_sample_rate) {
+    if (input_sample_rate == input_sample_rate_ && output_sample_rate == output_sample_rate_) {
+        return;
+    }
+    input_sample_rate_ = input_sample_rate;
+    output_sample_rate_ = output_sample_rate;
+    table_.reset();
+
+    if (input_sample_rate != output_sample_rate) {
+        int divisor = std::gcd(input_sample_rate, output_sample_rate);
+        int up = output_sample_rate / divisor;
+        int down = input_sample_rate / divisor;
+        if (up > MAX_PHASES) {
+            ESP_LOGE(TAG, "Unsupported ratio %d -> %d", input_sample_rate, output_sample_rate);
+        } else {
+            table_ = GetFilterTable(up, down);
+        }
+    }
+    Reset();
+}
+
+void PolyphaseResampler::Reset() {
+    work_.assign(table_ ? table_->taps - 1 : 0, 0);
+    position_ = 0;
+    phase_ = 0;
+}
+
+int PolyphaseResampler::GetOutputSamples(int input_samples) const {
+    if (!table_) {
+        return input_samples;
+    }
+    int64_t span = int64_t(input_samples - position_) * table_->up - phase_;
+    if (span <= 0) {
+        return 0;
+    }
+    return int((span + table_->down - 1) / table_->down);
+}
+
+int PolyphaseResampler::Process(const int16_t* input, int input_samples, int16_t* output) {
+    if (!table_) {
+        memcpy(output, input, input_samples * sizeof(int16_t));
+        return input_samples;
+    }
+
+    const int taps = table_->taps;
+    const int up = table_->up;
+    const int down = table_->down;
+    const int history = taps - 1;
+    work_.resize(history + input_samples);
+    memcpy(work_.data() + history, input, input_samples * sizeof(int16_t));
+
+    int count = 0;
+    while (position_ < input_samples) {
+        // The window ends at the input sample at position_, preceded by taps - 1 samples
+        const int16_t* x = work_.data() + position_;
+        const int16_t* c = table_->coefficients.data() + phase_ * taps;
+        int32_t acc = 1 << (COEFFICIENT_SHIFT - 1);
+        for (int t = 0; t < taps; t++) {
+            acc += int32_t(c[t]) * x[t];
+        }
+        output[count++] = static_cast<int16_t>(std::clamp<int32_t>(acc >> COEFFICIENT_SHIFT, -32768, 32767));
+
+        phase_ += down;
+        position_ += phase_ / up;
+        phase_ %= up;
+    }
+
+    memmove(work_.data(), work_.data() + input_samples, history * sizeof(int16_t));
+    work_.resize(history);
+    position_ -= input_samples;
+    return count;
+}
+
+void PolyphaseResampler::Process(const int16_t* input, int input_samples, std::vector<int16_t>& output) {
+    output.resize(GetOutputSamples(input_samples));
+    output.resize(Process(input, input_samples, output.data()));
+}
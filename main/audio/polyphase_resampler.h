@@ -0,0 +1,47 @@
+#ifndef POLYPHASE_RESAMPLER_H
+#define POLYPHASE_RESAMPLER_H
+
+#include <cstdint>
+#include <vector>
+#include <memory>
+
+
+/*
+ * Streaming rational-ratio resampler for 16-bit mono PCM.
+ * The rates are reduced to L/M (e.g. 24kHz -> 16kHz is 2/3, 24kHz -> 44.1kHz is 147/80) and a windowed-sinc
+ * low-pass filter is split into L phases of Q14 coefficients. Each output sample is one short integer dot product.
+ * Coefficient tables are built once per rate pair and shared between instances, e.g. the mic and reference channels.
+ * Process does not allocate once its work buffer has grown to the largest frame.
+ */
+class PolyphaseResampler {
+public:
+    PolyphaseResampler();
+    ~PolyphaseResampler();
+
+    // Reconfiguring with the current rates keeps the filter state
+    void Configure(int input_sample_rate, int output_sample_rate);
+    void Reset();
+    // Exact number of samples the next Process call produces for `input_samples`
+    int GetOutputSamples(int input_samples) const;
+    // Returns the number of samples written to output
+    int Process(const int16_t* input, int input_samples, int16_t* output);
+    // Resample into `output`, resizing it to the produced samples
+    void Process(const int16_t* input, int input_samples, std::vector<int16_t>& output);
+
+    inline int input_sample_rate() const { return input_sample_rate_; }
+    inline int output_sample_rate() const { return output_sample_rate_; }
+
+    struct FilterTable;
+
+private:
+    int input_sample_rate_ = 0;
+    int output_sample_rate_ = 0;
+    std::shared_ptr<const FilterTable> table_;
+    // The last taps - 1 input samples, followed by the input of the current call
+    std::vector<int16_t> work_;
+    // Position of the next output: input sample index relative to the current call, and phase
+    int position_ = 0;
+    int phase_ = 0;
+};
+
+#endif // POLYPHASE_RESAMPLER_H
@@ -12,10 +12,7 @@ AfeAudioProcessor::AfeAudioProcessor()
 
 void AfeAudioProcessor::Initialize(AudioCodec* codec, int frame_duration_ms, srmodel_list_t* models_list) {
     codec_ = codec;
-    frame_samples_ = frame_duration_ms * 16000 / 1000;
-
-    // Pre-allocate output buffer capacity
-    output_buffer_.reserve(frame_samples_);
+    output_chunker_.Configure(frame_duration_ms * 16000 / 1000);
 
     int ref_num = codec_->input_reference() ? 1 : 0;
 
@@ -59,6 +56,7 @@ void AfeAudioProcessor::Initialize(AudioCodec* codec, int frame_duration_ms, srm
 #ifdef CONFIG_USE_DEVICE_AEC
     afe_config->aec_init = true;
     afe_config->vad_init = false;
+    vad_enabled_ = false;
 #else
     afe_config->aec_init = false;
     afe_config->vad_init = true;
@@ -88,14 +86,16 @@ size_t AfeAudioProcessor::GetFeedSize() {
     return afe_iface_->get_feed_chunksize(afe_data_);
 }
 
-void AfeAudioProcessor::Feed(std::vector<int16_t>&& data) {
+void AfeAudioProcessor::Feed(const AudioFrame& frame) {
     if (afe_data_ == nullptr) {
         return;
     }
-    afe_iface_->feed(afe_data_, data.data());
+    // The AFE copies the interleaved frame into its own ring
+    afe_iface_->feed(afe_data_, frame.data);
 }
 
 void AfeAudioProcessor::Start() {
+    reset_output_ = true;
     xEventGroupSetBits(event_group_, PROCESSOR_RUNNING);
 }
 
@@ -140,34 +140,28 @@ void AfeAudioProcessor::AudioProcessorTask() {
 
         // VAD state change
         if (vad_state_change_callback_) {
-            if (res->vad_state == VAD_SPEECH && !is_speaking_) {
-                is_speaking_ = true;
-                vad_state_change_callback_(true);
-            } else if (res->vad_state == VAD_SILENCE && is_speaking_) {
-                is_speaking_ = false;
-                vad_state_change_callback_(false);
+            bool speaking = is_speaking_;
+            if (vad_enabled_) {
+                if (res->vad_state == VAD_SPEECH) {
+                    speaking = true;
+                } else if (res->vad_state == VAD_SILENCE) {
+                    speaking = false;
+                }
+            } else {
+                speaking = energy_vad_.Process(res->data, res->data_size / sizeof(int16_t));
+            }
+            if (speaking != is_speaking_) {
+                is_speaking_ = speaking;
+                vad_state_change_callback_(speaking);
             }
         }
 
+        if (reset_output_.exchange(false)) {
+            output_chunker_.Reset();
+        }
         if (output_callback_) {
-            size_t samples = res->data_size / sizeof(int16_t);
-            
-            // Add data to buffer
-            output_buffer_.insert(output_buffer_.end(), res->data, res->data + samples);
-            
-            // Output complete frames when buffer has enough data
-            while (output_buffer_.size() >= frame_samples_) {
-                if (output_buffer_.size() == frame_samples_) {
-                    // If buffer size equals frame size, move the entire buffer
-                    output_callback_(std::move(output_buffer_));
-                    output_buffer_.clear();
-                    output_buffer_.reserve(frame_samples_);
-                } else {
-                    // If buffer size exceeds frame size, copy one frame and remove it
-                    output_callback_(std::vector<int16_t>(output_buffer_.begin(), output_buffer_.begin() + frame_samples_));
-                    output_buffer_.erase(output_buffer_.begin(), output_buffer_.begin() + frame_samples_);
-                }
-            }
+            // Output complete frames, the rest waits for the next fetch
+            output_chunker_.Push(res->data, res->data_size / sizeof(int16_t), output_callback_);
         }
     }
 }
@@ -177,11 +171,14 @@ void AfeAudioProcessor::EnableDeviceAec(bool enable) {
 #if CONFIG_USE_DEVICE_AEC
         afe_iface_->disable_vad(afe_data_);
         afe_iface_->enable_aec(afe_data_);
+        energy_vad_.Reset();
+        vad_enabled_ = false;
 #else
         ESP_LOGE(TAG, "Device AEC is not supported");
 #endif
     } else {
         afe_iface_->disable_aec(afe_data_);
         afe_iface_->enable_vad(afe_data_);
+        vad_enabled_ = true;
     }
 }
@@ -9,9 +9,12 @@
 #include <string>
 #include <vector>
 #include <functional>
+#include <atomic>
 
 #include "audio_processor.h"
 #include "audio_codec.h"
+#include "energy_vad.h"
+#include "frame_chunker.h"
 
 class AfeAudioProcessor : public AudioProcessor {
 public:
@@ -19,7 +22,7 @@ public:
     ~AfeAudioProcessor();
 
     void Initialize(AudioCodec* codec, int frame_duration_ms, srmodel_list_t* models_list) override;
-    void Feed(std::vector<int16_t>&& data) override;
+    void Feed(const AudioFrame& frame) override;
     void Start() override;
     void Stop() override;
     bool IsRunning() override;
@@ -35,9 +38,13 @@ private:
     std::function<void(std::vector<int16_t>&& data)> output_callback_;
     std::function<void(bool speaking)> vad_state_change_callback_;
     AudioCodec* codec_ = nullptr;
-    int frame_samples_ = 0;
     bool is_speaking_ = false;
-    std::vector<int16_t> output_buffer_;
+    // The VAD model is disabled while the device AEC runs, the energy VAD is used instead
+    bool vad_enabled_ = true;
+    EnergyVad energy_vad_;
+    FrameChunker output_chunker_;
+    // Set by Start, the partial frame of the previous session is dropped by the processor task
+    std::atomic<bool> reset_output_ = false;
 
     void AudioProcessorTask();
 };
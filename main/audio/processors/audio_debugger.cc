@@ -1,49 +1,153 @@
 #include "audio_debugger.h"
 #include "sdkconfig.h"
 
+#include <algorithm>
+#include <cstring>
+
 #if CONFIG_USE_AUDIO_DEBUGGER
 #include <esp_log.h>
+#include <esp_timer.h>
 #include <arpa/inet.h>
 #include <unistd.h>
 #include <errno.h>
-#include <cstring>
 #include <string>
 #endif
 
 #define TAG "AudioDebugger"
 
+#define AUDIO_DEBUG_SENDER_STACK_SIZE 4096
+#define AUDIO_DEBUG_DROP_LOG_INTERVAL_MS 5000
+
+
+static const int16_t kImaStepTable[89] = {
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+    50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209, 230, 253, 279, 307,
+    337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066,
+    2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899,
+    15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767,
+};
+
+static const int8_t kImaIndexTable[16] = {
+    -1, -1, -1, -1, 2, 4, 6, 8,
+    -1, -1, -1, -1, 2, 4, 6, 8,
+};
+
+size_t AudioDebugger::AdpcmSize(size_t frames, int channels) {
+    return channels * (4 + (frames + 1) / 2);
+}
+
+void AudioDebugger::EncodeAdpcm(const int16_t* pcm, size_t frames, int channels, uint8_t* step_index, uint8_t* output) {
+    uint8_t* data = output + channels * 4;
+    for (int ch = 0; ch < channels; ch++) {
+        int predictor = frames > 0 ? pcm[ch] : 0;
+        int index = std::min<int>(step_index[ch], 88);
+        output[ch * 4] = predictor & 0xFF;
+        output[ch * 4 + 1] = (predictor >> 8) & 0xFF;
+        output[ch * 4 + 2] = index;
+        output[ch * 4 + 3] = 0;
+
+        for (size_t i = 0; i < frames; i++) {
+            int step = kImaStepTable[index];
+            int diff = pcm[i * channels + ch] - predictor;
+            int nibble = 0;
+            if (diff < 0) {
+                nibble = 8;
+                diff = -diff;
+            }
+            // Same rounding as the decoder, so both track the same predictor
+            int delta = step >> 3;
+            if (diff >= step) { nibble |= 4; diff -= step; delta += step; }
+            step >>= 1;
+            if (diff >= step) { nibble |= 2; diff -= step; delta += step; }
+            step >>= 1;
+            if (diff >= step) { nibble |= 1; delta += step; }
+
+            predictor += (nibble & 8) ? -delta : delta;
+            predictor = std::clamp(predictor, -32768, 32767);
+            index = std::clamp(index + kImaIndexTable[nibble], 0, 88);
+
+            if (i % 2 == 0) {
+                data[i / 2] = nibble;
+            } else {
+                data[i / 2] |= nibble << 4;
+            }
+        }
+        step_index[ch] = index;
+        data += (frames + 1) / 2;
+    }
+}
 
 AudioDebugger::AudioDebugger() {
+#if CONFIG_USE_AUDIO_DEBUGGER
+    uint32_t tap_mask = 0;
+#if CONFIG_AUDIO_DEBUG_TAP_MIC
+    tap_mask |= 1 << kAudioDebugTapMic;
+#endif
+#if CONFIG_AUDIO_DEBUG_TAP_AFE
+    tap_mask |= 1 << kAudioDebugTapAfe;
+#endif
+#if CONFIG_AUDIO_DEBUG_TAP_DOWNLINK
+    tap_mask |= 1 << kAudioDebugTapDownlink;
+#endif
+
+    ring_ = xRingbufferCreate(CONFIG_AUDIO_DEBUG_RING_BUFFER_SIZE, RINGBUF_TYPE_NOSPLIT);
+    if (ring_ == nullptr) {
+        ESP_LOGE(TAG, "Failed to create ring buffer");
+        return;
+    }
+    packet_.resize(sizeof(AudioDebugHeader) + AUDIO_DEBUG_MAX_PAYLOAD);
+    running_ = true;
+    sender_running_ = true;
+    tap_mask_ = tap_mask;
+    xTaskCreate([](void* arg) {
+        auto debugger = (AudioDebugger*)arg;
+        debugger->SenderTask();
+        debugger->sender_running_ = false;
+        vTaskDelete(NULL);
+    }, "audio_debugger", AUDIO_DEBUG_SENDER_STACK_SIZE, this, 1, nullptr);
+#endif
+}
+
+bool AudioDebugger::OpenSocket() {
 #if CONFIG_USE_AUDIO_DEBUGGER
     udp_sockfd_ = socket(AF_INET, SOCK_DGRAM, 0);
-    if (udp_sockfd_ >= 0) {
-        // 解析配置的服务器地址 "IP:PORT"
-        std::string server_addr = CONFIG_AUDIO_DEBUG_UDP_SERVER;
-        size_t colon_pos = server_addr.find(':');
-        
-        if (colon_pos != std::string::npos) {
-            std::string ip = server_addr.substr(0, colon_pos);
-            int port = std::stoi(server_addr.substr(colon_pos + 1));
-            
-            memset(&udp_server_addr_, 0, sizeof(udp_server_addr_));
-            udp_server_addr_.sin_family = AF_INET;
-            udp_server_addr_.sin_port = htons(port);
-            inet_pton(AF_INET, ip.c_str(), &udp_server_addr_.sin_addr);
-            
-            ESP_LOGI(TAG, "Initialized server address: %s", CONFIG_AUDIO_DEBUG_UDP_SERVER);
-        } else {
-            ESP_LOGW(TAG, "Invalid server address: %s, should be IP:PORT", CONFIG_AUDIO_DEBUG_UDP_SERVER);
-            close(udp_sockfd_);
-            udp_sockfd_ = -1;
-        }
-    } else {
+    if (udp_sockfd_ < 0) {
         ESP_LOGW(TAG, "Failed to create UDP socket: %d", errno);
+        return false;
     }
+    // 解析配置的服务器地址 "IP:PORT"
+    std::string server_addr = CONFIG_AUDIO_DEBUG_UDP_SERVER;
+    size_t colon_pos = server_addr.find(':');
+    if (colon_pos == std::string::npos) {
+        ESP_LOGW(TAG, "Invalid server address: %s, should be IP:PORT", CONFIG_AUDIO_DEBUG_UDP_SERVER);
+        close(udp_sockfd_);
+        udp_sockfd_ = -1;
+        return false;
+    }
+    std::string ip = server_addr.substr(0, colon_pos);
+    int port = std::stoi(server_addr.substr(colon_pos + 1));
+
+    memset(&udp_server_addr_, 0, sizeof(udp_server_addr_));
+    udp_server_addr_.sin_family = AF_INET;
+    udp_server_addr_.sin_port = htons(port);
+    inet_pton(AF_INET, ip.c_str(), &udp_server_addr_.sin_addr);
+    ESP_LOGI(TAG, "Initialized server address: %s", CONFIG_AUDIO_DEBUG_UDP_SERVER);
+    return true;
+#else
+    return false;
 #endif
 }
 
 AudioDebugger::~AudioDebugger() {
 #if CONFIG_USE_AUDIO_DEBUGGER
+    tap_mask_ = 0;
+    running_ = false;
+    while (sender_running_) {
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+    if (ring_ != nullptr) {
+        vRingbufferDelete(ring_);
+    }
     if (udp_sockfd_ >= 0) {
         close(udp_sockfd_);
         ESP_LOGI(TAG, "Closed UDP socket");
@@ -51,18 +155,93 @@ AudioDebugger::~AudioDebugger() {
 #endif
 }
 
-void AudioDebugger::Feed(const std::vector<int16_t>& data) {
+void AudioDebugger::Feed(AudioDebugTap tap, const int16_t* data, size_t samples, int sample_rate, int channels) {
 #if CONFIG_USE_AUDIO_DEBUGGER
-    if (udp_sockfd_ >= 0) {
-        ssize_t sent = sendto(udp_sockfd_, data.data(), data.size() * sizeof(int16_t), 0,
+    if (!IsTapEnabled(tap) || channels <= 0 || sample_rate <= 0) {
+        return;
+    }
+    int64_t timestamp = esp_timer_get_time();
+    size_t total_frames = samples / channels;
+    size_t max_frames = AUDIO_DEBUG_MAX_PAYLOAD / (sizeof(int16_t) * channels);
+
+    /* Split into packets that fit in a datagram, each copied into the ring without waiting */
+    for (size_t offset = 0; offset < total_frames; offset += max_frames) {
+        size_t frames = std::min(max_frames, total_frames - offset);
+        size_t pcm_bytes = frames * channels * sizeof(int16_t);
+        uint32_t sequence = sequence_[tap]++;
+
+        void* item = nullptr;
+        if (xRingbufferSendAcquire(ring_, &item, sizeof(AudioDebugHeader) + pcm_bytes, 0) != pdTRUE) {
+            dropped_++;
+            continue;
+        }
+        AudioDebugHeader header = {
+            .magic = AUDIO_DEBUG_MAGIC,
+            .version = AUDIO_DEBUG_VERSION,
+            .tap = (uint8_t)tap,
+            .format = kAudioDebugFormatPcm16,
+            .channels = (uint8_t)channels,
+            .samples = (uint16_t)frames,
+            .sequence = sequence,
+            .sample_rate = (uint32_t)sample_rate,
+            .timestamp_us = timestamp + (int64_t)offset * 1000000 / sample_rate,
+        };
+        memcpy(item, &header, sizeof(header));
+        memcpy((uint8_t*)item + sizeof(header), data + offset * channels, pcm_bytes);
+        xRingbufferSendComplete(ring_, item);
+    }
+#endif
+}
+
+void AudioDebugger::SenderTask() {
+#if CONFIG_USE_AUDIO_DEBUGGER
+    int64_t last_drop_log_time = 0;
+    while (running_) {
+        size_t size = 0;
+        auto item = (uint8_t*)xRingbufferReceive(ring_, &size, pdMS_TO_TICKS(100));
+        if (item == nullptr) {
+            continue;
+        }
+        // The socket is opened with the first packet, the network is not up yet when the debugger is created
+        if (udp_sockfd_ < 0 && !OpenSocket()) {
+            tap_mask_ = 0;
+            vRingbufferReturnItem(ring_, item);
+            continue;
+        }
+
+        AudioDebugHeader header;
+        memcpy(&header, item, sizeof(header));
+        size_t payload_size = size - sizeof(header);
+#if CONFIG_AUDIO_DEBUG_COMPRESS_ADPCM
+        if (header.channels <= AUDIO_DEBUG_MAX_CHANNELS) {
+            // The samples follow the packed header, copy them out to access them aligned
+            pcm_.resize(header.samples * header.channels);
+            memcpy(pcm_.data(), item + sizeof(header), pcm_.size() * sizeof(int16_t));
+            header.format = kAudioDebugFormatImaAdpcm;
+            payload_size = AdpcmSize(header.samples, header.channels);
+            memcpy(packet_.data(), &header, sizeof(header));
+            EncodeAdpcm(pcm_.data(), header.samples, header.channels, step_index_[header.tap],
+                packet_.data() + sizeof(header));
+            vRingbufferReturnItem(ring_, item);
+            item = nullptr;
+        }
+#endif
+        if (item != nullptr) {
+            memcpy(packet_.data(), item, size);
+            vRingbufferReturnItem(ring_, item);
+        }
+
+        ssize_t sent = sendto(udp_sockfd_, packet_.data(), sizeof(header) + payload_size, 0,
                              (struct sockaddr*)&udp_server_addr_, sizeof(udp_server_addr_));
         if (sent < 0) {
             ESP_LOGW(TAG, "Failed to send audio data to %s: %d", CONFIG_AUDIO_DEBUG_UDP_SERVER, errno);
-        } else {
-            ESP_LOGD(TAG, "Sent %d bytes audio data to %s", sent, CONFIG_AUDIO_DEBUG_UDP_SERVER);
+        }
+
+        int64_t now = esp_timer_get_time();
+        if (dropped_ > 0 && now - last_drop_log_time >= AUDIO_DEBUG_DROP_LOG_INTERVAL_MS * 1000) {
+            ESP_LOGW(TAG, "Dropped %lu packets, the sender cannot keep up", (unsigned long)dropped_.exchange(0));
+            last_drop_log_time = now;
         }
     }
 #endif
 }
-
- 
\ No newline at end of file
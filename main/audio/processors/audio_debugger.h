@@ -3,20 +3,88 @@
 
 #include <vector>
 #include <cstdint>
+#include <cstddef>
+#include <atomic>
 
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/ringbuf.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
 
+// Points of the audio pipeline that can be captured
+enum AudioDebugTap {
+    kAudioDebugTapMic,          // Raw input, interleaved with the reference channel if any
+    kAudioDebugTapAfe,          // Processor output sent to the encoder
+    kAudioDebugTapDownlink,     // Decoded speech before mixing
+    kAudioDebugTapCount,
+};
+
+enum AudioDebugFormat {
+    kAudioDebugFormatPcm16,
+    kAudioDebugFormatImaAdpcm,  // 4:1, see AudioDebugger::EncodeAdpcm
+};
+
+#define AUDIO_DEBUG_MAGIC 0x4441    // "AD"
+#define AUDIO_DEBUG_VERSION 1
+// PCM bytes per packet, so a packet fits in one UDP datagram without IP fragmentation
+#define AUDIO_DEBUG_MAX_PAYLOAD 1280
+// Packets with more channels are sent as PCM
+#define AUDIO_DEBUG_MAX_CHANNELS 2
+
+// Little-endian header in front of every UDP packet
+struct __attribute__((packed)) AudioDebugHeader {
+    uint16_t magic;
+    uint8_t version;
+    uint8_t tap;
+    uint8_t format;
+    uint8_t channels;
+    uint16_t samples;       // Per channel
+    uint32_t sequence;      // Per tap, counts the packets dropped on the device too
+    uint32_t sample_rate;
+    int64_t timestamp_us;   // Capture time of the first sample
+};
+
+/*
+ * Streams the selected taps to CONFIG_AUDIO_DEBUG_UDP_SERVER (see scripts/audio_debug_server.py).
+ * Feed only copies the samples into a ring buffer and never waits, a low priority task compresses and
+ * sends the packets. When the ring is full the packet is dropped, the receiver sees the sequence gap.
+ */
 class AudioDebugger {
 public:
     AudioDebugger();
     ~AudioDebugger();
 
-    void Feed(const std::vector<int16_t>& data);
+    bool IsTapEnabled(AudioDebugTap tap) const { return (tap_mask_ >> tap) & 1; }
+    void Feed(AudioDebugTap tap, const int16_t* data, size_t samples, int sample_rate, int channels);
+    void Feed(AudioDebugTap tap, const std::vector<int16_t>& data, int sample_rate, int channels) {
+        Feed(tap, data.data(), data.size(), sample_rate, channels);
+    }
+
+    // IMA ADPCM of `frames` interleaved frames: per channel a block header (int16 first sample, uint8 step index,
+    // uint8 reserved), then the nibbles of each channel in turn, low nibble first.
+    // `step_index` holds one entry per channel and is carried over to the next block.
+    static size_t AdpcmSize(size_t frames, int channels);
+    static void EncodeAdpcm(const int16_t* pcm, size_t frames, int channels, uint8_t* step_index, uint8_t* output);
 
 private:
     int udp_sockfd_ = -1;
     struct sockaddr_in udp_server_addr_;
+    std::atomic<uint32_t> tap_mask_ = 0;
+    RingbufHandle_t ring_ = nullptr;
+    std::atomic<bool> running_ = false;
+    std::atomic<bool> sender_running_ = false;
+    // Each tap is fed by one task
+    uint32_t sequence_[kAudioDebugTapCount] = {};
+    std::atomic<uint32_t> dropped_ = 0;
+
+    // Only accessed by the sender task
+    std::vector<uint8_t> packet_;
+    std::vector<int16_t> pcm_;
+    uint8_t step_index_[kAudioDebugTapCount][AUDIO_DEBUG_MAX_CHANNELS] = {};
+
+    bool OpenSocket();
+    void SenderTask();
 };
 
-#endif 
\ No newline at end of file
+#endif
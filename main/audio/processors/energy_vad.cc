@@ -0,0 +1,76 @@
+#include "energy_vad.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+#define BLOCK_SAMPLES 160
+#define MIN_NOISE_FLOOR 25
+// Mean square energy, about -50dBFS
+#define MIN_SPEECH_ENERGY 10000
+// Speech band energy is at least 9dB above the noise floor
+#define SPEECH_TO_NOISE_RATIO 8
+// Sign changes of the speech band per block, hiss and white noise cross zero in most samples
+#define MAX_ONSET_ZERO_CROSSINGS (BLOCK_SAMPLES / 2)
+#define SPEECH_ONSET_BLOCKS 3
+#define SPEECH_RELEASE_BLOCKS 10
+
+
+void EnergyVad::Reset() {
+    noise_floor_ = 0;
+    last_sample_ = 0;
+    speech_blocks_ = 0;
+    silence_blocks_ = 0;
+    speaking_ = false;
+}
+
+bool EnergyVad::Process(const int16_t* data, size_t samples) {
+    for (size_t offset = 0; offset < samples; offset += BLOCK_SAMPLES) {
+        size_t count = std::min<size_t>(BLOCK_SAMPLES, samples - offset);
+        uint64_t sum = 0;
+        uint64_t band_sum = 0;
+        int zero_crossings = 0;
+        int32_t last = last_sample_;
+        int32_t last_band = 0;
+        for (size_t i = 0; i < count; i++) {
+            int32_t sample = data[offset + i];
+            int32_t band = sample - last;
+            last = sample;
+            sum += sample * sample;
+            // The difference of two samples squared does not fit in int32_t
+            uint32_t magnitude = std::abs(band);
+            band_sum += magnitude * magnitude;
+            zero_crossings += (band ^ last_band) < 0;
+            last_band = band;
+        }
+        last_sample_ = last;
+        uint32_t energy = sum / count;
+        uint32_t band_energy = band_sum / count;
+
+        if (noise_floor_ == 0) {
+            noise_floor_ = std::max<uint32_t>(band_energy, MIN_NOISE_FLOOR);
+        }
+        bool speech = energy > MIN_SPEECH_ENERGY && band_energy / SPEECH_TO_NOISE_RATIO > noise_floor_;
+        if (speech && (speaking_ || zero_crossings <= MAX_ONSET_ZERO_CROSSINGS)) {
+            speech_blocks_++;
+            silence_blocks_ = 0;
+        } else {
+            silence_blocks_++;
+            speech_blocks_ = 0;
+        }
+        // Fall quickly and rise slowly, so the floor follows the quiet parts. It also rises during speech,
+        // very slowly, so a steady loud noise does not hold the detector on
+        if (band_energy < noise_floor_) {
+            noise_floor_ -= (noise_floor_ - band_energy) / 8;
+        } else {
+            noise_floor_ += (band_energy - noise_floor_) / (speech ? 4096 : 256);
+        }
+        noise_floor_ = std::max<uint32_t>(noise_floor_, MIN_NOISE_FLOOR);
+
+        if (!speaking_ && speech_blocks_ >= SPEECH_ONSET_BLOCKS) {
+            speaking_ = true;
+        } else if (speaking_ && silence_blocks_ >= SPEECH_RELEASE_BLOCKS) {
+            speaking_ = false;
+        }
+    }
+    return speaking_;
+}
@@ -0,0 +1,30 @@
+#ifndef ENERGY_VAD_H
+#define ENERGY_VAD_H
+
+#include <cstdint>
+#include <cstddef>
+
+
+/*
+ * Fixed-point voice activity detector for 16kHz mono audio, used where no VAD model runs.
+ * The audio is measured in 10ms blocks. A block is speech when it is loud enough and its speech band
+ * energy (a first difference, which removes hum and rumble) is well above a noise floor that follows
+ * the quiet blocks. Speech starts after 30ms of such blocks whose zero crossing rate is not noise-like,
+ * and ends after 100ms without them.
+ */
+class EnergyVad {
+public:
+    void Reset();
+    // Returns true while speech is detected
+    bool Process(const int16_t* data, size_t samples);
+    bool speaking() const { return speaking_; }
+
+private:
+    uint32_t noise_floor_ = 0;  // Of the speech band energy
+    int16_t last_sample_ = 0;
+    int speech_blocks_ = 0;
+    int silence_blocks_ = 0;
+    bool speaking_ = false;
+};
+
+#endif // ENERGY_VAD_H
@@ -8,29 +8,43 @@ void NoAudioProcessor::Initialize(AudioCodec* codec, int frame_duration_ms, srmo
     frame_samples_ = frame_duration_ms * 16000 / 1000;
 }
 
-void NoAudioProcessor::Feed(std::vector<int16_t>&& data) {
+void NoAudioProcessor::Feed(const AudioFrame& frame) {
     if (!is_running_ || !output_callback_) {
         return;
     }
 
-    if (codec_->input_channels() == 2) {
-        // If input channels is 2, we need to fetch the left channel data
-        auto mono_data = std::vector<int16_t>(data.size() / 2);
-        for (size_t i = 0, j = 0; i < mono_data.size(); ++i, j += 2) {
-            mono_data[i] = data[j];
+    // The output is queued for encoding, so it gets its own copy of the microphone channel
+    std::vector<int16_t> mono_data(frame.frames);
+    for (size_t i = 0, j = 0; i < frame.frames; ++i, j += frame.channels) {
+        mono_data[i] = frame.data[j];
+    }
+    UpdateVadState(mono_data);
+    output_callback_(std::move(mono_data));
+}
+
+void NoAudioProcessor::UpdateVadState(const std::vector<int16_t>& data) {
+    bool speaking = vad_.Process(data.data(), data.size());
+    if (speaking != is_speaking_) {
+        is_speaking_ = speaking;
+        if (vad_state_change_callback_) {
+            vad_state_change_callback_(speaking);
         }
-        output_callback_(std::move(mono_data));
-    } else {
-        output_callback_(std::move(data));
     }
 }
 
 void NoAudioProcessor::Start() {
+    vad_.Reset();
     is_running_ = true;
 }
 
 void NoAudioProcessor::Stop() {
     is_running_ = false;
+    if (is_speaking_) {
+        is_speaking_ = false;
+        if (vad_state_change_callback_) {
+            vad_state_change_callback_(false);
+        }
+    }
 }
 
 bool NoAudioProcessor::IsRunning() {
@@ -6,6 +6,7 @@
 
 #include "audio_processor.h"
 #include "audio_codec.h"
+#include "energy_vad.h"
 
 class NoAudioProcessor : public AudioProcessor {
 public:
@@ -13,7 +14,7 @@ public:
     ~NoAudioProcessor() = default;
 
     void Initialize(AudioCodec* codec, int frame_duration_ms, srmodel_list_t* models_list) override;
-    void Feed(std::vector<int16_t>&& data) override;
+    void Feed(const AudioFrame& frame) override;
     void Start() override;
     void Stop() override;
     bool IsRunning() override;
@@ -28,6 +29,10 @@ private:
     std::function<void(std::vector<int16_t>&& data)> output_callback_;
     std::function<void(bool speaking)> vad_state_change_callback_;
     bool is_running_ = false;
+    bool is_speaking_ = false;
+    EnergyVad vad_;
+
+    void UpdateVadState(const std::vector<int16_t>& data);
 };
 
 #endif 
\ No newline at end of file
@@ -0,0 +1,153 @@
+#include "server_aec_aligner.h"
+
+#include <algorithm>
+
+#define MAX_OUTPUT_SEGMENTS 64
+#define MAX_INPUT_MARKS 64
+#define OUTPUT_HISTORY_SECONDS 2
+#define MAX_PLAYOUT_RUNS 8
+
+
+void ServerAecAligner::Configure(int output_sample_rate, int input_sample_rate, size_t underrun_silence_frames) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    output_sample_rate_ = output_sample_rate;
+    input_sample_rate_ = input_sample_rate;
+    underrun_silence_frames_ = underrun_silence_frames;
+}
+
+void ServerAecAligner::Reset() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    // The frame counters keep following the DMA, only the mapping is dropped
+    segments_.clear();
+}
+
+void ServerAecAligner::ResetInput() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    input_samples_ = 0;
+    uplink_samples_ = 0;
+    input_marks_.clear();
+}
+
+void ServerAecAligner::UpdateOutputPosition(uint64_t sent_frames, int64_t time_us) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!position_valid_) {
+        position_valid_ = true;
+        sent_frames_ = sent_frames;
+        return;
+    }
+    if (sent_frames <= sent_frames_) {
+        return;
+    }
+
+    uint64_t delta = sent_frames - sent_frames_;
+    sent_frames_ = sent_frames;
+    if (run_pending_) {
+        uint64_t silence = std::min<uint64_t>(delta, silence_frames_);
+        silence_frames_ -= silence;
+        delta -= silence;
+        if (silence_frames_ > 0) {
+            return;
+        }
+        // The written data started right after the silence
+        int64_t start_time = time_us - int64_t(delta) * 1000000 / output_sample_rate_;
+        runs_.push_back(PlayoutRun{start_time, played_frames_, start_time, UINT64_MAX});
+        if (runs_.size() > MAX_PLAYOUT_RUNS) {
+            runs_.pop_front();
+        }
+        run_pending_ = false;
+    }
+    if (runs_.empty()) {
+        return;
+    }
+
+    auto& run = runs_.back();
+    uint64_t available = written_frames_ - played_frames_;
+    if (delta >= available) {
+        // Underrun, the DMA sends silence after the last written frame
+        played_frames_ = written_frames_;
+        run.anchor_frame = played_frames_;
+        run.anchor_time_us = time_us - int64_t(delta - available) * 1000000 / output_sample_rate_;
+        run.end_frame = played_frames_;
+    } else {
+        played_frames_ += delta;
+        run.anchor_frame = played_frames_;
+        run.anchor_time_us = time_us;
+    }
+}
+
+void ServerAecAligner::RecordOutput(size_t frames, uint32_t timestamp) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (written_frames_ == played_frames_ && position_valid_ && !run_pending_) {
+        // Nothing is queued, the new data plays after the silence the DMA has queued already
+        silence_frames_ = underrun_silence_frames_;
+        run_pending_ = true;
+    }
+    if (timestamp != 0) {
+        segments_.push_back(OutputSegment{written_frames_, written_frames_ + frames, timestamp});
+    }
+    written_frames_ += frames;
+
+    uint64_t history = uint64_t(output_sample_rate_) * OUTPUT_HISTORY_SECONDS;
+    while (!segments_.empty() && (segments_.size() > MAX_OUTPUT_SEGMENTS || segments_.front().end + history < played_frames_)) {
+        segments_.pop_front();
+    }
+}
+
+void ServerAecAligner::RecordInput(size_t samples, int64_t capture_time_us) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    input_samples_ += samples;
+    input_marks_.push_back(InputMark{input_samples_, capture_time_us});
+    if (input_marks_.size() > MAX_INPUT_MARKS) {
+        input_marks_.pop_front();
+    }
+}
+
+int64_t ServerAecAligner::GetCaptureTime(uint64_t sample) const {
+    // Use the first read that contains the sample, or the closest one
+    const InputMark* mark = &input_marks_.back();
+    for (auto& m : input_marks_) {
+        if (m.end > sample) {
+            mark = &m;
+            break;
+        }
+    }
+    // The mark time belongs to the last sample of the read, index end - 1
+    int64_t samples_before = int64_t(mark->end) - 1 - int64_t(sample);
+    return mark->time_us - samples_before * 1000000 / input_sample_rate_;
+}
+
+bool ServerAecAligner::GetPlayoutFrame(int64_t time_us, uint64_t& frame) const {
+    for (auto it = runs_.rbegin(); it != runs_.rend(); ++it) {
+        if (it->start_time_us > time_us) {
+            continue;
+        }
+        int64_t position = int64_t(it->anchor_frame) + (time_us - it->anchor_time_us) * output_sample_rate_ / 1000000;
+        if (position < 0 || uint64_t(position) >= it->end_frame) {
+            // Silence after the run
+            return false;
+        }
+        frame = position;
+        return true;
+    }
+    return false;
+}
+
+uint32_t ServerAecAligner::MapUplinkFrame(size_t samples) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    uint64_t first_sample = uplink_samples_;
+    uplink_samples_ += samples;
+    if (input_marks_.empty() || segments_.empty()) {
+        return 0;
+    }
+
+    uint64_t frame;
+    if (!GetPlayoutFrame(GetCaptureTime(first_sample), frame)) {
+        return 0;
+    }
+    for (auto& segment : segments_) {
+        if (frame >= segment.start && frame < segment.end) {
+            return segment.timestamp + uint32_t((frame - segment.start) * 1000 / output_sample_rate_);
+        }
+    }
+    return 0;
+}
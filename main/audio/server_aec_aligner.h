@@ -0,0 +1,80 @@
+#ifndef SERVER_AEC_ALIGNER_H
+#define SERVER_AEC_ALIGNER_H
+
+#include <cstdint>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+
+
+/*
+ * Maps uplink audio to the downlink audio that was playing while it was captured, for server side AEC.
+ *
+ * Output frames are counted as they are written to the codec, each downlink packet covering a range of frames.
+ * The I2S DMA position (frames sent and the time of the last sent buffer) tells when each of those frames
+ * reaches the speaker, including the frames still queued in the DMA buffers. Input samples are stamped with
+ * their capture time, so the first sample of each uplink frame gives a playout frame, and the timestamp
+ * of the packet containing it plus the offset into that packet.
+ */
+class ServerAecAligner {
+public:
+    // `underrun_silence_frames` is the silence played before data written after an underrun, see AudioCodec
+    void Configure(int output_sample_rate, int input_sample_rate, size_t underrun_silence_frames);
+    // Drop the output mapping when playback is reset
+    void Reset();
+    // Restart the input count when the audio processor restarts. While it keeps running, samples still
+    // buffered in it belong to the count they were read with
+    void ResetInput();
+
+    // Called before writing output, with the DMA position read from the codec
+    void UpdateOutputPosition(uint64_t sent_frames, int64_t time_us);
+    // Called after `frames` of a downlink packet have been written
+    void RecordOutput(size_t frames, uint32_t timestamp);
+    // Called after `samples` have been read for the audio processor, `capture_time_us` is the time of the last one
+    void RecordInput(size_t samples, int64_t capture_time_us);
+    // Timestamp for the next `samples` of processed uplink audio, 0 if nothing with a timestamp was playing
+    uint32_t MapUplinkFrame(size_t samples);
+
+private:
+    struct OutputSegment {
+        uint64_t start;
+        uint64_t end;
+        uint32_t timestamp;
+    };
+    // Continuous playback between underruns, `anchor_frame` is played at `anchor_time_us`
+    struct PlayoutRun {
+        int64_t start_time_us;
+        uint64_t anchor_frame;
+        int64_t anchor_time_us;
+        uint64_t end_frame;
+    };
+    struct InputMark {
+        uint64_t end;
+        int64_t time_us;
+    };
+
+    std::mutex mutex_;
+    int output_sample_rate_ = 16000;
+    int input_sample_rate_ = 16000;
+    size_t underrun_silence_frames_ = 0;
+
+    // Output frames written, and frames of written data already sent by the DMA
+    uint64_t written_frames_ = 0;
+    uint64_t played_frames_ = 0;
+    uint64_t sent_frames_ = 0;
+    bool position_valid_ = false;
+    // Silence the DMA sends before written data after an underrun, the new run starts once it is sent
+    size_t silence_frames_ = 0;
+    bool run_pending_ = false;
+    std::deque<PlayoutRun> runs_;
+    std::deque<OutputSegment> segments_;
+
+    uint64_t input_samples_ = 0;
+    uint64_t uplink_samples_ = 0;
+    std::deque<InputMark> input_marks_;
+
+    int64_t GetCaptureTime(uint64_t sample) const;
+    bool GetPlayoutFrame(int64_t time_us, uint64_t& frame) const;
+};
+
+#endif // SERVER_AEC_ALIGNER_H
@@ -0,0 +1,159 @@
+#include "sound_cache.h"
+#include "memory_accounting.h"
+
+#include <esp_log.h>
+#include <esp_heap_caps.h>
+#include <algorithm>
+#include <cstring>
+
+#define TAG "SoundCache"
+
+
+static const int16_t kAdpcmStepTable[89] = {
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+    50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209, 230, 253, 279, 307,
+    337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066,
+    2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899,
+    15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767
+};
+
+static const int8_t kAdpcmIndexTable[16] = {
+    -1, -1, -1, -1, 2, 4, 6, 8, -1, -1, -1, -1, 2, 4, 6, 8
+};
+
+struct AdpcmState {
+    int predictor = 0;
+    int index = 0;
+};
+
+static int16_t AdpcmDecodeNibble(AdpcmState& state, uint8_t nibble) {
+    int step = kAdpcmStepTable[state.index];
+    int diff = step >> 3;
+    if (nibble & 4) diff += step;
+    if (nibble & 2) diff += step >> 1;
+    if (nibble & 1) diff += step >> 2;
+    state.predictor += (nibble & 8) ? -diff : diff;
+    state.predictor = std::clamp(state.predictor, -32768, 32767);
+    state.index = std::clamp(state.index + kAdpcmIndexTable[nibble], 0, 88);
+    return static_cast<int16_t>(state.predictor);
+}
+
+static uint8_t AdpcmEncodeSample(AdpcmState& state, int16_t sample) {
+    int step = kAdpcmStepTable[state.index];
+    int diff = sample - state.predictor;
+    uint8_t nibble = 0;
+    if (diff < 0) {
+        nibble = 8;
+        diff = -diff;
+    }
+    if (diff >= step) { nibble |= 4; diff -= step; }
+    if (diff >= step >> 1) { nibble |= 2; diff -= step >> 1; }
+    if (diff >= step >> 2) { nibble |= 1; }
+    // Keep the encoder in sync with the decoder
+    AdpcmDecodeNibble(state, nibble);
+    return nibble;
+}
+
+
+SoundCache::SoundCache(size_t budget_bytes, bool adpcm) : budget_bytes_(budget_bytes), adpcm_(adpcm) {
+}
+
+SoundCache::~SoundCache() {
+    Clear();
+}
+
+SoundCache::Entry* SoundCache::Find(const std::string_view& ogg) {
+    for (auto& entry : entries_) {
+        if (entry.ogg_data == ogg.data() && entry.ogg_size == ogg.size()) {
+            return &entry;
+        }
+    }
+    return nullptr;
+}
+
+bool SoundCache::Contains(const std::string_view& ogg) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return Find(ogg) != nullptr;
+}
+
+bool SoundCache::Add(const std::string_view& ogg, const std::vector<int16_t>& pcm) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (Find(ogg) != nullptr || pcm.empty()) {
+        return false;
+    }
+
+    size_t bytes = adpcm_ ? (pcm.size() + 1) / 2 : pcm.size() * sizeof(int16_t);
+    if (used_bytes_ + bytes > budget_bytes_) {
+        ESP_LOGW(TAG, "Not enough space for sound (%u bytes), used %u of %u", bytes, used_bytes_, budget_bytes_);
+        return false;
+    }
+
+    auto data = static_cast<uint8_t*>(MemoryAccounting::Malloc(kMemoryTagAudio, bytes, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT));
+    if (data == nullptr) {
+        data = static_cast<uint8_t*>(MemoryAccounting::Malloc(kMemoryTagAudio, bytes, MALLOC_CAP_8BIT));
+    }
+    if (data == nullptr) {
+        ESP_LOGE(TAG, "Failed to allocate %u bytes", bytes);
+        return false;
+    }
+
+    if (adpcm_) {
+        AdpcmState state;
+        memset(data, 0, bytes);
+        for (size_t i = 0; i < pcm.size(); i++) {
+            uint8_t nibble = AdpcmEncodeSample(state, pcm[i]);
+            data[i / 2] |= (i & 1) ? (nibble << 4) : nibble;
+        }
+    } else {
+        memcpy(data, pcm.data(), bytes);
+    }
+
+    entries_.push_back(Entry{ogg.data(), ogg.size(), data, bytes, pcm.size()});
+    used_bytes_ += bytes;
+    ESP_LOGI(TAG, "Cached sound: %u samples, %u bytes, used %u of %u", pcm.size(), bytes, used_bytes_, budget_bytes_);
+    return true;
+}
+
+bool SoundCache::Open(const std::string_view& ogg, Cursor& cursor) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (Find(ogg) == nullptr) {
+        return false;
+    }
+    cursor = Cursor{ogg.data(), ogg.size()};
+    return true;
+}
+
+bool SoundCache::Read(Cursor& cursor, size_t samples, std::vector<int16_t>& pcm) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto entry = Find(std::string_view(cursor.ogg_data, cursor.ogg_size));
+    if (entry == nullptr || cursor.offset >= entry->samples) {
+        return false;
+    }
+
+    samples = std::min(samples, entry->samples - cursor.offset);
+    size_t start = pcm.size();
+    pcm.resize(start + samples);
+    if (adpcm_) {
+        AdpcmState state{cursor.predictor, cursor.index};
+        for (size_t i = 0; i < samples; i++) {
+            size_t index = cursor.offset + i;
+            uint8_t byte = entry->data[index / 2];
+            pcm[start + i] = AdpcmDecodeNibble(state, (index & 1) ? (byte >> 4) : (byte & 0x0F));
+        }
+        cursor.predictor = state.predictor;
+        cursor.index = state.index;
+    } else {
+        memcpy(pcm.data() + start, entry->data + cursor.offset * sizeof(int16_t), samples * sizeof(int16_t));
+    }
+    cursor.offset += samples;
+    return true;
+}
+
+void SoundCache::Clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& entry : entries_) {
+        MemoryAccounting::Free(kMemoryTagAudio, entry.data);
+    }
+    entries_.clear();
+    used_bytes_ = 0;
+}
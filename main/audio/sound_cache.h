@@ -0,0 +1,63 @@
+#ifndef SOUND_CACHE_H
+#define SOUND_CACHE_H
+
+#include <cstdint>
+#include <cstddef>
+#include <string_view>
+#include <vector>
+#include <mutex>
+
+
+/*
+ * Keeps prompt sounds decoded to PCM at the codec output sample rate, so they can be
+ * played without going through the Opus decoder. They are read a frame at a time through a
+ * cursor, like decoded sounds.
+ * Sounds are identified by the address of their Ogg data, which is embedded in the
+ * firmware or mapped from the assets partition and stays valid.
+ * PCM is stored in PSRAM when available, optionally compressed with IMA ADPCM (4 bits per sample).
+ */
+class SoundCache {
+public:
+    SoundCache(size_t budget_bytes, bool adpcm);
+    ~SoundCache();
+    SoundCache(const SoundCache&) = delete;
+    SoundCache& operator=(const SoundCache&) = delete;
+
+    bool Contains(const std::string_view& ogg);
+    bool Add(const std::string_view& ogg, const std::vector<int16_t>& pcm);
+    // Position in a cached sound, with the ADPCM decoder state at that position
+    struct Cursor {
+        const char* ogg_data = nullptr;
+        size_t ogg_size = 0;
+        size_t offset = 0;
+        int predictor = 0;
+        int index = 0;
+    };
+    // Start reading a sound from its beginning, returns false if it is not cached
+    bool Open(const std::string_view& ogg, Cursor& cursor);
+    // Append up to `samples` samples at the cursor to `pcm`, returns false at the end of the sound
+    // or if the sound was removed from the cache
+    bool Read(Cursor& cursor, size_t samples, std::vector<int16_t>& pcm);
+    void Clear();
+
+    inline size_t used_bytes() const { return used_bytes_; }
+
+private:
+    struct Entry {
+        const char* ogg_data;
+        size_t ogg_size;
+        uint8_t* data;
+        size_t bytes;
+        size_t samples;
+    };
+
+    std::mutex mutex_;
+    std::vector<Entry> entries_;
+    size_t budget_bytes_;
+    size_t used_bytes_ = 0;
+    bool adpcm_;
+
+    Entry* Find(const std::string_view& ogg);
+};
+
+#endif // SOUND_CACHE_H
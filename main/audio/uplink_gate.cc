@@ -0,0 +1,110 @@
+#include "uplink_gate.h"
+
+#include <esp_log.h>
+
+#define TAG "UplinkGate"
+
+
+void UplinkGate::Configure(int sample_rate, int hangover_ms, int preroll_ms, int comfort_noise_interval_ms) {
+    hangover_samples_ = size_t(sample_rate) * hangover_ms / 1000;
+    preroll_samples_ = size_t(sample_rate) * preroll_ms / 1000;
+    comfort_noise_samples_ = size_t(sample_rate) * comfort_noise_interval_ms / 1000;
+}
+
+void UplinkGate::SetEnabled(bool enabled) {
+    if (enabled_.exchange(enabled) != enabled) {
+        reset_ = true;
+    }
+}
+
+void UplinkGate::Reset() {
+    reset_ = true;
+}
+
+void UplinkGate::Process(Frame&& frame, bool speaking, std::vector<Frame>& output) {
+    if (reset_.exchange(false)) {
+        if (total_frames_ > 0) {
+            ESP_LOGI(TAG, "Sent %d of %d frames", sent_frames_, total_frames_);
+        }
+        open_ = false;
+        samples_since_speech_ = 0;
+        samples_since_sent_ = 0;
+        preroll_.clear();
+        preroll_size_ = 0;
+        total_frames_ = 0;
+        sent_frames_ = 0;
+    }
+
+    size_t samples = frame.pcm.size();
+    total_frames_++;
+    if (!enabled_) {
+        sent_frames_++;
+        output.push_back(std::move(frame));
+        return;
+    }
+
+    if (speaking) {
+        samples_since_speech_ = 0;
+        if (!open_) {
+            open_ = true;
+            // Send the audio just before the onset first
+            sent_frames_ += preroll_.size();
+            for (auto& f : preroll_) {
+                output.push_back(std::move(f));
+            }
+            preroll_.clear();
+            preroll_size_ = 0;
+        }
+    } else if (open_) {
+        samples_since_speech_ += samples;
+        if (samples_since_speech_ > hangover_samples_) {
+            open_ = false;
+            samples_since_sent_ = 0;
+        }
+    }
+
+    if (open_) {
+        sent_frames_++;
+        output.push_back(std::move(frame));
+        return;
+    }
+
+    samples_since_sent_ += samples;
+    if (comfort_noise_samples_ > 0 && samples_since_sent_ >= comfort_noise_samples_) {
+        samples_since_sent_ = 0;
+        sent_frames_++;
+        output.push_back(std::move(frame));
+        // The pre-roll must not be sent after a newer frame
+        preroll_.clear();
+        preroll_size_ = 0;
+        return;
+    }
+
+    preroll_size_ += samples;
+    preroll_.push_back(std::move(frame));
+    while (!preroll_.empty() && preroll_size_ - preroll_.front().pcm.size() >= preroll_samples_) {
+        preroll_size_ -= preroll_.front().pcm.size();
+        Recycle(std::move(preroll_.front().pcm));
+        preroll_.pop_front();
+    }
+}
+
+void UplinkGate::KeepSpareBuffers(size_t count) {
+    max_spares_ = count;
+    spares_.reserve(count);
+}
+
+void UplinkGate::Recycle(std::vector<int16_t>&& pcm) {
+    if (spares_.size() < max_spares_) {
+        spares_.push_back(std::move(pcm));
+    }
+}
+
+std::vector<int16_t> UplinkGate::TakeSpare() {
+    if (spares_.empty()) {
+        return {};
+    }
+    auto pcm = std::move(spares_.back());
+    spares_.pop_back();
+    return pcm;
+}
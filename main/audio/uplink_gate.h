@@ -0,0 +1,61 @@
+#ifndef UPLINK_GATE_H
+#define UPLINK_GATE_H
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <deque>
+#include <atomic>
+
+
+/*
+ * Decides which captured frames are encoded and sent while listening. The gate opens on speech,
+ * stays open for a hangover after it and sends the pre-roll kept while closed first, so the
+ * speech onset is not clipped. While closed a frame of the background noise is sent now and then,
+ * so the server keeps receiving comfort noise. Frames keep the timestamps of their capture.
+ */
+class UplinkGate {
+public:
+    struct Frame {
+        std::vector<int16_t> pcm;
+        uint32_t timestamp = 0;
+        // Capture order, a gap between the sent frames means the audio is not continuous
+        uint32_t sequence = 0;
+    };
+
+    void Configure(int sample_rate, int hangover_ms, int preroll_ms, int comfort_noise_interval_ms);
+    // A disabled gate passes every frame, may be called from another task
+    void SetEnabled(bool enabled);
+    bool enabled() const { return enabled_; }
+    // Drop the pre-roll and close the gate before the next frame, may be called from another task
+    void Reset();
+
+    // Frames to send now are appended to `output`, in capture order
+    void Process(Frame&& frame, bool speaking, std::vector<Frame>& output);
+
+    // Keep up to `count` buffers of frames dropped from the pre-roll or given back with Recycle, so a
+    // caller copying its audio into frames does not allocate one per frame. None are kept by default
+    void KeepSpareBuffers(size_t count);
+    void Recycle(std::vector<int16_t>&& pcm);
+    // A kept buffer, or an empty one if there is none
+    std::vector<int16_t> TakeSpare();
+
+private:
+    std::atomic<bool> enabled_ = false;
+    std::atomic<bool> reset_ = true;
+    size_t hangover_samples_ = 0;
+    size_t preroll_samples_ = 0;
+    size_t comfort_noise_samples_ = 0;
+
+    bool open_ = false;
+    size_t samples_since_speech_ = 0;
+    size_t samples_since_sent_ = 0;
+    size_t preroll_size_ = 0;
+    std::deque<Frame> preroll_;
+    int total_frames_ = 0;
+    int sent_frames_ = 0;
+    size_t max_spares_ = 0;
+    std::vector<std::vector<int16_t>> spares_;
+};
+
+#endif // UPLINK_GATE_H
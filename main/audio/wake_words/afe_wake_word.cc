@@ -1,4 +1,5 @@
 #include "afe_wake_word.h"
+#include "memory_accounting.h"
 #include "audio_service.h"
 
 #include <esp_log.h>
@@ -22,14 +23,14 @@ AfeWakeWord::~AfeWakeWord() {
     }
 
     if (wake_word_encode_task_stack_ != nullptr) {
-        heap_caps_free(wake_word_encode_task_stack_);
+        MemoryAccounting::Free(kMemoryTagAudio, wake_word_encode_task_stack_);
     }
 
     if (wake_word_encode_task_buffer_ != nullptr) {
-        heap_caps_free(wake_word_encode_task_buffer_);
+        MemoryAccounting::Free(kMemoryTagAudio, wake_word_encode_task_buffer_);
     }
 
-    if (models_ != nullptr) {
+    if (models_ != nullptr && owns_models_) {
         esp_srmodel_deinit(models_);
     }
 
@@ -42,6 +43,7 @@ bool AfeWakeWord::Initialize(AudioCodec* codec, srmodel_list_t* models_list) {
 
     if (models_list == nullptr) {
         models_ = esp_srmodel_init("model");
+        owns_models_ = true;
     } else {
         models_ = models_list;
     }
@@ -105,11 +107,11 @@ void AfeWakeWord::Stop() {
     }
 }
 
-void AfeWakeWord::Feed(const std::vector<int16_t>& data) {
+void AfeWakeWord::Feed(const AudioFrame& frame) {
     if (afe_data_ == nullptr) {
         return;
     }
-    afe_iface_->feed(afe_data_, data.data());
+    afe_iface_->feed(afe_data_, frame.data);
 }
 
 size_t AfeWakeWord::GetFeedSize() {
@@ -148,23 +150,26 @@ void AfeWakeWord::AudioDetectionTask() {
 }
 
 void AfeWakeWord::StoreWakeWordData(const int16_t* data, size_t samples) {
-    // store audio data to wake_word_pcm_
-    wake_word_pcm_.emplace_back(std::vector<int16_t>(data, data + samples));
     // keep about 2 seconds of data, detect duration is 30ms (sample_rate == 16000, chunksize == 512)
-    while (wake_word_pcm_.size() > 2000 / 30) {
+    // Once full, the oldest buffer is reused for the new data instead of allocating one per chunk
+    std::vector<int16_t> pcm;
+    while (wake_word_pcm_.size() >= 2000 / 30) {
+        pcm = std::move(wake_word_pcm_.front());
         wake_word_pcm_.pop_front();
     }
+    pcm.assign(data, data + samples);
+    wake_word_pcm_.push_back(std::move(pcm));
 }
 
 void AfeWakeWord::EncodeWakeWordData() {
     const size_t stack_size = 4096 * 7;
     wake_word_opus_.clear();
     if (wake_word_encode_task_stack_ == nullptr) {
-        wake_word_encode_task_stack_ = (StackType_t*)heap_caps_malloc(stack_size, MALLOC_CAP_SPIRAM);
+        wake_word_encode_task_stack_ = (StackType_t*)MemoryAccounting::Malloc(kMemoryTagAudio, stack_size, MALLOC_CAP_SPIRAM);
         assert(wake_word_encode_task_stack_ != nullptr);
     }
     if (wake_word_encode_task_buffer_ == nullptr) {
-        wake_word_encode_task_buffer_ = (StaticTask_t*)heap_caps_malloc(sizeof(StaticTask_t), MALLOC_CAP_INTERNAL);
+        wake_word_encode_task_buffer_ = (StaticTask_t*)MemoryAccounting::Malloc(kMemoryTagAudio, sizeof(StaticTask_t), MALLOC_CAP_INTERNAL);
         assert(wake_word_encode_task_buffer_ != nullptr);
     }
 
@@ -25,7 +25,7 @@ public:
     ~AfeWakeWord();
 
     bool Initialize(AudioCodec* codec, srmodel_list_t* models_list);
-    void Feed(const std::vector<int16_t>& data);
+    void Feed(const AudioFrame& frame);
     void OnWakeWordDetected(std::function<void(const std::string& wake_word)> callback);
     void Start();
     void Stop();
@@ -36,6 +36,8 @@ public:
 
 private:
     srmodel_list_t *models_ = nullptr;
+    // Only the models loaded by the engine itself are freed with it, the assets models are shared
+    bool owns_models_ = false;
     esp_afe_sr_iface_t* afe_iface_ = nullptr;
     esp_afe_sr_data_t* afe_data_ = nullptr;
     char* wakenet_model_ = NULL;
@@ -23,7 +23,7 @@ public:
     ~CustomWakeWord();
 
     bool Initialize(AudioCodec* codec, srmodel_list_t* models_list);
-    void Feed(const std::vector<int16_t>& data);
+    void Feed(const AudioFrame& frame);
     void OnWakeWordDetected(std::function<void(const std::string& wake_word)> callback);
     void Start();
     void Stop();
@@ -43,6 +43,8 @@ private:
     esp_mn_iface_t* multinet_ = nullptr;
     model_iface_data_t* multinet_model_data_ = nullptr;
     srmodel_list_t *models_ = nullptr;
+    // Only the models loaded by the engine itself are freed with it, the assets models are shared
+    bool owns_models_ = false;
     char* mn_name_ = nullptr;
     std::string language_ = "cn";
     int duration_ = 3000;
@@ -53,6 +55,8 @@ private:
     AudioCodec* codec_ = nullptr;
     std::string last_detected_wake_word_;
     std::atomic<bool> running_ = false;
+    // Microphone channel of stereo input, kept across frames
+    std::vector<int16_t> mono_pcm_;
 
     TaskHandle_t wake_word_encode_task_ = nullptr;
     StaticTask_t* wake_word_encode_task_buffer_ = nullptr;
@@ -62,7 +66,7 @@ private:
     std::mutex wake_word_mutex_;
     std::condition_variable wake_word_cv_;
 
-    void StoreWakeWordData(const std::vector<int16_t>& data);
+    void StoreWakeWordData(const int16_t* data, size_t samples);
     void ParseWakenetModelConfig();
 };
 
@@ -10,6 +10,8 @@ EspWakeWord::EspWakeWord() {
 EspWakeWord::~EspWakeWord() {
     if (wakenet_data_ != nullptr) {
         wakenet_iface_->destroy(wakenet_data_);
+    }
+    if (wakenet_model_ != nullptr && owns_models_) {
         esp_srmodel_deinit(wakenet_model_);
     }
 }
@@ -19,6 +21,7 @@ bool EspWakeWord::Initialize(AudioCodec* codec, srmodel_list_t* models_list) {
 
     if (models_list == nullptr) {
         wakenet_model_ = esp_srmodel_init("model");
+        owns_models_ = true;
     } else {
         wakenet_model_ = models_list;
     }
@@ -56,12 +59,12 @@ void EspWakeWord::Stop() {
     running_ = false;
 }
 
-void EspWakeWord::Feed(const std::vector<int16_t>& data) {
+void EspWakeWord::Feed(const AudioFrame& frame) {
     if (wakenet_data_ == nullptr || !running_) {
         return;
     }
 
-    int res = wakenet_iface_->detect(wakenet_data_, (int16_t *)data.data());
+    int res = wakenet_iface_->detect(wakenet_data_, const_cast<int16_t*>(frame.data));
     if (res > 0) {
         last_detected_wake_word_ = wakenet_iface_->get_word_name(wakenet_data_, res);
         running_ = false;
@@ -19,7 +19,7 @@ public:
     ~EspWakeWord();
 
     bool Initialize(AudioCodec* codec, srmodel_list_t* models_list);
-    void Feed(const std::vector<int16_t>& data);
+    void Feed(const AudioFrame& frame);
     void OnWakeWordDetected(std::function<void(const std::string& wake_word)> callback);
     void Start();
     void Stop();
@@ -32,6 +32,8 @@ private:
     esp_wn_iface_t *wakenet_iface_ = nullptr;
     model_iface_data_t *wakenet_data_ = nullptr;
     srmodel_list_t *wakenet_model_ = nullptr;
+    // Only the models loaded by the engine itself are freed with it, the assets models are shared
+    bool owns_models_ = false;
     AudioCodec* codec_ = nullptr;
     std::atomic<bool> running_ = false;
 
@@ -99,6 +99,8 @@ void PowerSaveTimer::PowerSaveCheck() {
         }
     }
     if (seconds_to_shutdown_ != -1 && ticks_ >= seconds_to_shutdown_ && on_shutdown_request_) {
+        // Boards power off or enter deep sleep on a shutdown request
+        Settings::Flush();
         on_shutdown_request_();
     }
 }
@@ -8,6 +8,7 @@
 #include "esp_adc/adc_cali.h"
 #include "esp_adc/adc_cali_scheme.h"
 #include <math.h>
+#include "settings.h"
 
 
 class PowerManager {
@@ -162,6 +163,7 @@ public:
 
     void PowerOff(void) {
         if (bat_power_pin_ != GPIO_NUM_NC) {
+            Settings::Flush();
             gpio_set_level(bat_power_pin_, 0);
         }
     }
@@ -0,0 +1,181 @@
+#include "boot_scheduler.h"
+
+#include <esp_log.h>
+#include <esp_timer.h>
+
+#define TAG "BootScheduler"
+
+
+BootScheduler::BootScheduler() {
+}
+
+BootScheduler::~BootScheduler() {
+    // Wait for the step tasks, they reference this object
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait(lock, [this]() {
+        for (auto& step : steps_) {
+            if (step.state == kStepStateRunning) {
+                return false;
+            }
+        }
+        return true;
+    });
+}
+
+void BootScheduler::AddStep(const std::string& name, const std::vector<std::string>& dependencies,
+    std::function<void()> callback, uint32_t stack_size, UBaseType_t priority) {
+    Step step;
+    step.name = name;
+    step.dependency_names = dependencies;
+    step.callback = std::move(callback);
+    step.stack_size = stack_size;
+    step.priority = priority;
+    step.scheduler = this;
+    steps_.push_back(std::move(step));
+}
+
+bool BootScheduler::ResolveDependencies() {
+    for (auto& step : steps_) {
+        step.dependencies.clear();
+        for (auto& name : step.dependency_names) {
+            int index = -1;
+            for (int i = 0; i < (int)steps_.size(); i++) {
+                if (steps_[i].name == name) {
+                    index = i;
+                    break;
+                }
+            }
+            if (index < 0) {
+                ESP_LOGE(TAG, "Step %s depends on unknown step %s", step.name.c_str(), name.c_str());
+                return false;
+            }
+            step.dependencies.push_back(index);
+        }
+    }
+
+    // Reject cycles, which would leave steps pending forever
+    std::vector<int> remaining(steps_.size());
+    for (size_t i = 0; i < steps_.size(); i++) {
+        remaining[i] = steps_[i].dependencies.size();
+    }
+    std::vector<bool> resolved(steps_.size(), false);
+    size_t resolved_count = 0;
+    bool progress = true;
+    while (progress) {
+        progress = false;
+        for (size_t i = 0; i < steps_.size(); i++) {
+            if (resolved[i] || remaining[i] > 0) {
+                continue;
+            }
+            resolved[i] = true;
+            resolved_count++;
+            progress = true;
+            for (size_t j = 0; j < steps_.size(); j++) {
+                for (int dependency : steps_[j].dependencies) {
+                    if (dependency == (int)i) {
+                        remaining[j]--;
+                    }
+                }
+            }
+        }
+    }
+    if (resolved_count != steps_.size()) {
+        ESP_LOGE(TAG, "Boot steps contain a dependency cycle");
+        return false;
+    }
+    return true;
+}
+
+bool BootScheduler::IsReady(const Step& step) const {
+    if (step.state != kStepStatePending) {
+        return false;
+    }
+    for (int dependency : step.dependencies) {
+        if (steps_[dependency].state != kStepStateDone) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void BootScheduler::RunStep(Step& step) {
+    ESP_LOGI(TAG, "Step %s started", step.name.c_str());
+    step.callback();
+    int64_t end_time = esp_timer_get_time();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    step.end_time_us = end_time;
+    step.state = kStepStateDone;
+    ESP_LOGI(TAG, "Step %s done in %d ms", step.name.c_str(), int((step.end_time_us - step.start_time_us) / 1000));
+    // Start the dependent steps right away, even if the caller is busy with a step of its own
+    LaunchReadySteps();
+    cv_.notify_all();
+}
+
+void BootScheduler::LaunchReadySteps() {
+    for (auto& step : steps_) {
+        if (step.stack_size == 0 || !IsReady(step)) {
+            continue;
+        }
+
+        step.state = kStepStateRunning;
+        step.start_time_us = esp_timer_get_time();
+        std::string task_name = "boot_" + step.name;
+        if (xTaskCreate([](void* arg) {
+            Step* step = static_cast<Step*>(arg);
+            step->scheduler->RunStep(*step);
+            vTaskDelete(NULL);
+        }, task_name.c_str(), step.stack_size, &step, step.priority, nullptr) != pdPASS) {
+            // Not enough memory for the task, run the step in the caller instead
+            ESP_LOGW(TAG, "Failed to create task for step %s", step.name.c_str());
+            step.state = kStepStatePending;
+            step.stack_size = 0;
+        }
+    }
+}
+
+bool BootScheduler::Run() {
+    if (!ResolveDependencies()) {
+        return false;
+    }
+
+    run_start_time_us_ = esp_timer_get_time();
+    std::unique_lock<std::mutex> lock(mutex_);
+    LaunchReadySteps();
+    while (true) {
+        Step* inline_step = nullptr;
+        bool all_done = true;
+        for (auto& step : steps_) {
+            if (step.state != kStepStateDone) {
+                all_done = false;
+            }
+            if (inline_step == nullptr && step.stack_size == 0 && IsReady(step)) {
+                inline_step = &step;
+            }
+        }
+        if (all_done) {
+            break;
+        }
+
+        if (inline_step != nullptr) {
+            inline_step->state = kStepStateRunning;
+            inline_step->start_time_us = esp_timer_get_time();
+            lock.unlock();
+            RunStep(*inline_step);
+            lock.lock();
+            continue;
+        }
+        cv_.wait(lock);
+    }
+    run_end_time_us_ = esp_timer_get_time();
+    return true;
+}
+
+void BootScheduler::PrintTimeline() const {
+    ESP_LOGI(TAG, "Boot steps finished in %d ms, started at %d ms since boot",
+        int((run_end_time_us_ - run_start_time_us_) / 1000), int(run_start_time_us_ / 1000));
+    for (auto& step : steps_) {
+        ESP_LOGI(TAG, "  %-12s %6d -> %6d ms", step.name.c_str(),
+            int((step.start_time_us - run_start_time_us_) / 1000), int((step.end_time_us - run_start_time_us_) / 1000));
+    }
+}
@@ -0,0 +1,66 @@
+#ifndef BOOT_SCHEDULER_H
+#define BOOT_SCHEDULER_H
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+
+
+/*
+ * Runs the boot steps as a dependency graph.
+ * A step starts as soon as all of its dependencies have finished. Steps with a stack size run
+ * in their own task and overlap with each other, steps without one run in the task calling Run,
+ * which suits steps that need a large stack or must not run concurrently with the caller.
+ */
+class BootScheduler {
+public:
+    BootScheduler();
+    ~BootScheduler();
+    BootScheduler(const BootScheduler&) = delete;
+    BootScheduler& operator=(const BootScheduler&) = delete;
+
+    void AddStep(const std::string& name, const std::vector<std::string>& dependencies,
+        std::function<void()> callback, uint32_t stack_size = 0, UBaseType_t priority = 2);
+    // Run all the steps and wait for them to finish
+    bool Run();
+    void PrintTimeline() const;
+
+private:
+    enum StepState {
+        kStepStatePending,
+        kStepStateRunning,
+        kStepStateDone,
+    };
+
+    struct Step {
+        std::string name;
+        std::vector<int> dependencies;
+        std::vector<std::string> dependency_names;
+        std::function<void()> callback;
+        uint32_t stack_size;
+        UBaseType_t priority;
+        StepState state = kStepStatePending;
+        int64_t start_time_us = 0;
+        int64_t end_time_us = 0;
+        BootScheduler* scheduler = nullptr;
+    };
+
+    std::vector<Step> steps_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    int64_t run_start_time_us_ = 0;
+    int64_t run_end_time_us_ = 0;
+
+    bool ResolveDependencies();
+    bool IsReady(const Step& step) const;
+    // Called with mutex_ held
+    void LaunchReadySteps();
+    void RunStep(Step& step);
+};
+
+#endif // BOOT_SCHEDULER_H
@@ -0,0 +1,186 @@
+#include "cpu_profiler.h"
+
+#include <esp_log.h>
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
+
+#define TAG "CpuProfiler"
+
+// The rolling average moves by 1/8 of the difference each sample
+#define AVERAGE_WEIGHT 8
+
+
+CpuProfiler::CpuProfiler() {
+    esp_timer_create_args_t timer_args = {
+        .callback = [](void* arg) {
+            static_cast<CpuProfiler*>(arg)->Sample();
+        },
+        .arg = this,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "cpu_profiler",
+        .skip_unhandled_events = true,
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&timer_args, &timer_));
+}
+
+CpuProfiler::~CpuProfiler() {
+    esp_timer_stop(timer_);
+    esp_timer_delete(timer_);
+    free(status_);
+}
+
+void CpuProfiler::Start(int period_ms) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (status_ == nullptr) {
+        status_ = static_cast<TaskStatus_t*>(malloc(sizeof(TaskStatus_t) * MAX_PROFILED_TASKS));
+        if (status_ == nullptr) {
+            ESP_LOGE(TAG, "Failed to allocate the task status buffer");
+            return;
+        }
+    }
+    task_count_ = 0;
+    samples_ = 0;
+    esp_timer_stop(timer_);
+    esp_timer_start_periodic(timer_, period_ms * 1000);
+}
+
+void CpuProfiler::Stop() {
+    esp_timer_stop(timer_);
+}
+
+void CpuProfiler::SetBudget(const char* task_name, int percent) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto budget = FindBudget(task_name);
+    if (budget == nullptr) {
+        if (budget_count_ >= MAX_CPU_BUDGETS) {
+            return;
+        }
+        budget = &budgets_[budget_count_++];
+        strlcpy(budget->name, task_name, sizeof(budget->name));
+    }
+    budget->permille = percent * 10;
+}
+
+void CpuProfiler::ReportDeadlineMiss(const char* task_name) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (int i = 0; i < task_count_; i++) {
+        if (strcmp(tasks_[i].name, task_name) == 0) {
+            tasks_[i].deadline_misses++;
+            return;
+        }
+    }
+}
+
+CpuProfiler::Budget* CpuProfiler::FindBudget(const char* task_name) {
+    for (int i = 0; i < budget_count_; i++) {
+        if (strcmp(budgets_[i].name, task_name) == 0) {
+            return &budgets_[i];
+        }
+    }
+    return nullptr;
+}
+
+void CpuProfiler::Sample() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    configRUN_TIME_COUNTER_TYPE total_time;
+    UBaseType_t count = uxTaskGetSystemState(status_, MAX_PROFILED_TASKS, &total_time);
+    if (count == 0) {
+        ESP_LOGW(TAG, "More than %d tasks, profiling stopped", MAX_PROFILED_TASKS);
+        esp_timer_stop(timer_);
+        return;
+    }
+
+    uint64_t elapsed = total_time - last_total_time_;
+    last_total_time_ = total_time;
+    bool first_sample = samples_++ == 0;
+
+    for (int i = 0; i < task_count_; i++) {
+        tasks_[i].alive = false;
+    }
+    for (UBaseType_t i = 0; i < count; i++) {
+        auto& status = status_[i];
+        TaskStats* task = nullptr;
+        for (int j = 0; j < task_count_; j++) {
+            if (tasks_[j].handle == status.xHandle) {
+                task = &tasks_[j];
+                break;
+            }
+        }
+        if (task == nullptr) {
+            if (task_count_ >= MAX_PROFILED_TASKS) {
+                continue;
+            }
+            // New task, its share is known from the next sample
+            task = &tasks_[task_count_++];
+            memset(task, 0, sizeof(*task));
+            task->handle = status.xHandle;
+            strlcpy(task->name, status.pcTaskName, sizeof(task->name));
+            task->last_run_time = status.ulRunTimeCounter;
+            task->stack_high_water = status.usStackHighWaterMark;
+            task->alive = true;
+            continue;
+        }
+
+        task->alive = true;
+        task->stack_high_water = status.usStackHighWaterMark;
+        uint64_t run_time = status.ulRunTimeCounter - task->last_run_time;
+        task->last_run_time = status.ulRunTimeCounter;
+        if (first_sample || elapsed == 0) {
+            continue;
+        }
+        task->current_permille = std::min<uint64_t>(run_time * 1000 / elapsed, 1000);
+        task->average_permille += (int(task->current_permille) - int(task->average_permille)) / AVERAGE_WEIGHT;
+        task->peak_permille = std::max(task->peak_permille, task->current_permille);
+
+        auto budget = FindBudget(task->name);
+        if (budget != nullptr) {
+            if (!task->over_budget && task->average_permille > budget->permille) {
+                task->over_budget = true;
+                ESP_LOGW(TAG, "%s uses %d.%d%% CPU, over its budget of %d%%", task->name,
+                    task->average_permille / 10, task->average_permille % 10, budget->permille / 10);
+            } else if (task->over_budget && task->average_permille < budget->permille * 9 / 10) {
+                task->over_budget = false;
+            }
+        }
+        if (task->deadline_misses != task->reported_misses) {
+            ESP_LOGW(TAG, "%s missed %lu frame deadlines", task->name, task->deadline_misses - task->reported_misses);
+            task->reported_misses = task->deadline_misses;
+        }
+    }
+
+    // Forget the deleted tasks
+    int alive_count = 0;
+    for (int i = 0; i < task_count_; i++) {
+        if (tasks_[i].alive) {
+            tasks_[alive_count++] = tasks_[i];
+        }
+    }
+    task_count_ = alive_count;
+}
+
+cJSON* CpuProfiler::ToJson() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    cJSON* json = cJSON_CreateObject();
+    cJSON_AddNumberToObject(json, "samples", samples_);
+    cJSON_AddNumberToObject(json, "cores", CONFIG_FREERTOS_NUMBER_OF_CORES);
+    cJSON* tasks = cJSON_CreateArray();
+    for (int i = 0; i < task_count_; i++) {
+        auto& task = tasks_[i];
+        cJSON* item = cJSON_CreateObject();
+        cJSON_AddStringToObject(item, "name", task.name);
+        cJSON_AddNumberToObject(item, "cpu", task.current_permille / 10.0);
+        cJSON_AddNumberToObject(item, "cpu_average", task.average_permille / 10.0);
+        cJSON_AddNumberToObject(item, "cpu_peak", task.peak_permille / 10.0);
+        cJSON_AddNumberToObject(item, "stack_free_min", task.stack_high_water);
+        if (task.deadline_misses > 0) {
+            cJSON_AddNumberToObject(item, "deadline_misses", task.deadline_misses);
+        }
+        if (task.over_budget) {
+            cJSON_AddBoolToObject(item, "over_budget", true);
+        }
+        cJSON_AddItemToArray(tasks, item);
+    }
+    cJSON_AddItemToObject(json, "tasks", tasks);
+    return json;
+}
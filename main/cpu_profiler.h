@@ -0,0 +1,75 @@
+#ifndef CPU_PROFILER_H
+#define CPU_PROFILER_H
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <esp_timer.h>
+#include <cJSON.h>
+
+#include <mutex>
+
+#define MAX_PROFILED_TASKS 48
+#define MAX_CPU_BUDGETS 8
+
+/*
+ * Samples the FreeRTOS run time counters of all tasks in the background into preallocated buffers.
+ * Keeps a rolling CPU share and the stack high-water mark of each task, and warns when a task goes over
+ * its CPU budget or misses frame deadlines. Reading the statistics never waits for a sample window.
+ */
+class CpuProfiler {
+public:
+    static CpuProfiler& GetInstance() {
+        static CpuProfiler instance;
+        return instance;
+    }
+    CpuProfiler(const CpuProfiler&) = delete;
+    CpuProfiler& operator=(const CpuProfiler&) = delete;
+
+    void Start(int period_ms);
+    void Stop();
+    // Warn when the rolling CPU share of the task exceeds `percent` of one core
+    void SetBudget(const char* task_name, int percent);
+    // Called by a task that could not deliver a frame in time
+    void ReportDeadlineMiss(const char* task_name);
+
+    cJSON* ToJson();
+
+private:
+    struct TaskStats {
+        TaskHandle_t handle;
+        char name[configMAX_TASK_NAME_LEN];
+        configRUN_TIME_COUNTER_TYPE last_run_time;
+        // CPU share of one core in 0.1%
+        uint16_t current_permille;
+        uint16_t average_permille;
+        uint16_t peak_permille;
+        uint32_t stack_high_water;
+        uint32_t deadline_misses;
+        uint32_t reported_misses;
+        bool over_budget;
+        bool alive;
+    };
+
+    struct Budget {
+        char name[configMAX_TASK_NAME_LEN];
+        uint16_t permille;
+    };
+
+    CpuProfiler();
+    ~CpuProfiler();
+
+    std::mutex mutex_;
+    esp_timer_handle_t timer_ = nullptr;
+    TaskStatus_t* status_ = nullptr;
+    TaskStats tasks_[MAX_PROFILED_TASKS];
+    int task_count_ = 0;
+    Budget budgets_[MAX_CPU_BUDGETS];
+    int budget_count_ = 0;
+    configRUN_TIME_COUNTER_TYPE last_total_time_ = 0;
+    uint32_t samples_ = 0;
+
+    void Sample();
+    Budget* FindBudget(const char* task_name);
+};
+
+#endif // CPU_PROFILER_H
@@ -1,46 +1,127 @@
 #include "device_state_event.h"
 
-ESP_EVENT_DEFINE_BASE(XIAOZHI_STATE_EVENTS);
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <algorithm>
+#include <string>
+
+#define TAG "StateEvent"
+
 
 DeviceStateEventManager& DeviceStateEventManager::GetInstance() {
     static DeviceStateEventManager instance;
     return instance;
 }
 
-void DeviceStateEventManager::RegisterStateChangeCallback(std::function<void(DeviceState, DeviceState)> callback) {
-    std::lock_guard<std::mutex> lock(mutex_);
-    callbacks_.push_back(callback);
+void DeviceStateEventManager::RegisterStateChangeCallback(std::function<void(DeviceState, DeviceState)> callback,
+    bool coalesce, const char* name) {
+    auto subscriber = std::make_shared<Subscriber>();
+    subscriber->callback = std::move(callback);
+    subscriber->coalesce = coalesce;
+    subscriber->name = name;
+
+    // Registration is rare, publish a new copy of the list for the dispatcher to pick up
+    std::lock_guard<std::mutex> lock(register_mutex_);
+    auto subscribers = std::make_shared<SubscriberList>(*std::atomic_load(&subscribers_));
+    subscribers->push_back(std::move(subscriber));
+    std::atomic_store(&subscribers_, std::shared_ptr<const SubscriberList>(std::move(subscribers)));
 }
 
 void DeviceStateEventManager::PostStateChangeEvent(DeviceState previous_state, DeviceState current_state) {
-    device_state_event_data_t event_data = {
+    Event event = {
         .previous_state = previous_state,
-        .current_state = current_state
+        .current_state = current_state,
+        .post_time_us = esp_timer_get_time(),
     };
-    esp_event_post(XIAOZHI_STATE_EVENTS, XIAOZHI_STATE_CHANGED_EVENT, &event_data, sizeof(event_data), portMAX_DELAY);
+
+    portENTER_CRITICAL(&queue_lock_);
+    if (queue_count_ < STATE_EVENT_QUEUE_SIZE) {
+        queue_[(queue_head_ + queue_count_) % STATE_EVENT_QUEUE_SIZE] = event;
+        queue_count_++;
+    } else {
+        // Full, fold the event into the newest one so the final state is still delivered
+        auto& newest = queue_[(queue_head_ + queue_count_ - 1) % STATE_EVENT_QUEUE_SIZE];
+        newest.current_state = current_state;
+        newest.post_time_us = event.post_time_us;
+        coalesced_events_++;
+    }
+    portEXIT_CRITICAL(&queue_lock_);
+
+    if (dispatch_task_ != nullptr) {
+        xTaskNotifyGive(dispatch_task_);
+    }
+}
+
+void DeviceStateEventManager::DispatchTask() {
+    Event events[STATE_EVENT_QUEUE_SIZE];
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        size_t count;
+        portENTER_CRITICAL(&queue_lock_);
+        count = queue_count_;
+        for (size_t i = 0; i < count; i++) {
+            events[i] = queue_[(queue_head_ + i) % STATE_EVENT_QUEUE_SIZE];
+        }
+        queue_head_ = (queue_head_ + count) % STATE_EVENT_QUEUE_SIZE;
+        queue_count_ = 0;
+        portEXIT_CRITICAL(&queue_lock_);
+        if (count == 0) {
+            continue;
+        }
+
+        auto subscribers = std::atomic_load(&subscribers_);
+        for (auto& subscriber : *subscribers) {
+            if (subscriber->coalesce) {
+                if (events[0].previous_state != events[count - 1].current_state) {
+                    Deliver(*subscriber, events[0], events[count - 1]);
+                }
+            } else {
+                for (size_t i = 0; i < count; i++) {
+                    Deliver(*subscriber, events[i], events[i]);
+                }
+            }
+        }
+    }
 }
 
-std::vector<std::function<void(DeviceState, DeviceState)>> DeviceStateEventManager::GetCallbacks() {
-    std::lock_guard<std::mutex> lock(mutex_);
-    return callbacks_;
+void DeviceStateEventManager::Deliver(Subscriber& subscriber, const Event& first, const Event& last) {
+    int64_t start_time = esp_timer_get_time();
+    subscriber.callback(first.previous_state, last.current_state);
+    int64_t end_time = esp_timer_get_time();
+
+    uint32_t latency = start_time - last.post_time_us;
+    uint32_t callback_time = end_time - start_time;
+    subscriber.deliveries++;
+    subscriber.total_latency_us += latency;
+    subscriber.max_latency_us = std::max(subscriber.max_latency_us.load(), latency);
+    subscriber.max_callback_us = std::max(subscriber.max_callback_us.load(), callback_time);
 }
 
-DeviceStateEventManager::DeviceStateEventManager() {
-    esp_err_t err = esp_event_loop_create_default();
-    if (err != ESP_OK && err != ESP_ERR_INVALID_STATE) {
-        ESP_ERROR_CHECK(err);
+void DeviceStateEventManager::PrintStatistics() {
+    auto subscribers = std::atomic_load(&subscribers_);
+    ESP_LOGI(TAG, "Subscribers: %u, events folded on overflow: %lu", subscribers->size(), coalesced_events_);
+    for (size_t i = 0; i < subscribers->size(); i++) {
+        auto& subscriber = *(*subscribers)[i];
+        uint32_t deliveries = subscriber.deliveries;
+        ESP_LOGI(TAG, "%s: %lu deliveries, latency avg %llu us max %lu us, callback max %lu us",
+            subscriber.name ? subscriber.name : std::to_string(i).c_str(), deliveries,
+            deliveries ? subscriber.total_latency_us.load() / deliveries : 0,
+            subscriber.max_latency_us.load(), subscriber.max_callback_us.load());
     }
+}
 
-    ESP_ERROR_CHECK(esp_event_handler_register(XIAOZHI_STATE_EVENTS, XIAOZHI_STATE_CHANGED_EVENT, 
-        [](void* handler_args, esp_event_base_t base, int32_t id, void* event_data) {
-            auto* data = static_cast<device_state_event_data_t*>(event_data);
-            auto& manager = DeviceStateEventManager::GetInstance();
-            for (const auto& callback : manager.GetCallbacks()) {
-                callback(data->previous_state, data->current_state);
-            }
-        }, nullptr));
+DeviceStateEventManager::DeviceStateEventManager() {
+    subscribers_ = std::make_shared<const SubscriberList>();
+    xTaskCreate([](void* arg) {
+        auto manager = static_cast<DeviceStateEventManager*>(arg);
+        manager->DispatchTask();
+        vTaskDelete(NULL);
+    }, "state_event", 4096, this, 4, &dispatch_task_);
 }
 
 DeviceStateEventManager::~DeviceStateEventManager() {
-    esp_event_handler_unregister(XIAOZHI_STATE_EVENTS, XIAOZHI_STATE_CHANGED_EVENT, nullptr);
-}
\ No newline at end of file
+    if (dispatch_task_ != nullptr) {
+        vTaskDelete(dispatch_task_);
+    }
+}
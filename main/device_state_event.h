@@ -1,39 +1,73 @@
 #ifndef _DEVICE_STATE_EVENT_H_
 #define _DEVICE_STATE_EVENT_H_
 
-#include <esp_event.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
 #include <functional>
 #include <vector>
+#include <memory>
 #include <mutex>
+#include <atomic>
 #include "device_state.h"
 
-ESP_EVENT_DECLARE_BASE(XIAOZHI_STATE_EVENTS);
-
-enum {
-    XIAOZHI_STATE_CHANGED_EVENT,
-};
+#define STATE_EVENT_QUEUE_SIZE 16
 
 struct device_state_event_data_t {
     DeviceState previous_state;
     DeviceState current_state;
 };
 
+/*
+ * Delivers device state changes to the registered callbacks from a dispatch task.
+ * Posting never blocks: events go to a fixed ring, and when it is full the newest event absorbs the next one.
+ * The subscriber list is copied on registration and swapped atomically, so dispatching takes no lock.
+ * Coalescing subscribers only see the overall change of the events pending at dispatch time.
+ */
 class DeviceStateEventManager {
 public:
     static DeviceStateEventManager& GetInstance();
     DeviceStateEventManager(const DeviceStateEventManager&) = delete;
     DeviceStateEventManager& operator=(const DeviceStateEventManager&) = delete;
 
-    void RegisterStateChangeCallback(std::function<void(DeviceState, DeviceState)> callback);
+    void RegisterStateChangeCallback(std::function<void(DeviceState, DeviceState)> callback, bool coalesce = false,
+        const char* name = nullptr);
     void PostStateChangeEvent(DeviceState previous_state, DeviceState current_state);
-    std::vector<std::function<void(DeviceState, DeviceState)>> GetCallbacks();
+    // Log the delivery latency and callback time of each subscriber
+    void PrintStatistics();
 
 private:
+    struct Subscriber {
+        std::function<void(DeviceState, DeviceState)> callback;
+        bool coalesce = false;
+        const char* name = nullptr;
+        std::atomic<uint32_t> deliveries = 0;
+        std::atomic<uint64_t> total_latency_us = 0;
+        std::atomic<uint32_t> max_latency_us = 0;
+        std::atomic<uint32_t> max_callback_us = 0;
+    };
+    using SubscriberList = std::vector<std::shared_ptr<Subscriber>>;
+
+    struct Event {
+        DeviceState previous_state;
+        DeviceState current_state;
+        int64_t post_time_us;
+    };
+
     DeviceStateEventManager();
     ~DeviceStateEventManager();
 
-    std::vector<std::function<void(DeviceState, DeviceState)>> callbacks_;
-    std::mutex mutex_;
+    std::shared_ptr<const SubscriberList> subscribers_;
+    std::mutex register_mutex_;
+
+    portMUX_TYPE queue_lock_ = portMUX_INITIALIZER_UNLOCKED;
+    Event queue_[STATE_EVENT_QUEUE_SIZE];
+    size_t queue_head_ = 0;
+    size_t queue_count_ = 0;
+    uint32_t coalesced_events_ = 0;
+    TaskHandle_t dispatch_task_ = nullptr;
+
+    void DispatchTask();
+    void Deliver(Subscriber& subscriber, const Event& first, const Event& last);
 };
 
-#endif // _DEVICE_STATE_EVENT_H_ 
\ No newline at end of file
+#endif // _DEVICE_STATE_EVENT_H_ 
@@ -25,6 +25,8 @@ private:
     std::string name_;
 };
 
+class DisplayMetrics;
+
 class Display {
 public:
     Display();
@@ -42,6 +44,8 @@ public:
 
     inline int width() const { return width_; }
     inline int height() const { return height_; }
+    // Render statistics, nullptr when the display does not collect them
+    virtual DisplayMetrics* metrics() { return nullptr; }
 
 protected:
     int width_ = 0;
@@ -0,0 +1,204 @@
+#include "display_metrics.h"
+
+#include <esp_log.h>
+#include <esp_timer.h>
+
+#include <algorithm>
+
+#define TAG "DisplayMetrics"
+
+int MetricsHistogram::BucketIndex(uint32_t value) {
+    if (value == 0) {
+        return 0;
+    }
+    int index = 32 - __builtin_clz(value);
+    return std::min(index, kBucketCount - 1);
+}
+
+uint32_t MetricsHistogram::BucketUpperBound(int index) {
+    if (index <= 0) {
+        return 0;
+    }
+    return (1u << index) - 1;
+}
+
+void MetricsHistogram::Record(uint32_t value) {
+    buckets_[BucketIndex(value)]++;
+    count_++;
+    sum_ += value;
+    max_ = std::max(max_, value);
+}
+
+void MetricsHistogram::Reset() {
+    std::fill(std::begin(buckets_), std::end(buckets_), 0);
+    count_ = 0;
+    max_ = 0;
+    sum_ = 0;
+}
+
+uint32_t MetricsHistogram::Percentile(int percent) const {
+    if (count_ == 0) {
+        return 0;
+    }
+    // Rank of the sample, rounded up so that P100 is the last sample
+    uint64_t rank = (static_cast<uint64_t>(count_) * percent + 99) / 100;
+    uint64_t seen = 0;
+    for (int i = 0; i < kBucketCount; i++) {
+        seen += buckets_[i];
+        if (seen >= rank && buckets_[i] > 0) {
+            return std::min(BucketUpperBound(i), max_);
+        }
+    }
+    return max_;
+}
+
+cJSON* MetricsHistogram::ToJson(const char* unit) const {
+    cJSON* json = cJSON_CreateObject();
+    cJSON_AddStringToObject(json, "unit", unit);
+    cJSON_AddNumberToObject(json, "count", count_);
+    cJSON_AddNumberToObject(json, "avg", average());
+    cJSON_AddNumberToObject(json, "p50", Percentile(50));
+    cJSON_AddNumberToObject(json, "p90", Percentile(90));
+    cJSON_AddNumberToObject(json, "p99", Percentile(99));
+    cJSON_AddNumberToObject(json, "max", max_);
+
+    // Only non-empty buckets are reported, as [upper_bound, count] pairs
+    cJSON* buckets = cJSON_CreateArray();
+    for (int i = 0; i < kBucketCount; i++) {
+        if (buckets_[i] == 0) {
+            continue;
+        }
+        cJSON* bucket = cJSON_CreateArray();
+        cJSON_AddItemToArray(bucket, cJSON_CreateNumber(BucketUpperBound(i)));
+        cJSON_AddItemToArray(bucket, cJSON_CreateNumber(buckets_[i]));
+        cJSON_AddItemToArray(buckets, bucket);
+    }
+    cJSON_AddItemToObject(json, "buckets", buckets);
+    return json;
+}
+
+DisplayMetrics::DisplayMetrics() {
+    reset_time_us_ = esp_timer_get_time();
+    last_log_time_us_ = reset_time_us_;
+}
+
+void DisplayMetrics::SetRefreshPeriod(uint32_t period_ms) {
+    refresh_period_us_ = std::max<uint32_t>(period_ms, 1) * 1000;
+}
+
+void DisplayMetrics::OnFrameStart() {
+    frame_start_us_ = esp_timer_get_time();
+    frame_flush_us_ = 0;
+    frame_dirty_pixels_ = 0;
+}
+
+void DisplayMetrics::OnRenderStart(uint32_t dirty_pixels) {
+    frame_dirty_pixels_ = dirty_pixels;
+}
+
+void DisplayMetrics::OnFrameEnd() {
+    if (frame_start_us_ == 0) {
+        return;
+    }
+    uint32_t frame_time_us = esp_timer_get_time() - frame_start_us_;
+    frame_start_us_ = 0;
+    CommitFrame(frame_time_us, frame_flush_us_, frame_dirty_pixels_);
+}
+
+void DisplayMetrics::OnFlushStart() {
+    flush_start_us_ = esp_timer_get_time();
+}
+
+void DisplayMetrics::OnFlushEnd() {
+    if (flush_start_us_ == 0) {
+        return;
+    }
+    frame_flush_us_ += esp_timer_get_time() - flush_start_us_;
+    flush_start_us_ = 0;
+}
+
+void DisplayMetrics::RecordFlush(int64_t start_time_us, int y_start, int y_end, uint32_t pixels) {
+    int64_t end_time_us = esp_timer_get_time();
+    // A frame is flushed in stripes from top to bottom without pausing, a stripe above the last one
+    // or after a pause of half a refresh period starts the next frame
+    if (frame_start_us_ != 0 && (y_start < last_flush_y_end_ ||
+        start_time_us - last_flush_end_us_ > refresh_period_us_ / 2)) {
+        CommitFrame(last_flush_end_us_ - frame_start_us_, frame_flush_us_, frame_dirty_pixels_);
+        frame_start_us_ = 0;
+    }
+    if (frame_start_us_ == 0) {
+        frame_start_us_ = start_time_us;
+        frame_flush_us_ = 0;
+        frame_dirty_pixels_ = 0;
+    }
+    frame_flush_us_ += end_time_us - start_time_us;
+    frame_dirty_pixels_ += pixels;
+    last_flush_end_us_ = end_time_us;
+    last_flush_y_end_ = y_end;
+}
+
+void DisplayMetrics::RecordDecodeTime(uint32_t time_us) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    decode_time_.Record(time_us);
+}
+
+void DisplayMetrics::CommitFrame(uint32_t frame_time_us, uint32_t flush_time_us, uint32_t dirty_pixels) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    flush_time_us = std::min(flush_time_us, frame_time_us);
+    render_time_.Record(frame_time_us - flush_time_us);
+    flush_time_.Record(flush_time_us);
+    dirty_area_.Record(dirty_pixels);
+    total_frames_++;
+    // A frame that takes longer than the refresh period delays the following ones
+    if (frame_time_us > refresh_period_us_) {
+        dropped_frames_ += frame_time_us / refresh_period_us_;
+    }
+}
+
+void DisplayMetrics::Reset() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    render_time_.Reset();
+    flush_time_.Reset();
+    dirty_area_.Reset();
+    decode_time_.Reset();
+    total_frames_ = 0;
+    dropped_frames_ = 0;
+    reset_time_us_ = esp_timer_get_time();
+    last_log_frames_ = 0;
+    last_log_dropped_frames_ = 0;
+    last_log_time_us_ = reset_time_us_;
+}
+
+cJSON* DisplayMetrics::ToJson() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    int64_t elapsed_us = esp_timer_get_time() - reset_time_us_;
+
+    cJSON* json = cJSON_CreateObject();
+    cJSON_AddNumberToObject(json, "elapsed_ms", elapsed_us / 1000);
+    cJSON_AddNumberToObject(json, "frames", total_frames_);
+    cJSON_AddNumberToObject(json, "dropped_frames", dropped_frames_);
+    cJSON_AddNumberToObject(json, "fps", elapsed_us > 0 ? total_frames_ * 1000000.0 / elapsed_us : 0);
+    cJSON_AddItemToObject(json, "render_time", render_time_.ToJson("us"));
+    cJSON_AddItemToObject(json, "flush_time", flush_time_.ToJson("us"));
+    cJSON_AddItemToObject(json, "dirty_area", dirty_area_.ToJson("px"));
+    cJSON_AddItemToObject(json, "decode_time", decode_time_.ToJson("us"));
+    return json;
+}
+
+void DisplayMetrics::LogSummary() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    int64_t now = esp_timer_get_time();
+    uint32_t frames = total_frames_ - last_log_frames_;
+    uint32_t dropped = dropped_frames_ - last_log_dropped_frames_;
+    int64_t elapsed_us = now - last_log_time_us_;
+    last_log_frames_ = total_frames_;
+    last_log_dropped_frames_ = dropped_frames_;
+    last_log_time_us_ = now;
+
+    if (frames == 0 || elapsed_us <= 0) {
+        return;
+    }
+    ESP_LOGI(TAG, " %.1f fps, %lu dropped, render avg %lu us p90 %lu us, flush avg %lu us, decode avg %lu us",
+        frames * 1000000.0f / elapsed_us, dropped, render_time_.average(), render_time_.Percentile(90),
+        flush_time_.average(), decode_time_.average());
+}
@@ -0,0 +1,87 @@
+#ifndef DISPLAY_METRICS_H
+#define DISPLAY_METRICS_H
+
+#include <cJSON.h>
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+// Histogram with power-of-two buckets, bucket 0 counts value 0 and bucket i counts [2^(i-1), 2^i)
+class MetricsHistogram {
+public:
+    static constexpr int kBucketCount = 20;
+
+    void Record(uint32_t value);
+    void Reset();
+    uint32_t Percentile(int percent) const;
+    cJSON* ToJson(const char* unit) const;
+
+    inline uint32_t count() const { return count_; }
+    inline uint32_t max() const { return max_; }
+    inline uint32_t average() const { return count_ > 0 ? static_cast<uint32_t>(sum_ / count_) : 0; }
+
+    static int BucketIndex(uint32_t value);
+    static uint32_t BucketUpperBound(int index);
+
+private:
+    uint32_t buckets_[kBucketCount] = {};
+    uint32_t count_ = 0;
+    uint32_t max_ = 0;
+    uint64_t sum_ = 0;
+};
+
+// Per-frame render, flush and decode statistics of a display.
+// The On* hooks are called from the render task, the getters from any task.
+class DisplayMetrics {
+public:
+    DisplayMetrics();
+
+    // Expected refresh period, frames taking longer than this count as dropped
+    void SetRefreshPeriod(uint32_t period_ms);
+
+    void OnFrameStart();
+    // Pixels rendered in the frame, after the invalidated areas were rounded and joined
+    void OnRenderStart(uint32_t dirty_pixels);
+    void OnFrameEnd();
+    void OnFlushStart();
+    void OnFlushEnd();
+
+    // For render engines that only expose a flush callback. Frames are told apart from the rows flushed,
+    // a frame is committed when the next one starts
+    void RecordFlush(int64_t start_time_us, int y_start, int y_end, uint32_t pixels);
+    void RecordDecodeTime(uint32_t time_us);
+
+    void Reset();
+    cJSON* ToJson();
+    // Log a summary of the frames rendered since the last call
+    void LogSummary();
+
+private:
+    std::mutex mutex_;
+    uint32_t refresh_period_us_ = 33000;
+
+    // Accumulated within the current frame, only touched by the render task
+    int64_t frame_start_us_ = 0;
+    int64_t flush_start_us_ = 0;
+    uint32_t frame_flush_us_ = 0;
+    uint32_t frame_dirty_pixels_ = 0;
+    int64_t last_flush_end_us_ = 0;
+    int last_flush_y_end_ = 0;
+
+    MetricsHistogram render_time_;
+    MetricsHistogram flush_time_;
+    MetricsHistogram dirty_area_;
+    MetricsHistogram decode_time_;
+    uint32_t total_frames_ = 0;
+    uint32_t dropped_frames_ = 0;
+    int64_t reset_time_us_ = 0;
+
+    uint32_t last_log_frames_ = 0;
+    uint32_t last_log_dropped_frames_ = 0;
+    int64_t last_log_time_us_ = 0;
+
+    void CommitFrame(uint32_t frame_time_us, uint32_t flush_time_us, uint32_t dirty_pixels);
+};
+
+#endif // DISPLAY_METRICS_H
@@ -369,10 +369,16 @@ void EmoteEngine::OnFlush(const gfx_handle_t handle, const int x_start, const in
                           const int x_end, const int y_end, const void* const color_data)
 {
     auto* const panel = static_cast<esp_lcd_panel_handle_t>(gfx_emote_get_user_data(handle));
+    const int64_t start_time_us = esp_timer_get_time();
     if (panel) {
         esp_lcd_panel_draw_bitmap(panel, x_start, y_start, x_end, y_end, color_data);
     }
     gfx_emote_flush_ready(handle, true);
+
+    auto* const display = Board::GetInstance().GetDisplay();
+    if (display && display->metrics()) {
+        display->metrics()->RecordFlush(start_time_us, y_start, y_end, (x_end - x_start) * (y_end - y_start));
+    }
 }
 
 // ============================================================================
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "display.h"
+#include "display_metrics.h"
 #include "lvgl_font.h"
 #include <memory>
 #include <functional>
@@ -67,6 +68,7 @@ public:
     virtual void UpdateStatusBar(bool update_all = false) override;
     virtual void SetPowerSaveMode(bool on) override;
     virtual void SetPreviewImage(const void* image);
+    virtual DisplayMetrics* metrics() override { return &metrics_; }
 
     void AddEmojiData(const std::string &name, const void* data, size_t size, uint8_t fps = 0, bool loop = false, bool lack = false);
     void AddIconData(const std::string &name, const void* data, size_t size);
@@ -89,6 +91,7 @@ private:
     virtual void Unlock() override;
 
     std::unique_ptr<EmoteEngine> engine_;
+    DisplayMetrics metrics_;
 
     // Font management
     std::shared_ptr<LvglFont> text_font_ = nullptr;
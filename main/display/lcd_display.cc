@@ -1,6 +1,7 @@
 #include "lcd_display.h"
 #include "gif/lvgl_gif.h"
 #include "settings.h"
+#include "memory_accounting.h"
 #include "lvgl_theme.h"
 #include "assets/lang_config.h"
 
@@ -10,13 +11,20 @@
 #include <esp_log.h>
 #include <esp_err.h>
 #include <esp_lvgl_port.h>
+#include <src/display/lv_display_private.h>
 #include <esp_psram.h>
+#include <esp_heap_caps.h>
+#include <esp_timer.h>
 #include <cstring>
 
 #include "board.h"
+#include "assets.h"
 
 #define TAG "LcdDisplay"
 
+// Internal DMA-capable memory left free after allocating a second draw buffer
+#define LCD_DOUBLE_BUFFER_MIN_FREE_INTERNAL (48 * 1024)
+
 LV_FONT_DECLARE(BUILTIN_TEXT_FONT);
 LV_FONT_DECLARE(BUILTIN_ICON_FONT);
 LV_FONT_DECLARE(font_awesome_30_4);
@@ -88,15 +96,161 @@ LcdDisplay::LcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_handle_
     esp_timer_create(&preview_timer_args, &preview_timer_);
 }
 
+static bool IRAM_ATTR OnPanelTransferDone(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_io_event_data_t* edata,
+    void* user_ctx) {
+    BaseType_t task_woken = pdFALSE;
+    xSemaphoreGiveFromISR(static_cast<SemaphoreHandle_t>(user_ctx), &task_woken);
+    return task_woken == pdTRUE;
+}
+
+// Wait for `count` queued color transfers, without a semaphore the draws were synchronous
+static void WaitPanelTransfers(SemaphoreHandle_t transfers_done, int count) {
+    if (transfers_done == nullptr) {
+        return;
+    }
+    for (int i = 0; i < count; i++) {
+        if (xSemaphoreTake(transfers_done, pdMS_TO_TICKS(1000)) != pdTRUE) {
+            ESP_LOGW(TAG, "Timeout waiting for panel transfers");
+            return;
+        }
+    }
+}
+
+void LcdDisplay::ClearPanel(bool swap_bytes, bool async_io) {
+    auto start_time = esp_timer_get_time();
+
+    // Fill as many lines as fit in the buffer with each draw, instead of one line per transaction
+    int lines = std::clamp(PANEL_FILL_BUFFER_SIZE / (width_ * 2), 1, height_);
+    size_t buffer_size = width_ * lines * 2;
+    auto buffer = static_cast<uint8_t*>(MemoryAccounting::Malloc(kMemoryTagDisplay, buffer_size, MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL));
+    if (buffer == nullptr) {
+        lines = 1;
+        buffer_size = width_ * 2;
+        buffer = static_cast<uint8_t*>(MemoryAccounting::Malloc(kMemoryTagDisplay, buffer_size, MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL));
+        if (buffer == nullptr) {
+            ESP_LOGE(TAG, "Failed to allocate panel fill buffer");
+            return;
+        }
+    }
+
+    // The panel IO reports each finished transfer, LVGL registers its own callbacks later
+    SemaphoreHandle_t transfers_done = nullptr;
+    if (async_io) {
+        transfers_done = xSemaphoreCreateCounting(height_, 0);
+        esp_lcd_panel_io_callbacks_t callbacks = {
+            .on_color_trans_done = OnPanelTransferDone,
+        };
+        if (transfers_done == nullptr ||
+            esp_lcd_panel_io_register_event_callbacks(panel_io_, &callbacks, transfers_done) != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to watch panel transfers");
+            if (transfers_done != nullptr) {
+                vSemaphoreDelete(transfers_done);
+            }
+            MemoryAccounting::Free(kMemoryTagDisplay, buffer);
+            return;
+        }
+    }
+
+    uint16_t color = 0xFFFF;
+    if (current_theme_ != nullptr) {
+        color = lv_color_to_u16(static_cast<LvglTheme*>(current_theme_)->background_color());
+    }
+    if (swap_bytes) {
+        color = (color >> 8) | (color << 8);
+    }
+    auto pixels = reinterpret_cast<uint16_t*>(buffer);
+    std::fill(pixels, pixels + width_ * lines, color);
+
+    // The buffer content does not change, so the draws can be queued without waiting for each other
+    int draws = 0;
+    for (int y = 0; y < height_; y += lines) {
+        esp_lcd_panel_draw_bitmap(panel_, 0, y, width_, std::min(y + lines, height_), buffer);
+        draws++;
+    }
+    WaitPanelTransfers(transfers_done, draws);
+
+    if (DrawBootSplash(buffer, buffer_size, transfers_done)) {
+        splash_time_us_ = esp_timer_get_time();
+    }
+    if (transfers_done != nullptr) {
+        esp_lcd_panel_io_callbacks_t callbacks = {};
+        esp_lcd_panel_io_register_event_callbacks(panel_io_, &callbacks, nullptr);
+        vSemaphoreDelete(transfers_done);
+    }
+    MemoryAccounting::Free(kMemoryTagDisplay, buffer);
+    ESP_LOGI(TAG, "Panel cleared in %d ms", int((esp_timer_get_time() - start_time) / 1000));
+}
+
+bool LcdDisplay::DrawBootSplash(uint8_t* buffer, size_t buffer_size, SemaphoreHandle_t transfers_done) {
+    size_t offset = 0;
+    size_t size = 0;
+    int width = 0;
+    int height = 0;
+    auto partition = Assets::FindRawAsset(BOOT_SPLASH_ASSET_NAME, offset, size, width, height);
+    if (partition == nullptr) {
+        return false;
+    }
+    if (width <= 0 || height <= 0 || width > width_ || height > height_ || size != static_cast<size_t>(width * height * 2)) {
+        ESP_LOGW(TAG, "Invalid boot splash %dx%d, %u bytes", width, height, size);
+        return false;
+    }
+
+    // The splash is stored in the byte order of the panel and drawn centered
+    int x = (width_ - width) / 2;
+    int y = (height_ - height) / 2;
+    int lines = std::max<int>(1, buffer_size / (width * 2));
+    for (int row = 0; row < height; row += lines) {
+        int count = std::min(lines, height - row);
+        if (esp_partition_read(partition, offset + row * width * 2, buffer, count * width * 2) != ESP_OK) {
+            return false;
+        }
+        esp_lcd_panel_draw_bitmap(panel_, x, y + row, x + width, y + row + count, buffer);
+        WaitPanelTransfers(transfers_done, 1);
+    }
+    return true;
+}
+
+void LcdDisplay::HoldBootSplash() {
+    if (splash_time_us_ == 0 || display_ == nullptr) {
+        return;
+    }
+    int64_t remaining_us = BOOT_SPLASH_MIN_DURATION_MS * 1000 - (esp_timer_get_time() - splash_time_us_);
+    if (remaining_us <= 0) {
+        return;
+    }
+
+    // Nothing is rendered while invalidation is disabled, the whole screen is drawn once it is enabled again
+    {
+        DisplayLockGuard lock(this);
+        lv_display_enable_invalidation(display_, false);
+    }
+    esp_timer_create_args_t splash_timer_args = {
+        .callback = [](void* arg) {
+            auto display = static_cast<LcdDisplay*>(arg);
+            DisplayLockGuard lock(display);
+            lv_display_enable_invalidation(display->display_, true);
+            lv_obj_invalidate(lv_screen_active());
+        },
+        .arg = this,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "splash_timer",
+        .skip_unhandled_events = false,
+    };
+    esp_timer_create(&splash_timer_args, &splash_timer_);
+    esp_timer_start_once(splash_timer_, remaining_us);
+}
+
 SpiLcdDisplay::SpiLcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_handle_t panel,
                            int width, int height, int offset_x, int offset_y, bool mirror_x, bool mirror_y, bool swap_xy)
+    : SpiLcdDisplay(panel_io, panel, width, height, offset_x, offset_y, mirror_x, mirror_y, swap_xy, SpiLcdFlushConfig()) {
+}
+
+SpiLcdDisplay::SpiLcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_handle_t panel,
+                           int width, int height, int offset_x, int offset_y, bool mirror_x, bool mirror_y, bool swap_xy,
+                           const SpiLcdFlushConfig& flush_config)
     : LcdDisplay(panel_io, panel, width, height) {
 
-    // draw white
-    std::vector<uint16_t> buffer(width_, 0xFFFF);
-    for (int y = 0; y < height_; y++) {
-        esp_lcd_panel_draw_bitmap(panel_, 0, y, width_, y + 1, buffer.data());
-    }
+    ClearPanel(flush_config.lvgl_swap_bytes, true);
 
     // Set the display to on
     ESP_LOGI(TAG, "Turning display on");
@@ -132,13 +286,22 @@ SpiLcdDisplay::SpiLcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_h
 #endif
     lvgl_port_init(&port_cfg);
 
-    ESP_LOGI(TAG, "Adding LCD display");
+    // The draw buffers are allocated from internal DMA-capable memory, with or without PSRAM
+    size_t buffer_bytes = width_ * flush_config.buffer_lines * sizeof(uint16_t);
+    bool double_buffer = flush_config.double_buffer;
+    if (double_buffer && heap_caps_get_free_size(MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL) <
+        2 * buffer_bytes + LCD_DOUBLE_BUFFER_MIN_FREE_INTERNAL) {
+        ESP_LOGW(TAG, "Not enough internal DMA memory for double buffering");
+        double_buffer = false;
+    }
+    ESP_LOGI(TAG, "Adding LCD display, %d lines per buffer, double buffer: %d",
+        flush_config.buffer_lines, double_buffer);
     const lvgl_port_display_cfg_t display_cfg = {
         .io_handle = panel_io_,
         .panel_handle = panel_,
         .control_handle = nullptr,
-        .buffer_size = static_cast<uint32_t>(width_ * 20),
-        .double_buffer = false,
+        .buffer_size = static_cast<uint32_t>(width_ * flush_config.buffer_lines),
+        .double_buffer = double_buffer,
         .trans_size = 0,
         .hres = static_cast<uint32_t>(width_),
         .vres = static_cast<uint32_t>(height_),
@@ -153,7 +316,7 @@ SpiLcdDisplay::SpiLcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_h
             .buff_dma = 1,
             .buff_spiram = 0,
             .sw_rotate = 0,
-            .swap_bytes = 1,
+            .swap_bytes = flush_config.lvgl_swap_bytes,
             .full_refresh = 0,
             .direct_mode = 0,
         },
@@ -164,12 +327,16 @@ SpiLcdDisplay::SpiLcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_h
         ESP_LOGE(TAG, "Failed to add display");
         return;
     }
+    AccountDrawBuffers(true);
 
     if (offset_x != 0 || offset_y != 0) {
         lv_display_set_offset(display_, offset_x, offset_y);
     }
 
+    InstallMetricsHooks();
+    SetFlushAlignment(flush_config.x_align, flush_config.y_align);
     SetupUI();
+    HoldBootSplash();
 }
 
 
@@ -179,11 +346,7 @@ RgbLcdDisplay::RgbLcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_h
                            bool mirror_x, bool mirror_y, bool swap_xy)
     : LcdDisplay(panel_io, panel, width, height) {
 
-    // draw white
-    std::vector<uint16_t> buffer(width_, 0xFFFF);
-    for (int y = 0; y < height_; y++) {
-        esp_lcd_panel_draw_bitmap(panel_, 0, y, width_, y + 1, buffer.data());
-    }
+    ClearPanel(false, false);
 
     ESP_LOGI(TAG, "Initialize LVGL library");
     lv_init();
@@ -227,12 +390,15 @@ RgbLcdDisplay::RgbLcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_h
         ESP_LOGE(TAG, "Failed to add RGB display");
         return;
     }
+    AccountDrawBuffers(true);
     
     if (offset_x != 0 || offset_y != 0) {
         lv_display_set_offset(display_, offset_x, offset_y);
     }
 
+    InstallMetricsHooks();
     SetupUI();
+    HoldBootSplash();
 }
 
 MipiLcdDisplay::MipiLcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_handle_t panel,
@@ -280,11 +446,13 @@ MipiLcdDisplay::MipiLcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel
         ESP_LOGE(TAG, "Failed to add display");
         return;
     }
+    AccountDrawBuffers(true);
 
     if (offset_x != 0 || offset_y != 0) {
         lv_display_set_offset(display_, offset_x, offset_y);
     }
 
+    InstallMetricsHooks();
     SetupUI();
 }
 
@@ -301,6 +469,10 @@ LcdDisplay::~LcdDisplay() {
         esp_timer_stop(preview_timer_);
         esp_timer_delete(preview_timer_);
     }
+    if (splash_timer_ != nullptr) {
+        esp_timer_stop(splash_timer_);
+        esp_timer_delete(splash_timer_);
+    }
 
     if (preview_image_ != nullptr) {
         lv_obj_del(preview_image_);
@@ -330,6 +502,7 @@ LcdDisplay::~LcdDisplay() {
         lv_obj_del(container_);
     }
     if (display_ != nullptr) {
+        AccountDrawBuffers(false);
         lv_display_delete(display_);
     }
 
@@ -341,6 +514,47 @@ LcdDisplay::~LcdDisplay() {
     }
 }
 
+void LcdDisplay::AccountDrawBuffers(bool allocated) {
+    if (display_ == nullptr) {
+        return;
+    }
+    for (auto buffer : { display_->buf_1, display_->buf_2 }) {
+        if (buffer == nullptr || buffer->unaligned_data == nullptr) {
+            continue;
+        }
+        if (allocated) {
+            MemoryAccounting::Record(kMemoryTagDisplay, buffer->unaligned_data);
+        } else {
+            MemoryAccounting::Release(kMemoryTagDisplay, buffer->unaligned_data);
+        }
+    }
+}
+
+void LcdDisplay::SetFlushAlignment(int x_align, int y_align) {
+    flush_x_align_ = std::max(x_align, 1);
+    flush_y_align_ = std::max(y_align, 1);
+    if (flush_x_align_ == 1 && flush_y_align_ == 1) {
+        return;
+    }
+    // Round every invalidated area to the panel window alignment, so LVGL merges
+    // the dirty areas after rounding and each flush is a single aligned window
+    DisplayLockGuard lock(this);
+    lv_display_add_event_cb(display_, RounderEventCallback, LV_EVENT_INVALIDATE_AREA, this);
+}
+
+void LcdDisplay::RounderEventCallback(lv_event_t* e) {
+    auto display = static_cast<LcdDisplay*>(lv_event_get_user_data(e));
+    lv_area_t* area = static_cast<lv_area_t*>(lv_event_get_param(e));
+    int x_align = display->flush_x_align_;
+    int y_align = display->flush_y_align_;
+
+    // round the start down and the end up to the alignment
+    area->x1 = area->x1 / x_align * x_align;
+    area->y1 = area->y1 / y_align * y_align;
+    area->x2 = (area->x2 / x_align + 1) * x_align - 1;
+    area->y2 = (area->y2 / y_align + 1) * y_align - 1;
+}
+
 bool LcdDisplay::Lock(int timeout_ms) {
     return lvgl_port_lock(timeout_ms);
 }
@@ -477,6 +691,9 @@ void LcdDisplay::SetChatMessage(const char* role, const char* content) {
     if (content_ == nullptr) {
         return;
     }
+
+    // Load the glyphs into the cache before the label is laid out
+    static_cast<LvglTheme*>(current_theme_)->text_font()->Prefetch(content);
     
     // 检查消息数量是否超过限制
     uint32_t child_count = lv_obj_get_child_cnt(content_);
@@ -913,6 +1130,7 @@ void LcdDisplay::SetChatMessage(const char* role, const char* content) {
     if (chat_message_label_ == nullptr) {
         return;
     }
+    static_cast<LvglTheme*>(current_theme_)->text_font()->Prefetch(content);
     lv_label_set_text(chat_message_label_, content);
 }
 #endif
@@ -950,6 +1168,7 @@ void LcdDisplay::SetEmotion(const char* emotion) {
         if (gif_controller_->IsLoaded()) {
             // Set up frame update callback
             gif_controller_->SetFrameCallback([this]() {
+                metrics_.RecordDecodeTime(gif_controller_->last_decode_time_us());
                 lv_image_set_src(emoji_image_, gif_controller_->image_dsc());
             });
             
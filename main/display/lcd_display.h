@@ -6,13 +6,38 @@
 
 #include <esp_lcd_panel_io.h>
 #include <esp_lcd_panel_ops.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
 #include <font_emoji.h>
 
 #include <atomic>
 #include <memory>
 
 #define PREVIEW_IMAGE_DURATION_MS 5000
+// Size of the DMA buffer used to clear the panel and draw the boot splash before LVGL starts
+#define PANEL_FILL_BUFFER_SIZE (16 * 1024)
+// Raw RGB565 image in the assets partition, shown before LVGL draws its first frame
+#define BOOT_SPLASH_ASSET_NAME "splash.rgb565"
+// LVGL does not redraw the panel until the splash was shown this long
+#define BOOT_SPLASH_MIN_DURATION_MS 1500
 
+// SPI LCD flush configuration
+struct SpiLcdFlushConfig {
+    // Height of each LVGL draw buffer in lines
+    int buffer_lines = CONFIG_LCD_SPI_BUFFER_LINES;
+#if CONFIG_LCD_SPI_DOUBLE_BUFFER
+    // Render the next strip while the previous one is being sent by DMA, if internal DMA memory allows
+    bool double_buffer = true;
+#else
+    bool double_buffer = false;
+#endif
+    // Minimum window alignment required by the panel (e.g. 2 for SH8601/CO5300)
+    int x_align = 1;
+    int y_align = 1;
+    // LVGL swaps the RGB565 bytes on the CPU for the big-endian SPI panel, set to false when the panel
+    // is configured with LCD_RGB_DATA_ENDIAN_LITTLE
+    bool lvgl_swap_bytes = true;
+};
 
 class LcdDisplay : public LvglDisplay {
 protected:
@@ -32,9 +57,25 @@ protected:
     lv_obj_t* chat_message_label_ = nullptr;
     esp_timer_handle_t preview_timer_ = nullptr;
     std::unique_ptr<LvglImage> preview_image_cached_ = nullptr;
+    esp_timer_handle_t splash_timer_ = nullptr;
+    int64_t splash_time_us_ = 0;
+
+    int flush_x_align_ = 1;
+    int flush_y_align_ = 1;
 
     void InitializeLcdThemes();
     void SetupUI();
+    void SetFlushAlignment(int x_align, int y_align);
+    // The LVGL draw buffers are allocated by esp_lvgl_port, count them as display memory
+    void AccountDrawBuffers(bool allocated);
+    // Clear the panel with the theme background and draw the boot splash, before LVGL takes over the panel.
+    // With async_io the panel IO sends the bitmaps by DMA in the background, so the buffer can only be
+    // reused after the transfers are reported done.
+    void ClearPanel(bool swap_bytes, bool async_io);
+    bool DrawBootSplash(uint8_t* buffer, size_t buffer_size, SemaphoreHandle_t transfers_done);
+    // Keep LVGL from drawing over the splash until it was shown for BOOT_SPLASH_MIN_DURATION_MS
+    void HoldBootSplash();
+    static void RounderEventCallback(lv_event_t* e);
     virtual bool Lock(int timeout_ms = 0) override;
     virtual void Unlock() override;
 
@@ -58,6 +99,10 @@ public:
     SpiLcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_handle_t panel,
                   int width, int height, int offset_x, int offset_y,
                   bool mirror_x, bool mirror_y, bool swap_xy);
+    SpiLcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_handle_t panel,
+                  int width, int height, int offset_x, int offset_y,
+                  bool mirror_x, bool mirror_y, bool swap_xy,
+                  const SpiLcdFlushConfig& flush_config);
 };
 
 // RGB LCD显示器
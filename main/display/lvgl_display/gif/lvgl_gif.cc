@@ -1,5 +1,7 @@
 #include "lvgl_gif.h"
+#include "memory_accounting.h"
 #include <esp_log.h>
+#include <esp_timer.h>
 #include <cstring>
 
 #define TAG "LvglGif"
@@ -16,6 +18,8 @@ LvglGif::LvglGif(const lv_img_dsc_t* img_dsc)
         ESP_LOGE(TAG, "Failed to open GIF from image descriptor");
         return;
     }
+    // The decoder state and the canvas are one allocation
+    MemoryAccounting::Record(kMemoryTagDisplay, gif_);
 
     // Setup LVGL image descriptor
     memset(&img_dsc_, 0, sizeof(img_dsc_));
@@ -164,6 +168,7 @@ void LvglGif::NextFrame() {
     }
 
     last_call_ = lv_tick_get();
+    int64_t decode_start_us = esp_timer_get_time();
 
     // Get next frame
     int has_next = gd_get_frame(gif_);
@@ -179,6 +184,7 @@ void LvglGif::NextFrame() {
     // Render current frame
     if (gif_->canvas) {
         gd_render_frame(gif_, gif_->canvas);
+        last_decode_time_us_ = esp_timer_get_time() - decode_start_us;
         
         // Call frame callback if set
         if (frame_callback_) {
@@ -196,6 +202,7 @@ void LvglGif::Cleanup() {
 
     // Close GIF decoder
     if (gif_) {
+        MemoryAccounting::Release(kMemoryTagDisplay, gif_);
         gd_close_gif(gif_);
         gif_ = nullptr;
     }
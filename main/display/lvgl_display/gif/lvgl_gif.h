@@ -64,6 +64,11 @@ public:
     uint16_t width() const;
     uint16_t height() const;
 
+    /**
+     * Time spent decoding and rendering the last frame in microseconds
+     */
+    uint32_t last_decode_time_us() const { return last_decode_time_us_; }
+
     /**
      * Set frame update callback
      */
@@ -82,6 +87,9 @@ private:
     // Last frame update time
     uint32_t last_call_;
     
+    // Decode time of the last frame
+    uint32_t last_decode_time_us_ = 0;
+
     // Animation state
     bool playing_;
     bool loaded_;
@@ -4,6 +4,7 @@
 #include <cstdlib>
 #include <cstring>
 #include <font_awesome.h>
+#include <src/display/lv_display_private.h>
 
 #include "lvgl_display.h"
 #include "board.h"
@@ -69,6 +70,49 @@ LvglDisplay::~LvglDisplay() {
     }
 }
 
+void LvglDisplay::InstallMetricsHooks() {
+    if (display_ == nullptr) {
+        return;
+    }
+    metrics_.SetRefreshPeriod(LV_DEF_REFR_PERIOD);
+    lv_display_add_event_cb(display_, [](lv_event_t* e) {
+        auto display = static_cast<LvglDisplay*>(lv_event_get_user_data(e));
+        auto& metrics = display->metrics_;
+        switch (lv_event_get_code(e)) {
+            case LV_EVENT_REFR_START:
+                metrics.OnFrameStart();
+                break;
+            // The invalidated areas are rounded when added and joined before rendering starts,
+            // count what is actually rendered
+            case LV_EVENT_RENDER_START: {
+                auto lv_display = display->display_;
+                uint32_t pixels = 0;
+                for (uint32_t i = 0; i < lv_display->inv_p; i++) {
+                    if (!lv_display->inv_area_joined[i]) {
+                        pixels += lv_area_get_size(&lv_display->inv_areas[i]);
+                    }
+                }
+                metrics.OnRenderStart(pixels);
+                break;
+            }
+            case LV_EVENT_REFR_READY:
+                metrics.OnFrameEnd();
+                break;
+            // Waiting for the previous DMA transfer counts as flush time
+            case LV_EVENT_FLUSH_START:
+            case LV_EVENT_FLUSH_WAIT_START:
+                metrics.OnFlushStart();
+                break;
+            case LV_EVENT_FLUSH_FINISH:
+            case LV_EVENT_FLUSH_WAIT_FINISH:
+                metrics.OnFlushEnd();
+                break;
+            default:
+                break;
+        }
+    }, LV_EVENT_ALL, this);
+}
+
 void LvglDisplay::SetStatus(const char* status) {
     DisplayLockGuard lock(this);
     if (status_label_ == nullptr) {
@@ -2,6 +2,7 @@
 #define LVGL_DISPLAY_H
 
 #include "display.h"
+#include "display_metrics.h"
 #include "lvgl_image.h"
 
 #include <lvgl.h>
@@ -24,10 +25,12 @@ public:
     virtual void UpdateStatusBar(bool update_all = false);
     virtual void SetPowerSaveMode(bool on);
     virtual bool SnapshotToJpeg(std::string& jpeg_data, int quality = 80);
+    virtual DisplayMetrics* metrics() override { return &metrics_; }
 
 protected:
     esp_pm_lock_handle_t pm_lock_ = nullptr;
     lv_display_t *display_ = nullptr;
+    DisplayMetrics metrics_;
 
     lv_obj_t *network_label_ = nullptr;
     lv_obj_t *status_label_ = nullptr;
@@ -44,6 +47,9 @@ protected:
     std::chrono::system_clock::time_point last_status_update_time_;
     esp_timer_handle_t notification_timer_ = nullptr;
 
+    // Hook LVGL render and flush events of display_ into metrics_
+    void InstallMetricsHooks();
+
     friend class DisplayLockGuard;
     virtual bool Lock(int timeout_ms = 0) = 0;
     virtual void Unlock() = 0;
@@ -1,4 +1,5 @@
 #include "lvgl_font.h"
+#include "lvgl_glyph_cache.h"
 #include <cbin_font.h>
 
 
@@ -7,7 +8,22 @@ LvglCBinFont::LvglCBinFont(void* data) {
 }
 
 LvglCBinFont::~LvglCBinFont() {
+    if (cached_font_ != nullptr) {
+        LvglGlyphCache::GetInstance().DeleteCachedFont(cached_font_);
+    }
     if (font_ != nullptr) {
         cbin_font_delete(font_);
     }
-}
\ No newline at end of file
+}
+
+void LvglCBinFont::EnableGlyphCache() {
+    if (font_ != nullptr && cached_font_ == nullptr) {
+        cached_font_ = LvglGlyphCache::GetInstance().CreateCachedFont(font_);
+    }
+}
+
+void LvglCBinFont::Prefetch(const char* text) const {
+    if (cached_font_ != nullptr) {
+        LvglGlyphCache::GetInstance().Prefetch(cached_font_, text);
+    }
+}
@@ -7,6 +7,9 @@ class LvglFont {
 public:
     virtual const lv_font_t* font() const = 0;
     virtual ~LvglFont() = default;
+
+    // Warm up any glyph cache with the characters of a string before it is laid out
+    virtual void Prefetch(const char* text) const {}
 };
 
 // Built-in font
@@ -24,8 +27,13 @@ class LvglCBinFont : public LvglFont {
 public:
     LvglCBinFont(void* data);
     virtual ~LvglCBinFont();
-    virtual const lv_font_t* font() const override { return font_; }
+    virtual const lv_font_t* font() const override { return cached_font_ != nullptr ? cached_font_ : font_; }
+    virtual void Prefetch(const char* text) const override;
+
+    // Route glyph lookups through LvglGlyphCache, the font data is memory mapped from flash
+    void EnableGlyphCache();
 
 private:
     lv_font_t* font_;
+    lv_font_t* cached_font_ = nullptr;
 };
@@ -0,0 +1,251 @@
+#include "lvgl_glyph_cache.h"
+#include "memory_accounting.h"
+
+#include <esp_log.h>
+#include <esp_heap_caps.h>
+
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
+
+#define TAG "LvglGlyphCache"
+
+// Bookkeeping cost of an entry besides its bitmap
+#define GLYPH_ENTRY_OVERHEAD (sizeof(Entry) + 32)
+#define GLYPH_KEY_BITMAP_FLAG (1u << 31)
+
+
+LvglGlyphCache::LvglGlyphCache() {
+    budget_bytes_ = CONFIG_LVGL_GLYPH_CACHE_SIZE_KB * 1024;
+}
+
+LvglGlyphCache::~LvglGlyphCache() {
+    Clear();
+    if (prefetch_buf_ != nullptr) {
+        lv_draw_buf_destroy(prefetch_buf_);
+    }
+}
+
+uint64_t LvglGlyphCache::MakeKey(const lv_font_t* font, uint32_t id, bool bitmap) {
+    uint32_t low = (id & ~GLYPH_KEY_BITMAP_FLAG) | (bitmap ? GLYPH_KEY_BITMAP_FLAG : 0);
+    return (static_cast<uint64_t>(reinterpret_cast<uintptr_t>(font) & 0xFFFFFFFF) << 32) | low;
+}
+
+lv_font_t* LvglGlyphCache::CreateCachedFont(const lv_font_t* source) {
+    if (source == nullptr || budget_bytes_ == 0) {
+        return nullptr;
+    }
+    auto font = static_cast<lv_font_t*>(malloc(sizeof(lv_font_t)));
+    if (font == nullptr) {
+        return nullptr;
+    }
+    // The copy shares the glyph data of the source font, only the callbacks are replaced
+    *font = *source;
+    font->get_glyph_dsc = GetGlyphDsc;
+    font->get_glyph_bitmap = GetGlyphBitmap;
+    font->release_glyph = source->release_glyph ? ReleaseGlyph : nullptr;
+    font->user_data = const_cast<lv_font_t*>(source);
+    ESP_LOGI(TAG, "Glyph cache enabled, budget %u KB", budget_bytes_ / 1024);
+    return font;
+}
+
+void LvglGlyphCache::DeleteCachedFont(lv_font_t* font) {
+    if (font == nullptr) {
+        return;
+    }
+    EraseFont(static_cast<const lv_font_t*>(font->user_data));
+    free(font);
+}
+
+void LvglGlyphCache::SetBudget(size_t bytes) {
+    budget_bytes_ = bytes;
+    Evict(0);
+}
+
+void LvglGlyphCache::Clear() {
+    for (auto& entry : lru_) {
+        MemoryAccounting::Free(kMemoryTagFont, entry.bitmap);
+    }
+    lru_.clear();
+    entries_.clear();
+    used_bytes_ = 0;
+}
+
+LvglGlyphCache::Entry* LvglGlyphCache::Find(uint64_t key) {
+    auto it = entries_.find(key);
+    if (it == entries_.end()) {
+        misses_++;
+        return nullptr;
+    }
+    hits_++;
+    // Move to the front of the LRU list
+    lru_.splice(lru_.begin(), lru_, it->second);
+    return &*it->second;
+}
+
+LvglGlyphCache::Entry* LvglGlyphCache::Insert(uint64_t key, const lv_font_glyph_dsc_t& dsc,
+    const uint8_t* bitmap, uint32_t bitmap_size, uint32_t stride) {
+    size_t cost = GLYPH_ENTRY_OVERHEAD + bitmap_size;
+    if (cost > budget_bytes_) {
+        return nullptr;
+    }
+    Evict(cost);
+
+    uint8_t* copy = nullptr;
+    if (bitmap_size > 0) {
+        copy = static_cast<uint8_t*>(MemoryAccounting::Malloc(kMemoryTagFont, bitmap_size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT));
+        if (copy == nullptr) {
+            copy = static_cast<uint8_t*>(MemoryAccounting::Malloc(kMemoryTagFont, bitmap_size, MALLOC_CAP_8BIT));
+        }
+        if (copy == nullptr) {
+            return nullptr;
+        }
+        memcpy(copy, bitmap, bitmap_size);
+    }
+
+    lru_.push_front(Entry{key, dsc, copy, bitmap_size, stride});
+    entries_[key] = lru_.begin();
+    used_bytes_ += cost;
+    return &lru_.front();
+}
+
+void LvglGlyphCache::Evict(size_t required_bytes) {
+    while (!lru_.empty() && used_bytes_ + required_bytes > budget_bytes_) {
+        auto& entry = lru_.back();
+        used_bytes_ -= GLYPH_ENTRY_OVERHEAD + entry.bitmap_size;
+        MemoryAccounting::Free(kMemoryTagFont, entry.bitmap);
+        entries_.erase(entry.key);
+        lru_.pop_back();
+    }
+}
+
+void LvglGlyphCache::EraseFont(const lv_font_t* font) {
+    uint32_t font_bits = reinterpret_cast<uintptr_t>(font) & 0xFFFFFFFF;
+    for (auto it = lru_.begin(); it != lru_.end();) {
+        if (static_cast<uint32_t>(it->key >> 32) == font_bits) {
+            used_bytes_ -= GLYPH_ENTRY_OVERHEAD + it->bitmap_size;
+            MemoryAccounting::Free(kMemoryTagFont, it->bitmap);
+            entries_.erase(it->key);
+            it = lru_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void LvglGlyphCache::Prefetch(const lv_font_t* font, const char* text) {
+    if (font == nullptr || text == nullptr || font->get_glyph_dsc != GetGlyphDsc) {
+        return;
+    }
+    if (prefetch_buf_ == nullptr) {
+        // Large enough for any glyph of the font, reshaped for every glyph
+        int32_t size = font->line_height * 2;
+        prefetch_buf_ = lv_draw_buf_create(size, size, LV_COLOR_FORMAT_A8, LV_STRIDE_AUTO);
+        if (prefetch_buf_ == nullptr) {
+            return;
+        }
+    }
+
+    uint32_t i = 0;
+    while (text[i] != '\0') {
+        uint32_t letter = lv_text_encoded_next(text, &i);
+        if (letter == '\n' || letter == '\r' || letter == ' ') {
+            continue;
+        }
+        lv_font_glyph_dsc_t dsc = {};
+        if (!GetGlyphDsc(font, &dsc, letter, 0)) {
+            continue;
+        }
+        dsc.resolved_font = font;
+        GetGlyphBitmap(&dsc, prefetch_buf_);
+        if (font->release_glyph != nullptr) {
+            font->release_glyph(font, &dsc);
+        }
+    }
+}
+
+bool LvglGlyphCache::GetGlyphDsc(const lv_font_t* font, lv_font_glyph_dsc_t* dsc, uint32_t letter, uint32_t letter_next) {
+    auto& cache = GetInstance();
+    auto source = static_cast<const lv_font_t*>(font->user_data);
+
+    // With kerning the advance width depends on the next letter, so the metrics can not be cached
+    bool has_kerning = true;
+    if (source->get_glyph_dsc == lv_font_get_glyph_dsc_fmt_txt) {
+        auto fmt_dsc = static_cast<const lv_font_fmt_txt_dsc_t*>(source->dsc);
+        has_kerning = fmt_dsc->kern_dsc != nullptr;
+    }
+    if (has_kerning) {
+        return source->get_glyph_dsc(source, dsc, letter, letter_next);
+    }
+
+    uint64_t key = MakeKey(source, letter, false);
+    auto entry = cache.Find(key);
+    if (entry != nullptr) {
+        *dsc = entry->dsc;
+        return true;
+    }
+
+    if (!source->get_glyph_dsc(source, dsc, letter, letter_next)) {
+        return false;
+    }
+    cache.Insert(key, *dsc, nullptr, 0, 0);
+    return true;
+}
+
+const void* LvglGlyphCache::GetGlyphBitmap(lv_font_glyph_dsc_t* dsc, lv_draw_buf_t* draw_buf) {
+    auto& cache = GetInstance();
+    const lv_font_t* font = dsc->resolved_font;
+    auto source = static_cast<const lv_font_t*>(font->user_data);
+
+    // Forward to the source font with the descriptor pointing to it
+    auto forward = [dsc, draw_buf, font, source]() -> const void* {
+        dsc->resolved_font = source;
+        const void* result = source->get_glyph_bitmap(dsc, draw_buf);
+        dsc->resolved_font = font;
+        return result;
+    };
+
+    // Only plain alpha bitmaps are unpacked into the draw buffer and can be cached
+    bool cacheable = draw_buf != nullptr && (dsc->format == LV_FONT_GLYPH_FORMAT_A1 ||
+        dsc->format == LV_FONT_GLYPH_FORMAT_A2 || dsc->format == LV_FONT_GLYPH_FORMAT_A4 ||
+        dsc->format == LV_FONT_GLYPH_FORMAT_A8);
+    if (!cacheable) {
+        return forward();
+    }
+
+    if (dsc->box_w == 0 || dsc->box_h == 0) {
+        return forward();
+    }
+    // Shape the buffer to the glyph box, so the source font unpacks into it with the stride of the box.
+    // A buffer too small for the glyph is not handed to the source font at all
+    if (lv_draw_buf_reshape(draw_buf, LV_COLOR_FORMAT_A8, dsc->box_w, dsc->box_h, LV_STRIDE_AUTO) == nullptr) {
+        return nullptr;
+    }
+
+    uint64_t key = MakeKey(source, dsc->gid.index, true);
+    auto entry = cache.Find(key);
+    if (entry != nullptr && entry->bitmap_size >= entry->stride * dsc->box_h) {
+        // The entry may come from a buffer of another stride, copy it row by row
+        uint32_t stride = draw_buf->header.stride;
+        uint32_t row_bytes = std::min<uint32_t>(dsc->box_w, std::min(stride, entry->stride));
+        auto dest = static_cast<uint8_t*>(draw_buf->data);
+        for (uint32_t y = 0; y < dsc->box_h; y++) {
+            memcpy(dest + y * stride, entry->bitmap + y * entry->stride, row_bytes);
+        }
+        return draw_buf;
+    }
+
+    const void* result = forward();
+    if (result == draw_buf) {
+        uint32_t stride = draw_buf->header.stride;
+        cache.Insert(key, *dsc, draw_buf->data, stride * dsc->box_h, stride);
+    }
+    return result;
+}
+
+void LvglGlyphCache::ReleaseGlyph(const lv_font_t* font, lv_font_glyph_dsc_t* dsc) {
+    auto source = static_cast<const lv_font_t*>(font->user_data);
+    if (source->release_glyph != nullptr) {
+        source->release_glyph(source, dsc);
+    }
+}
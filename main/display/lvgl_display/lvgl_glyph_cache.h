@@ -0,0 +1,68 @@
+#pragma once
+
+#include <lvgl.h>
+
+#include <cstdint>
+#include <list>
+#include <unordered_map>
+
+
+/**
+ * LRU cache of glyph metrics and unpacked A8 bitmaps, shared by all cached fonts.
+ * Entries are keyed by (font, codepoint) for metrics and (font, glyph id) for bitmaps,
+ * and bitmaps are stored in PSRAM when available.
+ * All methods must be called with the LVGL lock held.
+ */
+class LvglGlyphCache {
+public:
+    static LvglGlyphCache& GetInstance() {
+        static LvglGlyphCache instance;
+        return instance;
+    }
+    LvglGlyphCache(const LvglGlyphCache&) = delete;
+    LvglGlyphCache& operator=(const LvglGlyphCache&) = delete;
+
+    // Create a font that forwards to `source` through the cache, the caller owns the returned font
+    lv_font_t* CreateCachedFont(const lv_font_t* source);
+    void DeleteCachedFont(lv_font_t* font);
+
+    // Load the glyphs of a UTF-8 string into the cache before layout
+    void Prefetch(const lv_font_t* font, const char* text);
+
+    void SetBudget(size_t bytes);
+    void Clear();
+
+    inline size_t used_bytes() const { return used_bytes_; }
+    inline uint32_t hits() const { return hits_; }
+    inline uint32_t misses() const { return misses_; }
+
+private:
+    LvglGlyphCache();
+    ~LvglGlyphCache();
+
+    struct Entry {
+        uint64_t key;
+        lv_font_glyph_dsc_t dsc;
+        uint8_t* bitmap = nullptr;
+        uint32_t bitmap_size = 0;
+        uint32_t stride = 0;
+    };
+
+    size_t budget_bytes_ = 0;
+    size_t used_bytes_ = 0;
+    uint32_t hits_ = 0;
+    uint32_t misses_ = 0;
+    std::list<Entry> lru_;
+    std::unordered_map<uint64_t, std::list<Entry>::iterator> entries_;
+    lv_draw_buf_t* prefetch_buf_ = nullptr;
+
+    Entry* Find(uint64_t key);
+    Entry* Insert(uint64_t key, const lv_font_glyph_dsc_t& dsc, const uint8_t* bitmap, uint32_t bitmap_size, uint32_t stride);
+    void Evict(size_t required_bytes);
+    void EraseFont(const lv_font_t* font);
+
+    static uint64_t MakeKey(const lv_font_t* font, uint32_t id, bool bitmap);
+    static bool GetGlyphDsc(const lv_font_t* font, lv_font_glyph_dsc_t* dsc, uint32_t letter, uint32_t letter_next);
+    static const void* GetGlyphBitmap(lv_font_glyph_dsc_t* dsc, lv_draw_buf_t* draw_buf);
+    static void ReleaseGlyph(const lv_font_t* font, lv_font_glyph_dsc_t* dsc);
+};
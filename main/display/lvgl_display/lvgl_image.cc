@@ -1,4 +1,5 @@
 #include "lvgl_image.h"
+#include "memory_accounting.h"
 #include <cbin_font.h>
 
 #include <esp_log.h>
@@ -43,6 +44,7 @@ LvglAllocatedImage::LvglAllocatedImage(void* data, size_t size) {
         ESP_LOGE(TAG, "Failed to get image info, data: %p size: %u", data, size);
         throw std::runtime_error("Failed to get image info");
     }
+    MemoryAccounting::Record(kMemoryTagImage, data);
 }
 
 LvglAllocatedImage::LvglAllocatedImage(void* data, size_t size, int width, int height, int stride, int color_format) {
@@ -54,10 +56,13 @@ LvglAllocatedImage::LvglAllocatedImage(void* data, size_t size, int width, int h
     image_dsc_.header.w = width;
     image_dsc_.header.h = height;
     image_dsc_.header.stride = stride;
+    // The image owns the buffer from here on
+    MemoryAccounting::Record(kMemoryTagImage, data);
 }
 
 LvglAllocatedImage::~LvglAllocatedImage() {
     if (image_dsc_.data) {
+        MemoryAccounting::Release(kMemoryTagImage, image_dsc_.data);
         heap_caps_free((void*)image_dsc_.data);
         image_dsc_.data = nullptr;
     }
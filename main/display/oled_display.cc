@@ -76,6 +76,7 @@ OledDisplay::OledDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_handl
         return;
     }
 
+    InstallMetricsHooks();
     if (height_ == 64) {
         SetupUI_128x64();
     } else {
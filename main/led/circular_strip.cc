@@ -1,10 +1,14 @@
 #include "circular_strip.h"
 #include "application.h"
 #include <esp_log.h>
+#include <algorithm>
+#include <cstdlib>
 
 #define TAG "CircularStrip"
 
 #define BLINK_INFINITE -1
+// A fade out takes as long as halving the brightness 8 times
+#define FADE_OUT_STEPS 8
 
 CircularStrip::CircularStrip(gpio_num_t gpio, uint8_t max_leds) : max_leds_(max_leds) {
     // If the gpio is not connected, you should use NoLed class
@@ -27,10 +31,7 @@ CircularStrip::CircularStrip(gpio_num_t gpio, uint8_t max_leds) : max_leds_(max_
     esp_timer_create_args_t strip_timer_args = {
         .callback = [](void *arg) {
             auto strip = static_cast<CircularStrip*>(arg);
-            std::lock_guard<std::mutex> lock(strip->mutex_);
-            if (strip->strip_callback_ != nullptr) {
-                strip->strip_callback_();
-            }
+            strip->OnAnimationTimer();
         },
         .arg = this,
         .dispatch_method = ESP_TIMER_TASK,
@@ -56,6 +57,8 @@ void CircularStrip::SetAllColor(StripColor color) {
         led_strip_set_pixel(led_strip_, i, color.red, color.green, color.blue);
     }
     led_strip_refresh(led_strip_);
+    animation_.SetLevel(255);
+    scroll_length_ = 0;
 }
 
 void CircularStrip::SetSingleColor(uint8_t index, StripColor color) {
@@ -64,116 +67,133 @@ void CircularStrip::SetSingleColor(uint8_t index, StripColor color) {
     colors_[index] = color;
     led_strip_set_pixel(led_strip_, index, color.red, color.green, color.blue);
     led_strip_refresh(led_strip_);
+    animation_.SetLevel(255);
+    scroll_length_ = 0;
 }
 
 void CircularStrip::Blink(StripColor color, int interval_ms) {
+    std::lock_guard<std::mutex> lock(mutex_);
     for (int i = 0; i < max_leds_; i++) {
         colors_[i] = color;
     }
-    StartStripTask(interval_ms, [this]() {
-        static bool on = true;
-        if (on) {
-            for (int i = 0; i < max_leds_; i++) {
-                led_strip_set_pixel(led_strip_, i, colors_[i].red, colors_[i].green, colors_[i].blue);
-            }
-            led_strip_refresh(led_strip_);
-        } else {
-            led_strip_clear(led_strip_);
-        }
-        on = !on;
-    });
+    low_color_ = {};
+    animation_.PlayBlink(interval_ms, BLINK_INFINITE);
+    scroll_length_ = 0;
+    StartAnimation();
 }
 
 void CircularStrip::FadeOut(int interval_ms) {
-    StartStripTask(interval_ms, [this]() {
-        bool all_off = true;
-        for (int i = 0; i < max_leds_; i++) {
-            colors_[i].red /= 2;
-            colors_[i].green /= 2;
-            colors_[i].blue /= 2;
-            if (colors_[i].red != 0 || colors_[i].green != 0 || colors_[i].blue != 0) {
-                all_off = false;
-            }
-            led_strip_set_pixel(led_strip_, i, colors_[i].red, colors_[i].green, colors_[i].blue);
-        }
-        if (all_off) {
-            led_strip_clear(led_strip_);
-            esp_timer_stop(strip_timer_);
-        } else {
-            led_strip_refresh(led_strip_);
-        }
-    });
+    std::lock_guard<std::mutex> lock(mutex_);
+    // Fade from the colors currently shown
+    low_color_ = {};
+    animation_.PlayFadeOut(interval_ms * FADE_OUT_STEPS);
+    scroll_length_ = 0;
+    StartAnimation();
 }
 
 void CircularStrip::Breathe(StripColor low, StripColor high, int interval_ms) {
-    StartStripTask(interval_ms, [this, low, high]() {
-        static bool increase = true;
-        static StripColor color = low;
-        if (increase) {
-            if (color.red < high.red) {
-                color.red++;
-            }
-            if (color.green < high.green) {
-                color.green++;
-            }
-            if (color.blue < high.blue) {
-                color.blue++;
-            }
-            if (color.red == high.red && color.green == high.green && color.blue == high.blue) {
-                increase = false;
-            }
-        } else {
-            if (color.red > low.red) {
-                color.red--;
-            }
-            if (color.green > low.green) {
-                color.green--;
-            }
-            if (color.blue > low.blue) {
-                color.blue--;
-            }
-            if (color.red == low.red && color.green == low.green && color.blue == low.blue) {
-                increase = true;
-            }
-        }
-        for (int i = 0; i < max_leds_; i++) {
-            led_strip_set_pixel(led_strip_, i, color.red, color.green, color.blue);
-        }
-        led_strip_refresh(led_strip_);
-    });
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (int i = 0; i < max_leds_; i++) {
+        colors_[i] = high;
+    }
+    low_color_ = low;
+    // One brightness step per interval, as far as the largest channel difference
+    int steps = std::max({std::abs(high.red - low.red), std::abs(high.green - low.green), std::abs(high.blue - low.blue), 1});
+    animation_.PlayBreathe(steps * interval_ms * 2);
+    scroll_length_ = 0;
+    StartAnimation();
 }
 
 void CircularStrip::Scroll(StripColor low, StripColor high, int length, int interval_ms) {
+    std::lock_guard<std::mutex> lock(mutex_);
     for (int i = 0; i < max_leds_; i++) {
         colors_[i] = low;
     }
-    StartStripTask(interval_ms, [this, low, high, length]() {
-        static int offset = 0;
-        for (int i = 0; i < max_leds_; i++) {
-            colors_[i] = low;
-        }
-        for (int j = 0; j < length; j++) {
-            int i = (offset + j) % max_leds_;
-            colors_[i] = high;
-        }
-        for (int i = 0; i < max_leds_; i++) {
-            led_strip_set_pixel(led_strip_, i, colors_[i].red, colors_[i].green, colors_[i].blue);
-        }
-        led_strip_refresh(led_strip_);
-        offset = (offset + 1) % max_leds_;
-    });
+    scroll_high_ = high;
+    scroll_length_ = std::max(length, 1);
+    scroll_interval_ms_ = std::max(interval_ms, 1);
+    scroll_start_us_ = esp_timer_get_time();
+    last_offset_ = -1;
+    animation_.SetLevel(255);
+    StartAnimation();
+}
+
+void CircularStrip::AudioReactive(StripColor color) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (int i = 0; i < max_leds_; i++) {
+        colors_[i] = color;
+    }
+    low_color_ = {};
+    animation_.PlayAudioReactive();
+    scroll_length_ = 0;
+    StartAnimation();
 }
 
-void CircularStrip::StartStripTask(int interval_ms, std::function<void()> cb) {
+void CircularStrip::StartAnimation() {
     if (led_strip_ == nullptr) {
         return;
     }
+    esp_timer_stop(strip_timer_);
+    last_level_ = -1;
+    esp_timer_start_periodic(strip_timer_, LED_ANIMATION_FRAME_MS * 1000);
+}
 
+void CircularStrip::OnAnimationTimer() {
     std::lock_guard<std::mutex> lock(mutex_);
-    esp_timer_stop(strip_timer_);
-    
-    strip_callback_ = cb;
-    esp_timer_start_periodic(strip_timer_, interval_ms * 1000);
+    int64_t now = esp_timer_get_time();
+    if (scroll_length_ > 0) {
+        int offset = (now - scroll_start_us_) / 1000 / scroll_interval_ms_ % max_leds_;
+        if (offset != last_offset_) {
+            last_offset_ = offset;
+            RenderScroll(offset);
+        }
+        return;
+    }
+
+    if (animation_.IsAudioReactive()) {
+        animation_.SetAudioLevel(Application::GetInstance().GetAudioService().GetOutputLevel());
+    }
+    uint8_t level = animation_.Update(now);
+    // Only refresh the strip when the output changes
+    if (level != last_level_) {
+        last_level_ = level;
+        Render(level);
+    }
+    if (!animation_.IsAnimating()) {
+        esp_timer_stop(strip_timer_);
+        if (level == 0) {
+            // Faded out, a later fade must not show the old colors again
+            std::fill(colors_.begin(), colors_.end(), low_color_);
+        }
+    }
+}
+
+void CircularStrip::Render(uint8_t level) {
+    if (level == 0 && low_color_.red == 0 && low_color_.green == 0 && low_color_.blue == 0) {
+        led_strip_clear(led_strip_);
+        return;
+    }
+    for (int i = 0; i < max_leds_; i++) {
+        led_strip_set_pixel(led_strip_, i,
+            LedAnimation::Scale(low_color_.red, colors_[i].red, level),
+            LedAnimation::Scale(low_color_.green, colors_[i].green, level),
+            LedAnimation::Scale(low_color_.blue, colors_[i].blue, level));
+    }
+    led_strip_refresh(led_strip_);
+}
+
+void CircularStrip::RenderScroll(int offset) {
+    for (int i = 0; i < max_leds_; i++) {
+        auto color = colors_[i];
+        for (int j = 0; j < scroll_length_; j++) {
+            if ((offset + j) % max_leds_ == i) {
+                color = scroll_high_;
+                break;
+            }
+        }
+        led_strip_set_pixel(led_strip_, i, color.red, color.green, color.blue);
+    }
+    led_strip_refresh(led_strip_);
 }
 
 void CircularStrip::SetBrightness(uint8_t default_brightness, uint8_t low_brightness) {
@@ -213,7 +233,7 @@ void CircularStrip::OnStateChanged() {
         }
         case kDeviceStateSpeaking: {
             StripColor color = { low_brightness_, default_brightness_, low_brightness_ };
-            SetAllColor(color);
+            AudioReactive(color);
             break;
         }
         case kDeviceStateUpgrading: {
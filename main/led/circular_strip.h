@@ -2,6 +2,7 @@
 #define _CIRCULAR_STRIP_H_
 
 #include "led.h"
+#include "led_animation.h"
 #include <driver/gpio.h>
 #include <led_strip.h>
 #include <esp_timer.h>
@@ -28,23 +29,35 @@ public:
     void Blink(StripColor color, int interval_ms);
     void Breathe(StripColor low, StripColor high, int interval_ms);
     void Scroll(StripColor low, StripColor high, int length, int interval_ms);
+    // Brightness follows the playback level
+    void AudioReactive(StripColor color);
 
 private:
     std::mutex mutex_;
-    TaskHandle_t blink_task_ = nullptr;
     led_strip_handle_t led_strip_ = nullptr;
     int max_leds_ = 0;
+    // Pixels are rendered between the low color and their own color by the animation level
     std::vector<StripColor> colors_;
-    int blink_counter_ = 0;
-    int blink_interval_ms_ = 0;
+    StripColor low_color_;
     esp_timer_handle_t strip_timer_ = nullptr;
-    std::function<void()> strip_callback_ = nullptr;
+    LedAnimation animation_;
+    int last_level_ = -1;
+
+    // Scrolling moves `scroll_length_` pixels of `scroll_high_` one step per interval
+    int scroll_length_ = 0;
+    int scroll_interval_ms_ = 0;
+    int64_t scroll_start_us_ = 0;
+    int last_offset_ = -1;
+    StripColor scroll_high_;
 
     uint8_t default_brightness_ = DEFAULT_BRIGHTNESS;
     uint8_t low_brightness_ = LOW_BRIGHTNESS;
 
-    void StartStripTask(int interval_ms, std::function<void()> cb);
-    void Rainbow(StripColor low, StripColor high, int interval_ms);
+    // Called with mutex_ held
+    void StartAnimation();
+    void OnAnimationTimer();
+    void Render(uint8_t level);
+    void RenderScroll(int offset);
     void FadeOut(int interval_ms);
 };
 
@@ -73,7 +73,7 @@ GpioLed::GpioLed(gpio_num_t gpio, int output_invert, ledc_timer_t timer_num, led
     esp_timer_create_args_t blink_timer_args = {
         .callback = [](void *arg) {
             auto led = static_cast<GpioLed*>(arg);
-            led->OnBlinkTimer();
+            led->OnAnimationTimer();
         },
         .arg = this,
         .dispatch_method = ESP_TIMER_TASK,
@@ -131,40 +131,51 @@ void GpioLed::BlinkOnce() {
 }
 
 void GpioLed::Blink(int times, int interval_ms) {
-    StartBlinkTask(times, interval_ms);
+    if (!ledc_initialized_) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    animation_.PlayBlink(interval_ms, times);
+    StartAnimation();
 }
 
 void GpioLed::StartContinuousBlink(int interval_ms) {
-    StartBlinkTask(BLINK_INFINITE, interval_ms);
+    Blink(BLINK_INFINITE, interval_ms);
 }
 
-void GpioLed::StartBlinkTask(int times, int interval_ms) {
+void GpioLed::StartAudioReactive() {
     if (!ledc_initialized_) {
         return;
     }
 
     std::lock_guard<std::mutex> lock(mutex_);
+    animation_.PlayAudioReactive();
+    StartAnimation();
+}
+
+void GpioLed::StartAnimation() {
     esp_timer_stop(blink_timer_);
     ledc_fade_stop(ledc_channel_.speed_mode, ledc_channel_.channel);
-
-    blink_counter_ = times * 2;
-    blink_interval_ms_ = interval_ms;
-    esp_timer_start_periodic(blink_timer_, interval_ms * 1000);
+    last_level_ = -1;
+    esp_timer_start_periodic(blink_timer_, LED_ANIMATION_FRAME_MS * 1000);
 }
 
-void GpioLed::OnBlinkTimer() {
+void GpioLed::OnAnimationTimer() {
     std::lock_guard<std::mutex> lock(mutex_);
-    blink_counter_--;
-    if (blink_counter_ & 1) {
-        ledc_set_duty(ledc_channel_.speed_mode, ledc_channel_.channel, duty_);
-    } else {
-        ledc_set_duty(ledc_channel_.speed_mode, ledc_channel_.channel, 0);
-
-        if (blink_counter_ == 0) {
-            esp_timer_stop(blink_timer_);
-        }
+    if (animation_.IsAudioReactive()) {
+        animation_.SetAudioLevel(Application::GetInstance().GetAudioService().GetOutputLevel());
+    }
+    uint8_t level = animation_.Update(esp_timer_get_time());
+    // Only update the duty when the output changes
+    if (level != last_level_) {
+        last_level_ = level;
+        ledc_set_duty(ledc_channel_.speed_mode, ledc_channel_.channel, duty_ * level / 255);
+        ledc_update_duty(ledc_channel_.speed_mode, ledc_channel_.channel);
+    }
+    if (!animation_.IsAnimating()) {
+        esp_timer_stop(blink_timer_);
     }
-    ledc_update_duty(ledc_channel_.speed_mode, ledc_channel_.channel);
 }
 
 void GpioLed::StartFadeTask() {
@@ -232,7 +243,7 @@ void GpioLed::OnStateChanged() {
             break;
         case kDeviceStateSpeaking:
             SetBrightness(SPEAKING_BRIGHTNESS);
-            TurnOn();
+            StartAudioReactive();
             break;
         case kDeviceStateUpgrading:
             SetBrightness(UPGRADING_BRIGHTNESS);
@@ -4,6 +4,7 @@
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
 #include "led.h"
+#include "led_animation.h"
 #include <driver/gpio.h>
 #include <driver/ledc.h>
 #include <esp_timer.h>
@@ -28,17 +29,18 @@ class GpioLed : public Led {
     ledc_channel_config_t ledc_channel_ = {0};
     bool ledc_initialized_ = false;
     uint32_t duty_ = 0;
-    int blink_counter_ = 0;
-    int blink_interval_ms_ = 0;
     esp_timer_handle_t blink_timer_ = nullptr;
+    LedAnimation animation_;
+    int last_level_ = -1;
     bool fade_up_ = true;
 
-    void StartBlinkTask(int times, int interval_ms);
-    void OnBlinkTimer();
+    void StartAnimation();
+    void OnAnimationTimer();
 
     void BlinkOnce();
     void Blink(int times, int interval_ms);
     void StartContinuousBlink(int interval_ms);
+    void StartAudioReactive();
     void StartFadeTask();
     void OnFadeEnd();
     static bool IRAM_ATTR FadeCallback(const ledc_cb_param_t *param, void *user_arg);
@@ -0,0 +1,116 @@
+#include "led_animation.h"
+
+#include <array>
+#include <cmath>
+#include <algorithm>
+
+#define LED_GAMMA 2.2f
+// Audio-reactive levels fall by full scale in this time, the output never goes below the minimum
+#define AUDIO_RELEASE_MS 300
+#define AUDIO_MIN_LEVEL 48
+
+
+uint8_t LedAnimation::Gamma(uint8_t level) {
+    static const std::array<uint8_t, 256> table = []() {
+        std::array<uint8_t, 256> t;
+        for (int i = 0; i < 256; i++) {
+            t[i] = std::lround(std::pow(i / 255.0f, LED_GAMMA) * 255.0f);
+        }
+        return t;
+    }();
+    return table[level];
+}
+
+void LedAnimation::SetLevel(uint8_t level) {
+    keyframes_.clear();
+    audio_reactive_ = false;
+    animating_ = false;
+    level_ = level;
+}
+
+void LedAnimation::Play(std::vector<LedKeyframe> keyframes, bool loop) {
+    keyframes_ = std::move(keyframes);
+    loop_ = loop && keyframes_.size() > 1 && keyframes_.back().time_ms > 0;
+    audio_reactive_ = false;
+    animating_ = !keyframes_.empty();
+    start_time_us_ = -1;
+    segment_ = 0;
+}
+
+void LedAnimation::PlayBlink(int interval_ms, int times) {
+    std::vector<LedKeyframe> keyframes;
+    int count = times > 0 ? times : 1;
+    for (int i = 0; i < count; i++) {
+        int start = i * interval_ms * 2;
+        keyframes.push_back({start, 255});
+        keyframes.push_back({start + interval_ms, 255});
+        keyframes.push_back({start + interval_ms, 0});
+        keyframes.push_back({start + interval_ms * 2, 0});
+    }
+    Play(std::move(keyframes), times <= 0);
+}
+
+void LedAnimation::PlayBreathe(int period_ms) {
+    Play({{0, 0}, {period_ms / 2, 255}, {period_ms, 0}}, true);
+}
+
+void LedAnimation::PlayFadeOut(int duration_ms) {
+    Play({{0, 255}, {duration_ms, 0}}, false);
+}
+
+void LedAnimation::PlayAudioReactive() {
+    keyframes_.clear();
+    audio_reactive_ = true;
+    animating_ = true;
+    start_time_us_ = -1;
+    smoothed_audio_level_ = 0;
+}
+
+uint8_t LedAnimation::Interpolate(int time_ms) {
+    // The time only moves forward within a cycle, so the search continues from the last segment
+    if (segment_ >= keyframes_.size() || keyframes_[segment_].time_ms > time_ms) {
+        segment_ = 0;
+    }
+    while (segment_ + 1 < keyframes_.size() && keyframes_[segment_ + 1].time_ms <= time_ms) {
+        segment_++;
+    }
+    auto& a = keyframes_[segment_];
+    if (segment_ + 1 >= keyframes_.size()) {
+        return a.level;
+    }
+    auto& b = keyframes_[segment_ + 1];
+    return a.level + (int(b.level) - int(a.level)) * (time_ms - a.time_ms) / (b.time_ms - a.time_ms);
+}
+
+uint8_t LedAnimation::Update(int64_t now_us) {
+    if (start_time_us_ < 0) {
+        start_time_us_ = now_us;
+        last_time_us_ = now_us;
+    }
+
+    if (audio_reactive_) {
+        int elapsed_ms = (now_us - last_time_us_) / 1000;
+        int target = audio_level_;
+        if (target >= smoothed_audio_level_) {
+            smoothed_audio_level_ = target;
+        } else {
+            smoothed_audio_level_ = std::max(target, smoothed_audio_level_ - elapsed_ms * 255 / AUDIO_RELEASE_MS);
+        }
+        level_ = smoothed_audio_level_;
+        last_time_us_ = now_us;
+        // Keep the led visibly on between words
+        return AUDIO_MIN_LEVEL + Gamma(level_) * (255 - AUDIO_MIN_LEVEL) / 255;
+    } else if (animating_) {
+        int64_t time_ms = (now_us - start_time_us_) / 1000;
+        int duration_ms = keyframes_.back().time_ms;
+        if (loop_) {
+            time_ms %= duration_ms;
+        } else if (time_ms >= duration_ms) {
+            time_ms = duration_ms;
+            animating_ = false;
+        }
+        level_ = Interpolate(time_ms);
+    }
+    last_time_us_ = now_us;
+    return Gamma(level_);
+}
@@ -0,0 +1,58 @@
+#ifndef _LED_ANIMATION_H_
+#define _LED_ANIMATION_H_
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+// Animation frame period of the LED timers
+#define LED_ANIMATION_FRAME_MS 20
+
+struct LedKeyframe {
+    int time_ms;
+    uint8_t level;
+};
+
+/*
+ * Per-instance brightness animation shared by the LED drivers.
+ * Levels are interpolated linearly between keyframes by elapsed time, then gamma corrected through a
+ * lookup table, so the speed does not depend on the timer rate. Two keyframes at the same time make a step.
+ * In audio-reactive mode the level follows the playback level with a fast attack and a slow release.
+ */
+class LedAnimation {
+public:
+    void SetLevel(uint8_t level);
+    void Play(std::vector<LedKeyframe> keyframes, bool loop);
+    void PlayBlink(int interval_ms, int times);
+    void PlayBreathe(int period_ms);
+    void PlayFadeOut(int duration_ms);
+    void PlayAudioReactive();
+    void SetAudioLevel(uint8_t level) { audio_level_ = level; }
+
+    // Gamma corrected level at `now_us`
+    uint8_t Update(int64_t now_us);
+    // False once a one-shot animation ended or the level is constant, the timer can stop
+    bool IsAnimating() const { return animating_; }
+    bool IsAudioReactive() const { return audio_reactive_; }
+
+    static uint8_t Gamma(uint8_t level);
+    static uint8_t Scale(uint8_t low, uint8_t high, uint8_t level) {
+        return low + ((int(high) - int(low)) * level + 127) / 255;
+    }
+
+private:
+    std::vector<LedKeyframe> keyframes_;
+    bool loop_ = false;
+    bool animating_ = false;
+    bool audio_reactive_ = false;
+    int64_t start_time_us_ = -1;
+    int64_t last_time_us_ = 0;
+    size_t segment_ = 0;
+    uint8_t level_ = 0;
+    uint8_t audio_level_ = 0;
+    int smoothed_audio_level_ = 0;
+
+    uint8_t Interpolate(int time_ms);
+};
+
+#endif // _LED_ANIMATION_H_
@@ -30,7 +30,7 @@ SingleLed::SingleLed(gpio_num_t gpio) {
     esp_timer_create_args_t blink_timer_args = {
         .callback = [](void *arg) {
             auto led = static_cast<SingleLed*>(arg);
-            led->OnBlinkTimer();
+            led->OnAnimationTimer();
         },
         .arg = this,
         .dispatch_method = ESP_TIMER_TASK,
@@ -49,6 +49,7 @@ SingleLed::~SingleLed() {
 
 
 void SingleLed::SetColor(uint8_t r, uint8_t g, uint8_t b) {
+    std::lock_guard<std::mutex> lock(mutex_);
     r_ = r;
     g_ = g;
     b_ = b;
@@ -61,8 +62,9 @@ void SingleLed::TurnOn() {
     
     std::lock_guard<std::mutex> lock(mutex_);
     esp_timer_stop(blink_timer_);
-    led_strip_set_pixel(led_strip_, 0, r_, g_, b_);
-    led_strip_refresh(led_strip_);
+    animation_.SetLevel(255);
+    last_level_ = 255;
+    Render(255);
 }
 
 void SingleLed::TurnOff() {
@@ -72,7 +74,9 @@ void SingleLed::TurnOff() {
 
     std::lock_guard<std::mutex> lock(mutex_);
     esp_timer_stop(blink_timer_);
-    led_strip_clear(led_strip_);
+    animation_.SetLevel(0);
+    last_level_ = 0;
+    Render(0);
 }
 
 void SingleLed::BlinkOnce() {
@@ -80,39 +84,54 @@ void SingleLed::BlinkOnce() {
 }
 
 void SingleLed::Blink(int times, int interval_ms) {
-    StartBlinkTask(times, interval_ms);
+    std::lock_guard<std::mutex> lock(mutex_);
+    animation_.PlayBlink(interval_ms, times);
+    StartAnimation();
 }
 
 void SingleLed::StartContinuousBlink(int interval_ms) {
-    StartBlinkTask(BLINK_INFINITE, interval_ms);
+    Blink(BLINK_INFINITE, interval_ms);
+}
+
+void SingleLed::StartAudioReactive() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    animation_.PlayAudioReactive();
+    StartAnimation();
 }
 
-void SingleLed::StartBlinkTask(int times, int interval_ms) {
+void SingleLed::StartAnimation() {
     if (led_strip_ == nullptr) {
         return;
     }
-
-    std::lock_guard<std::mutex> lock(mutex_);
     esp_timer_stop(blink_timer_);
-    
-    blink_counter_ = times * 2;
-    blink_interval_ms_ = interval_ms;
-    esp_timer_start_periodic(blink_timer_, interval_ms * 1000);
+    last_level_ = -1;
+    esp_timer_start_periodic(blink_timer_, LED_ANIMATION_FRAME_MS * 1000);
 }
 
-void SingleLed::OnBlinkTimer() {
+void SingleLed::OnAnimationTimer() {
     std::lock_guard<std::mutex> lock(mutex_);
-    blink_counter_--;
-    if (blink_counter_ & 1) {
-        led_strip_set_pixel(led_strip_, 0, r_, g_, b_);
-        led_strip_refresh(led_strip_);
-    } else {
-        led_strip_clear(led_strip_);
+    if (animation_.IsAudioReactive()) {
+        animation_.SetAudioLevel(Application::GetInstance().GetAudioService().GetOutputLevel());
+    }
+    uint8_t level = animation_.Update(esp_timer_get_time());
+    // Only refresh the led when the output changes
+    if (level != last_level_) {
+        last_level_ = level;
+        Render(level);
+    }
+    if (!animation_.IsAnimating()) {
+        esp_timer_stop(blink_timer_);
+    }
+}
 
-        if (blink_counter_ == 0) {
-            esp_timer_stop(blink_timer_);
-        }
+void SingleLed::Render(uint8_t level) {
+    if (level == 0) {
+        led_strip_clear(led_strip_);
+        return;
     }
+    led_strip_set_pixel(led_strip_, 0, LedAnimation::Scale(0, r_, level), LedAnimation::Scale(0, g_, level),
+        LedAnimation::Scale(0, b_, level));
+    led_strip_refresh(led_strip_);
 }
 
 
@@ -145,8 +164,8 @@ void SingleLed::OnStateChanged() {
             TurnOn();
             break;
         case kDeviceStateSpeaking:
-            SetColor(0, DEFAULT_BRIGHTNESS, 0);
-            TurnOn();
+            SetColor(0, HIGH_BRIGHTNESS, 0);
+            StartAudioReactive();
             break;
         case kDeviceStateUpgrading:
             SetColor(0, DEFAULT_BRIGHTNESS, 0);
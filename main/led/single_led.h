@@ -2,6 +2,7 @@
 #define _SINGLE_LED_H_
 
 #include "led.h"
+#include "led_animation.h"
 #include <driver/gpio.h>
 #include <led_strip.h>
 #include <esp_timer.h>
@@ -17,19 +18,20 @@ public:
 
 private:
     std::mutex mutex_;
-    TaskHandle_t blink_task_ = nullptr;
     led_strip_handle_t led_strip_ = nullptr;
     uint8_t r_ = 0, g_ = 0, b_ = 0;
-    int blink_counter_ = 0;
-    int blink_interval_ms_ = 0;
     esp_timer_handle_t blink_timer_ = nullptr;
+    LedAnimation animation_;
+    int last_level_ = -1;
 
-    void StartBlinkTask(int times, int interval_ms);
-    void OnBlinkTimer();
+    void StartAnimation();
+    void OnAnimationTimer();
+    void Render(uint8_t level);
 
     void BlinkOnce();
     void Blink(int times, int interval_ms);
     void StartContinuousBlink(int interval_ms);
+    void StartAudioReactive();
     void TurnOn();
     void TurnOff();
     void SetColor(uint8_t r, uint8_t g, uint8_t b);
@@ -12,11 +12,14 @@
 
 #include "application.h"
 #include "display.h"
+#include "display_metrics.h"
 #include "oled_display.h"
 #include "board.h"
 #include "settings.h"
 #include "lvgl_theme.h"
 #include "lvgl_display.h"
+#include "memory_accounting.h"
+#include "cpu_profiler.h"
 
 #define TAG "MCP"
 
@@ -135,6 +138,42 @@ void McpServer::AddUserOnlyTools() {
             return board.GetSystemInfoJson();
         });
 
+    AddUserOnlyTool("self.get_memory_stats",
+        "Get the heap memory used by each subsystem in internal RAM and PSRAM, the allocation rate and the heap fragmentation",
+        PropertyList(),
+        [](const PropertyList& properties) -> ReturnValue {
+            return MemoryAccounting::ToJson();
+        });
+
+#if CONFIG_USE_CPU_PROFILER
+    AddUserOnlyTool("self.get_cpu_usage",
+        "Get the current, average and peak CPU usage, the minimum free stack and the missed frame deadlines of each task",
+        PropertyList(),
+        [](const PropertyList& properties) -> ReturnValue {
+            return CpuProfiler::GetInstance().ToJson();
+        });
+#endif
+
+    AddUserOnlyTool("self.wake_word.set_engine",
+        "Switch the wake word engine without rebooting: `wakenet` detects the built-in wake words, `multinet` the "
+        "command words configured in the assets. Only engines whose models are in the assets can be used.",
+        PropertyList({
+            Property("engine", kPropertyTypeString)
+        }),
+        [](const PropertyList& properties) -> ReturnValue {
+            auto engine = properties["engine"].value<std::string>();
+            auto& audio_service = Application::GetInstance().GetAudioService();
+            auto engines = audio_service.GetWakeWordEngines();
+            if (std::find(engines.begin(), engines.end(), engine) == engines.end()) {
+                throw std::runtime_error("Wake word engine not available: " + engine);
+            }
+            // Tools are called from the main loop, the reply waits for the models to load
+            if (!audio_service.SetWakeWordEngine(engine)) {
+                throw std::runtime_error("Failed to start wake word engine: " + engine);
+            }
+            return true;
+        });
+
     AddUserOnlyTool("self.reboot", "Reboot the system",
         PropertyList(),
         [this](const PropertyList& properties) -> ReturnValue {
@@ -170,6 +209,23 @@ void McpServer::AddUserOnlyTools() {
             return true;
         });
 
+    // Display metrics
+    auto metrics_display = Board::GetInstance().GetDisplay();
+    if (metrics_display && metrics_display->metrics()) {
+        AddUserOnlyTool("self.display.get_metrics", "Get the display render time, flush time, dirty area and dropped frame statistics",
+            PropertyList({
+                Property("reset", kPropertyTypeBoolean, false)
+            }),
+            [metrics_display](const PropertyList& properties) -> ReturnValue {
+                auto metrics = metrics_display->metrics();
+                auto json = metrics->ToJson();
+                if (properties["reset"].value<bool>()) {
+                    metrics->Reset();
+                }
+                return json;
+            });
+    }
+
     // Display control
 #ifdef HAVE_LVGL
     auto display = dynamic_cast<LvglDisplay*>(Board::GetInstance().GetDisplay());
@@ -0,0 +1,134 @@
+#include "memory_accounting.h"
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <esp_heap_caps.h>
+#include <esp_memory_utils.h>
+#include <atomic>
+#include <string>
+
+#define TAG "MemoryAccounting"
+
+namespace {
+
+struct RegionCounters {
+    std::atomic<uint32_t> current = 0;
+    std::atomic<uint32_t> peak = 0;
+};
+
+struct TagCounters {
+    RegionCounters internal;
+    RegionCounters psram;
+    std::atomic<uint32_t> allocations = 0;
+    // Allocation count at the previous report, for the rate
+    uint32_t reported_allocations = 0;
+};
+
+const char* const kTagNames[kMemoryTagCount] = { "audio", "opus", "display", "font", "image" };
+TagCounters counters[kMemoryTagCount];
+int64_t last_report_time_us = 0;
+
+RegionCounters& GetRegion(MemoryTag tag, const void* ptr) {
+    return esp_ptr_external_ram(ptr) ? counters[tag].psram : counters[tag].internal;
+}
+
+cJSON* RegionToJson(const RegionCounters& region) {
+    cJSON* json = cJSON_CreateObject();
+    cJSON_AddNumberToObject(json, "current", region.current);
+    cJSON_AddNumberToObject(json, "peak", region.peak);
+    return json;
+}
+
+cJSON* HeapToJson(uint32_t caps) {
+    size_t free_size = heap_caps_get_free_size(caps);
+    size_t largest_block = heap_caps_get_largest_free_block(caps);
+    cJSON* json = cJSON_CreateObject();
+    cJSON_AddNumberToObject(json, "free", free_size);
+    cJSON_AddNumberToObject(json, "minimum_free", heap_caps_get_minimum_free_size(caps));
+    cJSON_AddNumberToObject(json, "largest_free_block", largest_block);
+    // Share of the free memory not usable by the largest allocation
+    cJSON_AddNumberToObject(json, "fragmentation", free_size > 0 ? 100 - largest_block * 100 / free_size : 0);
+    return json;
+}
+
+} // namespace
+
+void* MemoryAccounting::Malloc(MemoryTag tag, size_t size, uint32_t caps) {
+    void* ptr = heap_caps_malloc(size, caps);
+    if (ptr != nullptr) {
+        Record(tag, ptr);
+    }
+    return ptr;
+}
+
+void MemoryAccounting::Free(MemoryTag tag, void* ptr) {
+    if (ptr != nullptr) {
+        Release(tag, ptr);
+        heap_caps_free(ptr);
+    }
+}
+
+void MemoryAccounting::Record(MemoryTag tag, const void* ptr) {
+    if (ptr == nullptr) {
+        return;
+    }
+    auto& region = GetRegion(tag, ptr);
+    uint32_t size = heap_caps_get_allocated_size(const_cast<void*>(ptr));
+    uint32_t current = region.current.fetch_add(size) + size;
+    uint32_t peak = region.peak;
+    while (current > peak && !region.peak.compare_exchange_weak(peak, current)) {
+    }
+    counters[tag].allocations++;
+}
+
+void MemoryAccounting::Release(MemoryTag tag, const void* ptr) {
+    if (ptr == nullptr) {
+        return;
+    }
+    GetRegion(tag, ptr).current -= heap_caps_get_allocated_size(const_cast<void*>(ptr));
+}
+
+cJSON* MemoryAccounting::ToJson() {
+    int64_t now = esp_timer_get_time();
+    int64_t elapsed_ms = last_report_time_us > 0 ? (now - last_report_time_us) / 1000 : 0;
+    last_report_time_us = now;
+
+    cJSON* json = cJSON_CreateObject();
+    cJSON* subsystems = cJSON_CreateObject();
+    for (int i = 0; i < kMemoryTagCount; i++) {
+        auto& tag = counters[i];
+        uint32_t allocations = tag.allocations;
+        cJSON* item = cJSON_CreateObject();
+        cJSON_AddItemToObject(item, "internal", RegionToJson(tag.internal));
+        cJSON_AddItemToObject(item, "psram", RegionToJson(tag.psram));
+        cJSON_AddNumberToObject(item, "allocations", allocations);
+        if (elapsed_ms > 0) {
+            cJSON_AddNumberToObject(item, "allocations_per_minute",
+                (allocations - tag.reported_allocations) * 60000.0 / elapsed_ms);
+        }
+        tag.reported_allocations = allocations;
+        cJSON_AddItemToObject(subsystems, kTagNames[i], item);
+    }
+    cJSON_AddItemToObject(json, "subsystems", subsystems);
+    cJSON_AddItemToObject(json, "internal", HeapToJson(MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT));
+    if (heap_caps_get_total_size(MALLOC_CAP_SPIRAM) > 0) {
+        cJSON_AddItemToObject(json, "psram", HeapToJson(MALLOC_CAP_SPIRAM));
+    }
+    return json;
+}
+
+void MemoryAccounting::PrintStats() {
+    // One line of current internal/PSRAM bytes per subsystem
+    std::string line;
+    for (int i = 0; i < kMemoryTagCount; i++) {
+        uint32_t internal = counters[i].internal.current;
+        uint32_t psram = counters[i].psram.current;
+        if (internal == 0 && psram == 0) {
+            continue;
+        }
+        line += std::string(kTagNames[i]) + " " + std::to_string(internal) + "/" + std::to_string(psram) + " ";
+    }
+    if (!line.empty()) {
+        ESP_LOGI(TAG, "internal/psram: %s", line.c_str());
+    }
+}
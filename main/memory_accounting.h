@@ -0,0 +1,34 @@
+#ifndef _MEMORY_ACCOUNTING_H_
+#define _MEMORY_ACCOUNTING_H_
+
+#include <cJSON.h>
+#include <cstddef>
+#include <cstdint>
+
+enum MemoryTag {
+    kMemoryTagAudio,
+    kMemoryTagOpus,
+    kMemoryTagDisplay,
+    kMemoryTagFont,
+    kMemoryTagImage,
+    kMemoryTagCount,
+};
+
+/*
+ * Counts the heap memory owned by each subsystem, split between internal RAM and PSRAM.
+ * Malloc / Free replace heap_caps_malloc / heap_caps_free, Record / Release account memory allocated
+ * elsewhere (by a library, or handed over by another subsystem) and must be balanced before it is freed.
+ */
+class MemoryAccounting {
+public:
+    static void* Malloc(MemoryTag tag, size_t size, uint32_t caps);
+    static void Free(MemoryTag tag, void* ptr);
+    static void Record(MemoryTag tag, const void* ptr);
+    static void Release(MemoryTag tag, const void* ptr);
+
+    // Per-subsystem usage, allocation rate since the previous call and heap fragmentation
+    static cJSON* ToJson();
+    static void PrintStats();
+};
+
+#endif // _MEMORY_ACCOUNTING_H_
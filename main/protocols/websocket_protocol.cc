@@ -14,12 +14,50 @@
 
 WebsocketProtocol::WebsocketProtocol() {
     event_group_handle_ = xEventGroupCreate();
+#if CONFIG_WEBSOCKET_STANDBY_TIMEOUT_SECONDS > 0
+    esp_timer_create_args_t standby_timer_args = {
+        .callback = [](void* arg) {
+            // Closing a TLS connection takes a while, do not hold up the other timers
+            auto protocol = static_cast<WebsocketProtocol*>(arg);
+            Application::GetInstance().Schedule([protocol]() {
+                protocol->CloseStandbyWebSocket();
+            });
+        },
+        .arg = this,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "ws_standby",
+        .skip_unhandled_events = true,
+    };
+    esp_timer_create(&standby_timer_args, &standby_timer_);
+#endif
 }
 
 WebsocketProtocol::~WebsocketProtocol() {
+    std::unique_ptr<WebSocket> standby;
+    {
+        // Wait for the prewarm task, it references this object and starts the timer
+        std::unique_lock<std::mutex> lock(standby_mutex_);
+        standby_cv_.wait(lock, [this]() { return !prewarm_running_; });
+        standby = std::move(standby_websocket_);
+    }
+    if (standby_timer_ != nullptr) {
+        esp_timer_stop(standby_timer_);
+        esp_timer_delete(standby_timer_);
+    }
+    standby.reset();
+    SetWebSocket(nullptr);
     vEventGroupDelete(event_group_handle_);
 }
 
+void WebsocketProtocol::SetWebSocket(std::unique_ptr<WebSocket> websocket) {
+    // Closing may call OnDisconnected, which takes the lock
+    {
+        std::lock_guard<std::mutex> lock(standby_mutex_);
+        websocket_.swap(websocket);
+    }
+    websocket.reset();
+}
+
 bool WebsocketProtocol::Start() {
     // Only connect to server when audio channel is needed
     return true;
@@ -76,25 +114,97 @@ bool WebsocketProtocol::IsAudioChannelOpened() const {
 }
 
 void WebsocketProtocol::CloseAudioChannel() {
-    websocket_.reset();
+    SetWebSocket(nullptr);
 }
 
-bool WebsocketProtocol::OpenAudioChannel() {
-    Settings settings("websocket", false);
-    std::string url = settings.GetString("url");
-    std::string token = settings.GetString("token");
-    int version = settings.GetInt("version");
-    if (version != 0) {
-        version_ = version;
+void WebsocketProtocol::Prewarm() {
+#if CONFIG_WEBSOCKET_STANDBY_TIMEOUT_SECONDS > 0
+    if (IsAudioChannelOpened()) {
+        return;
     }
+    int version = Settings("websocket", false).GetInt("version");
+    {
+        std::lock_guard<std::mutex> lock(standby_mutex_);
+        if (prewarm_running_ || (standby_websocket_ != nullptr && standby_websocket_->IsConnected())) {
+            return;
+        }
+        prewarm_running_ = true;
+        // The audio channel sets version_ itself, the prewarm task only reads this copy
+        standby_version_ = version != 0 ? version : version_;
+    }
+    // Some modems only support one connection with the same id
+    SetWebSocket(nullptr);
 
-    error_occurred_ = false;
+    xTaskCreate([](void* arg) {
+        auto protocol = static_cast<WebsocketProtocol*>(arg);
+        Settings settings("websocket", false);
+        std::string url = settings.GetString("url");
+        std::string token = settings.GetString("token");
+        int version;
+        {
+            std::lock_guard<std::mutex> lock(protocol->standby_mutex_);
+            version = protocol->standby_version_;
+        }
 
+        auto websocket = protocol->ConnectWebSocket(url, token, version);
+        {
+            std::lock_guard<std::mutex> lock(protocol->standby_mutex_);
+            protocol->standby_websocket_ = std::move(websocket);
+            protocol->standby_url_ = url;
+            protocol->standby_time_ = std::chrono::steady_clock::now();
+            protocol->prewarm_running_ = false;
+            protocol->standby_cv_.notify_all();
+            if (protocol->standby_websocket_ != nullptr) {
+                esp_timer_stop(protocol->standby_timer_);
+                esp_timer_start_once(protocol->standby_timer_, CONFIG_WEBSOCKET_STANDBY_TIMEOUT_SECONDS * 1000000ULL);
+            }
+        }
+        vTaskDelete(NULL);
+    }, "ws_prewarm", 2048 * 4, this, 2, nullptr);
+#endif
+}
+
+std::unique_ptr<WebSocket> WebsocketProtocol::TakeStandbyWebSocket(const std::string& url, int version) {
+    // Wait for the connection in progress, it is likely to finish sooner than a new one
+    std::unique_ptr<WebSocket> websocket;
+    {
+        std::unique_lock<std::mutex> lock(standby_mutex_);
+        standby_cv_.wait(lock, [this]() { return !prewarm_running_; });
+        if (standby_timer_ != nullptr) {
+            esp_timer_stop(standby_timer_);
+        }
+        websocket = std::move(standby_websocket_);
+        if (websocket == nullptr) {
+            return nullptr;
+        }
+        auto age = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::steady_clock::now() - standby_time_).count();
+        if (websocket->IsConnected() && standby_url_ == url && standby_version_ == version &&
+            age <= CONFIG_WEBSOCKET_STANDBY_TIMEOUT_SECONDS) {
+            return websocket;
+        }
+    }
+    // Closed outside the lock, OnDisconnected takes it
+    ESP_LOGI(TAG, "Standby connection expired");
+    return nullptr;
+}
+
+void WebsocketProtocol::CloseStandbyWebSocket() {
+    std::unique_ptr<WebSocket> websocket;
+    {
+        std::lock_guard<std::mutex> lock(standby_mutex_);
+        websocket = std::move(standby_websocket_);
+    }
+    if (websocket != nullptr) {
+        ESP_LOGI(TAG, "Closing unused standby connection");
+    }
+}
+
+std::unique_ptr<WebSocket> WebsocketProtocol::ConnectWebSocket(const std::string& url, std::string token, int version) {
     auto network = Board::GetInstance().GetNetwork();
-    websocket_ = network->CreateWebSocket(1);
-    if (websocket_ == nullptr) {
+    auto websocket = network->CreateWebSocket(1);
+    if (websocket == nullptr) {
         ESP_LOGE(TAG, "Failed to create websocket");
-        return false;
+        return nullptr;
     }
 
     if (!token.empty()) {
@@ -102,13 +212,13 @@ bool WebsocketProtocol::OpenAudioChannel() {
         if (token.find(" ") == std::string::npos) {
             token = "Bearer " + token;
         }
-        websocket_->SetHeader("Authorization", token.c_str());
+        websocket->SetHeader("Authorization", token.c_str());
     }
-    websocket_->SetHeader("Protocol-Version", std::to_string(version_).c_str());
-    websocket_->SetHeader("Device-Id", SystemInfo::GetMacAddress().c_str());
-    websocket_->SetHeader("Client-Id", Board::GetInstance().GetUuid().c_str());
+    websocket->SetHeader("Protocol-Version", std::to_string(version).c_str());
+    websocket->SetHeader("Device-Id", SystemInfo::GetMacAddress().c_str());
+    websocket->SetHeader("Client-Id", Board::GetInstance().GetUuid().c_str());
 
-    websocket_->OnData([this](const char* data, size_t len, bool binary) {
+    websocket->OnData([this](const char* data, size_t len, bool binary) {
         if (binary) {
             if (on_incoming_audio_ != nullptr) {
                 if (version_ == 2) {
@@ -164,18 +274,55 @@ bool WebsocketProtocol::OpenAudioChannel() {
         last_incoming_time_ = std::chrono::steady_clock::now();
     });
 
-    websocket_->OnDisconnected([this]() {
+    WebSocket* ws = websocket.get();
+    websocket->OnDisconnected([this, ws]() {
+        bool audio_channel;
+        {
+            std::lock_guard<std::mutex> lock(standby_mutex_);
+            audio_channel = ws == websocket_.get();
+        }
+        if (!audio_channel) {
+            // The server closed a standby connection, it is not an audio channel yet
+            ESP_LOGI(TAG, "Standby websocket disconnected");
+            return;
+        }
         ESP_LOGI(TAG, "Websocket disconnected");
         if (on_audio_channel_closed_ != nullptr) {
             on_audio_channel_closed_();
         }
     });
 
-    ESP_LOGI(TAG, "Connecting to websocket server: %s with version: %d", url.c_str(), version_);
-    if (!websocket_->Connect(url.c_str())) {
+    ESP_LOGI(TAG, "Connecting to websocket server: %s with version: %d", url.c_str(), version);
+    if (!websocket->Connect(url.c_str())) {
         ESP_LOGE(TAG, "Failed to connect to websocket server");
-        SetError(Lang::Strings::SERVER_NOT_CONNECTED);
-        return false;
+        return nullptr;
+    }
+    return websocket;
+}
+
+bool WebsocketProtocol::OpenAudioChannel() {
+    Settings settings("websocket", false);
+    std::string url = settings.GetString("url");
+    std::string token = settings.GetString("token");
+    int version = settings.GetInt("version");
+    if (version != 0) {
+        version_ = version;
+    }
+
+    error_occurred_ = false;
+    auto start_time = std::chrono::steady_clock::now();
+
+    auto standby = TakeStandbyWebSocket(url, version_);
+    SetWebSocket(nullptr);
+    if (standby != nullptr) {
+        ESP_LOGI(TAG, "Using standby connection");
+        SetWebSocket(std::move(standby));
+    } else {
+        SetWebSocket(ConnectWebSocket(url, token, version_));
+        if (websocket_ == nullptr) {
+            SetError(Lang::Strings::SERVER_NOT_CONNECTED);
+            return false;
+        }
     }
 
     // Send hello message to describe the client
@@ -191,6 +338,8 @@ bool WebsocketProtocol::OpenAudioChannel() {
         SetError(Lang::Strings::SERVER_TIMEOUT);
         return false;
     }
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start_time).count();
+    ESP_LOGI(TAG, "Audio channel opened in %d ms", (int)elapsed);
 
     if (on_audio_channel_opened_ != nullptr) {
         on_audio_channel_opened_();
@@ -215,7 +364,7 @@ std::string WebsocketProtocol::GetHelloMessage() {
     cJSON_AddStringToObject(audio_params, "format", "opus");
     cJSON_AddNumberToObject(audio_params, "sample_rate", 16000);
     cJSON_AddNumberToObject(audio_params, "channels", 1);
-    cJSON_AddNumberToObject(audio_params, "frame_duration", OPUS_FRAME_DURATION_MS);
+    cJSON_AddNumberToObject(audio_params, "frame_duration", Application::GetInstance().GetAudioService().NegotiateEncoderFrameDuration());
     cJSON_AddItemToObject(root, "audio_params", audio_params);
     auto json_str = cJSON_PrintUnformatted(root);
     std::string message(json_str);
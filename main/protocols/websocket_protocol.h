@@ -7,6 +7,11 @@
 #include <web_socket.h>
 #include <freertos/FreeRTOS.h>
 #include <freertos/event_groups.h>
+#include <esp_timer.h>
+
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
 
 #define WEBSOCKET_PROTOCOL_SERVER_HELLO_EVENT (1 << 0)
 
@@ -20,12 +25,29 @@ public:
     bool OpenAudioChannel() override;
     void CloseAudioChannel() override;
     bool IsAudioChannelOpened() const override;
+    void Prewarm() override;
 
 private:
     EventGroupHandle_t event_group_handle_;
     std::unique_ptr<WebSocket> websocket_;
     int version_ = 1;
 
+    // Connection established ahead of time, the hello exchange is done when the audio channel is opened
+    std::mutex standby_mutex_;
+    std::condition_variable standby_cv_;
+    std::unique_ptr<WebSocket> standby_websocket_;
+    std::string standby_url_;
+    int standby_version_ = 1;
+    std::chrono::steady_clock::time_point standby_time_;
+    bool prewarm_running_ = false;
+    // Closes the standby connection when nobody took it in time
+    esp_timer_handle_t standby_timer_ = nullptr;
+
+    std::unique_ptr<WebSocket> ConnectWebSocket(const std::string& url, std::string token, int version);
+    std::unique_ptr<WebSocket> TakeStandbyWebSocket(const std::string& url, int version);
+    void CloseStandbyWebSocket();
+    // Replace the audio channel connection, the old one is closed outside the lock
+    void SetWebSocket(std::unique_ptr<WebSocket> websocket);
     void ParseServerHello(const cJSON* root);
     bool SendText(const std::string& text) override;
     std::string GetHelloMessage();
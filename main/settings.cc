@@ -1,45 +1,284 @@
 #include "settings.h"
 
 #include <esp_log.h>
+#include <esp_timer.h>
+#include <esp_system.h>
 #include <nvs_flash.h>
 
+#include <map>
+#include <mutex>
+#include <vector>
+
 #define TAG "Settings"
 
+
+namespace {
+
+struct SettingEntry {
+    nvs_type_t type = NVS_TYPE_ANY;
+    int32_t number = 0;
+    std::string text;
+    bool present = false;
+    bool dirty = false;
+    uint32_t generation = 0;    // Change count when last written, to tell if it changed during a commit
+};
+
+struct SettingsNamespace {
+    std::map<std::string, SettingEntry> entries;
+    bool erase_all = false;
+    bool dirty = false;
+    uint32_t erase_generation = 0;
+};
+
+// Typed cache of the NVS namespaces used through Settings, shared by all instances
+class SettingsStore {
+public:
+    static SettingsStore& GetInstance() {
+        static SettingsStore instance;
+        return instance;
+    }
+
+    bool Get(const std::string& ns, const std::string& key, nvs_type_t type, SettingEntry& entry) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto& entries = Load(ns).entries;
+        auto it = entries.find(key);
+        if (it == entries.end() || !it->second.present || it->second.type != type) {
+            return false;
+        }
+        entry = it->second;
+        return true;
+    }
+
+    void Set(const std::string& ns, const std::string& key, nvs_type_t type, int32_t number, const std::string& text) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto& space = Load(ns);
+        auto& entry = space.entries[key];
+        if (entry.present && entry.type == type && entry.number == number && entry.text == text) {
+            return;
+        }
+        entry.type = type;
+        entry.number = number;
+        entry.text = text;
+        entry.present = true;
+        entry.dirty = true;
+        entry.generation = ++generation_;
+        space.dirty = true;
+    }
+
+    void Erase(const std::string& ns, const std::string& key) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto& space = Load(ns);
+        // Keys of types not cached are erased from NVS as well
+        auto& entry = space.entries[key];
+        entry.present = false;
+        entry.dirty = true;
+        entry.generation = ++generation_;
+        space.dirty = true;
+    }
+
+    void EraseAll(const std::string& ns) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto& space = Load(ns);
+        space.entries.clear();
+        space.erase_all = true;
+        space.erase_generation = ++generation_;
+        space.dirty = true;
+    }
+
+    void ScheduleCommit() {
+#if CONFIG_SETTINGS_COMMIT_DELAY_MS > 0
+        // Restart the timer, so that a burst of writes is committed once
+        esp_timer_stop(commit_timer_);
+        esp_timer_start_once(commit_timer_, CONFIG_SETTINGS_COMMIT_DELAY_MS * 1000);
+#else
+        Commit();
+#endif
+    }
+
+    void Commit() {
+        // Serialize the commits, the cache stays available while NVS is written
+        std::lock_guard<std::mutex> commit_lock(commit_mutex_);
+
+        std::vector<std::pair<std::string, SettingsNamespace>> changes;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (auto& [name, space] : namespaces_) {
+                if (!space.dirty) {
+                    continue;
+                }
+                // The dirty flags are cleared once the commit succeeded, a failed commit is retried with the next one
+                SettingsNamespace change;
+                change.erase_all = space.erase_all;
+                change.erase_generation = space.erase_generation;
+                for (auto& [key, entry] : space.entries) {
+                    if (entry.dirty) {
+                        change.entries[key] = entry;
+                    }
+                }
+                changes.emplace_back(name, std::move(change));
+            }
+        }
+
+        for (auto& [name, change] : changes) {
+            nvs_handle_t handle;
+            esp_err_t err = nvs_open(name.c_str(), NVS_READWRITE, &handle);
+            if (err != ESP_OK) {
+                ESP_LOGE(TAG, "Failed to open namespace %s: %s", name.c_str(), esp_err_to_name(err));
+                continue;
+            }
+            if (change.erase_all) {
+                err = nvs_erase_all(handle);
+            }
+            for (auto& [key, entry] : change.entries) {
+                if (err != ESP_OK) {
+                    break;
+                }
+                if (!entry.present) {
+                    err = nvs_erase_key(handle, key.c_str());
+                    if (err == ESP_ERR_NVS_NOT_FOUND) {
+                        err = ESP_OK;
+                    }
+                } else if (entry.type == NVS_TYPE_STR) {
+                    err = nvs_set_str(handle, key.c_str(), entry.text.c_str());
+                } else if (entry.type == NVS_TYPE_I32) {
+                    err = nvs_set_i32(handle, key.c_str(), entry.number);
+                } else if (entry.type == NVS_TYPE_U8) {
+                    err = nvs_set_u8(handle, key.c_str(), static_cast<uint8_t>(entry.number));
+                }
+            }
+            if (err == ESP_OK) {
+                err = nvs_commit(handle);
+            }
+            nvs_close(handle);
+            if (err != ESP_OK) {
+                ESP_LOGE(TAG, "Failed to commit namespace %s: %s", name.c_str(), esp_err_to_name(err));
+                continue;
+            }
+            ESP_LOGD(TAG, "Committed %u keys to namespace %s", change.entries.size(), name.c_str());
+            MarkCommitted(name, change);
+        }
+    }
+
+private:
+    std::mutex mutex_;
+    std::mutex commit_mutex_;
+    std::map<std::string, SettingsNamespace> namespaces_;
+    esp_timer_handle_t commit_timer_ = nullptr;
+    uint32_t generation_ = 0;
+
+    SettingsStore() {
+        esp_timer_create_args_t commit_timer_args = {
+            .callback = [](void* arg) {
+                static_cast<SettingsStore*>(arg)->Commit();
+            },
+            .arg = this,
+            .dispatch_method = ESP_TIMER_TASK,
+            .name = "settings_commit",
+            .skip_unhandled_events = true,
+        };
+        esp_timer_create(&commit_timer_args, &commit_timer_);
+
+        // Do not lose pending writes when the device restarts
+        esp_register_shutdown_handler([]() {
+            SettingsStore::GetInstance().Commit();
+        });
+    }
+
+    // Clear the dirty flags of the values committed, unless they were written again meanwhile
+    void MarkCommitted(const std::string& ns, const SettingsNamespace& change) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto& space = namespaces_[ns];
+        if (change.erase_all && space.erase_generation == change.erase_generation) {
+            space.erase_all = false;
+        }
+        space.dirty = space.erase_all;
+        for (auto& [key, entry] : space.entries) {
+            auto it = change.entries.find(key);
+            if (entry.dirty && it != change.entries.end() && it->second.generation == entry.generation) {
+                entry.dirty = false;
+            }
+            space.dirty = space.dirty || entry.dirty;
+        }
+    }
+
+    // Called with mutex_ held
+    SettingsNamespace& Load(const std::string& ns) {
+        auto it = namespaces_.find(ns);
+        if (it != namespaces_.end()) {
+            return it->second;
+        }
+
+        auto& space = namespaces_[ns];
+        nvs_handle_t handle;
+        if (nvs_open(ns.c_str(), NVS_READONLY, &handle) != ESP_OK) {
+            // The namespace does not exist yet
+            return space;
+        }
+
+        nvs_iterator_t iterator = nullptr;
+        esp_err_t err = nvs_entry_find(NVS_DEFAULT_PART_NAME, ns.c_str(), NVS_TYPE_ANY, &iterator);
+        while (err == ESP_OK) {
+            nvs_entry_info_t info;
+            nvs_entry_info(iterator, &info);
+
+            SettingEntry entry;
+            entry.type = info.type;
+            if (info.type == NVS_TYPE_STR) {
+                size_t length = 0;
+                if (nvs_get_str(handle, info.key, nullptr, &length) == ESP_OK) {
+                    entry.text.resize(length);
+                    entry.present = nvs_get_str(handle, info.key, entry.text.data(), &length) == ESP_OK;
+                    while (!entry.text.empty() && entry.text.back() == '\0') {
+                        entry.text.pop_back();
+                    }
+                }
+            } else if (info.type == NVS_TYPE_I32) {
+                entry.present = nvs_get_i32(handle, info.key, &entry.number) == ESP_OK;
+            } else if (info.type == NVS_TYPE_U8) {
+                uint8_t value = 0;
+                entry.present = nvs_get_u8(handle, info.key, &value) == ESP_OK;
+                entry.number = value;
+            }
+            // Other types are not accessible through Settings
+            if (entry.present) {
+                space.entries[info.key] = std::move(entry);
+            }
+            err = nvs_entry_next(&iterator);
+        }
+        nvs_release_iterator(iterator);
+        nvs_close(handle);
+        ESP_LOGD(TAG, "Loaded %u keys from namespace %s", space.entries.size(), ns.c_str());
+        return space;
+    }
+};
+
+} // namespace
+
+
 Settings::Settings(const std::string& ns, bool read_write) : ns_(ns), read_write_(read_write) {
-    nvs_open(ns.c_str(), read_write_ ? NVS_READWRITE : NVS_READONLY, &nvs_handle_);
 }
 
 Settings::~Settings() {
-    if (nvs_handle_ != 0) {
-        if (read_write_ && dirty_) {
-            ESP_ERROR_CHECK(nvs_commit(nvs_handle_));
-        }
-        nvs_close(nvs_handle_);
+    if (read_write_ && dirty_) {
+        SettingsStore::GetInstance().ScheduleCommit();
     }
 }
 
-std::string Settings::GetString(const std::string& key, const std::string& default_value) {
-    if (nvs_handle_ == 0) {
-        return default_value;
-    }
+void Settings::Flush() {
+    SettingsStore::GetInstance().Commit();
+}
 
-    size_t length = 0;
-    if (nvs_get_str(nvs_handle_, key.c_str(), nullptr, &length) != ESP_OK) {
+std::string Settings::GetString(const std::string& key, const std::string& default_value) {
+    SettingEntry entry;
+    if (!SettingsStore::GetInstance().Get(ns_, key, NVS_TYPE_STR, entry)) {
         return default_value;
     }
-
-    std::string value;
-    value.resize(length);
-    ESP_ERROR_CHECK(nvs_get_str(nvs_handle_, key.c_str(), value.data(), &length));
-    while (!value.empty() && value.back() == '\0') {
-        value.pop_back();
-    }
-    return value;
+    return entry.text;
 }
 
 void Settings::SetString(const std::string& key, const std::string& value) {
     if (read_write_) {
-        ESP_ERROR_CHECK(nvs_set_str(nvs_handle_, key.c_str(), value.c_str()));
+        SettingsStore::GetInstance().Set(ns_, key, NVS_TYPE_STR, 0, value);
         dirty_ = true;
     } else {
         ESP_LOGW(TAG, "Namespace %s is not open for writing", ns_.c_str());
@@ -47,20 +286,16 @@ void Settings::SetString(const std::string& key, const std::string& value) {
 }
 
 int32_t Settings::GetInt(const std::string& key, int32_t default_value) {
-    if (nvs_handle_ == 0) {
+    SettingEntry entry;
+    if (!SettingsStore::GetInstance().Get(ns_, key, NVS_TYPE_I32, entry)) {
         return default_value;
     }
-
-    int32_t value;
-    if (nvs_get_i32(nvs_handle_, key.c_str(), &value) != ESP_OK) {
-        return default_value;
-    }
-    return value;
+    return entry.number;
 }
 
 void Settings::SetInt(const std::string& key, int32_t value) {
     if (read_write_) {
-        ESP_ERROR_CHECK(nvs_set_i32(nvs_handle_, key.c_str(), value));
+        SettingsStore::GetInstance().Set(ns_, key, NVS_TYPE_I32, value, "");
         dirty_ = true;
     } else {
         ESP_LOGW(TAG, "Namespace %s is not open for writing", ns_.c_str());
@@ -68,20 +303,16 @@ void Settings::SetInt(const std::string& key, int32_t value) {
 }
 
 bool Settings::GetBool(const std::string& key, bool default_value) {
-    if (nvs_handle_ == 0) {
-        return default_value;
-    }
-
-    uint8_t value;
-    if (nvs_get_u8(nvs_handle_, key.c_str(), &value) != ESP_OK) {
+    SettingEntry entry;
+    if (!SettingsStore::GetInstance().Get(ns_, key, NVS_TYPE_U8, entry)) {
         return default_value;
     }
-    return value != 0;
+    return entry.number != 0;
 }
 
 void Settings::SetBool(const std::string& key, bool value) {
     if (read_write_) {
-        ESP_ERROR_CHECK(nvs_set_u8(nvs_handle_, key.c_str(), value ? 1 : 0));
+        SettingsStore::GetInstance().Set(ns_, key, NVS_TYPE_U8, value ? 1 : 0, "");
         dirty_ = true;
     } else {
         ESP_LOGW(TAG, "Namespace %s is not open for writing", ns_.c_str());
@@ -90,10 +321,8 @@ void Settings::SetBool(const std::string& key, bool value) {
 
 void Settings::EraseKey(const std::string& key) {
     if (read_write_) {
-        auto ret = nvs_erase_key(nvs_handle_, key.c_str());
-        if (ret != ESP_ERR_NVS_NOT_FOUND) {
-            ESP_ERROR_CHECK(ret);
-        }
+        SettingsStore::GetInstance().Erase(ns_, key);
+        dirty_ = true;
     } else {
         ESP_LOGW(TAG, "Namespace %s is not open for writing", ns_.c_str());
     }
@@ -101,7 +330,8 @@ void Settings::EraseKey(const std::string& key) {
 
 void Settings::EraseAll() {
     if (read_write_) {
-        ESP_ERROR_CHECK(nvs_erase_all(nvs_handle_));
+        SettingsStore::GetInstance().EraseAll(ns_);
+        dirty_ = true;
     } else {
         ESP_LOGW(TAG, "Namespace %s is not open for writing", ns_.c_str());
     }
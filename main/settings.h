@@ -4,6 +4,15 @@
 #include <string>
 #include <nvs_flash.h>
 
+/*
+ * Settings are read from a process-wide cache, each namespace is loaded from NVS once.
+ * Writes update the cache immediately and are committed to NVS by a timer after
+ * CONFIG_SETTINGS_COMMIT_DELAY_MS, so that bursts of writes (e.g. volume changes from a knob)
+ * result in a single commit. Pending writes are committed before esp_restart, and by the sleep
+ * and power save timers and the PMIC drivers before powering off. Boards entering deep sleep or
+ * cutting the power by themselves call Flush first. A failed commit is retried with the next one.
+ * Values written to NVS by other components bypassing this class are only seen after a restart.
+ */
 class Settings {
 public:
     Settings(const std::string& ns, bool read_write = false);
@@ -18,9 +27,11 @@ public:
     void EraseKey(const std::string& key);
     void EraseAll();
 
+    // Commit all pending writes to NVS now
+    static void Flush();
+
 private:
     std::string ns_;
-    nvs_handle_t nvs_handle_ = 0;
     bool read_write_ = false;
     bool dirty_ = false;
 };
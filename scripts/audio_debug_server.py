@@ -1,54 +1,178 @@
 import socket
+import struct
 import wave
 import argparse
+import os
 
 
 '''
   Create a UDP socket and bind it to the server's IP:8000.
-  Listen for incoming messages and print them to the console.
-  Save the audio to a WAV file.
+  Receive the audio packets sent by the device audio debugger (CONFIG_USE_AUDIO_DEBUGGER).
+  Save the audio of every tap to its own WAV file, filling lost packets with silence.
+
+  Every packet starts with a little-endian header, see AudioDebugHeader in
+  main/audio/processors/audio_debugger.h:
+    magic u16, version u8, tap u8, format u8, channels u8, samples u16 (per channel),
+    sequence u32, sample_rate u32, timestamp_us i64
 '''
-def main(samplerate, channels):
+
+HEADER = struct.Struct('<HBBBBHIIq')
+MAGIC = 0x4441
+VERSION = 1
+TAP_NAMES = ['mic', 'afe', 'downlink']
+FORMAT_PCM16 = 0
+FORMAT_IMA_ADPCM = 1
+
+IMA_STEP_TABLE = [
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+    50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209, 230, 253, 279, 307,
+    337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066,
+    2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899,
+    15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767,
+]
+IMA_INDEX_TABLE = [-1, -1, -1, -1, 2, 4, 6, 8, -1, -1, -1, -1, 2, 4, 6, 8]
+
+
+def decode_adpcm(payload, samples, channels):
+    '''Decode one packet of IMA ADPCM to interleaved 16-bit PCM bytes'''
+    pcm = [0] * (samples * channels)
+    data_offset = channels * 4
+    block_size = (samples + 1) // 2
+    for ch in range(channels):
+        predictor, index = struct.unpack_from('<hB', payload, ch * 4)
+        data = payload[data_offset + ch * block_size:data_offset + (ch + 1) * block_size]
+        for i in range(samples):
+            nibble = (data[i // 2] >> (4 * (i % 2))) & 0x0F
+            step = IMA_STEP_TABLE[index]
+            delta = step >> 3
+            if nibble & 4:
+                delta += step
+            if nibble & 2:
+                delta += step >> 1
+            if nibble & 1:
+                delta += step >> 2
+            predictor += -delta if nibble & 8 else delta
+            predictor = max(-32768, min(32767, predictor))
+            index = max(0, min(88, index + IMA_INDEX_TABLE[nibble]))
+            pcm[i * channels + ch] = predictor
+    return struct.pack(f'<{len(pcm)}h', *pcm)
+
+
+def parse_packet(message):
+    '''Returns (header dict, PCM bytes), or None if the packet is not valid'''
+    if len(message) < HEADER.size:
+        return None
+    magic, version, tap, fmt, channels, samples, sequence, sample_rate, timestamp_us = HEADER.unpack_from(message)
+    if magic != MAGIC or version != VERSION or channels == 0:
+        return None
+    payload = message[HEADER.size:]
+    if fmt == FORMAT_PCM16:
+        if len(payload) != samples * channels * 2:
+            return None
+        pcm = payload
+    elif fmt == FORMAT_IMA_ADPCM:
+        if len(payload) != channels * (4 + (samples + 1) // 2):
+            return None
+        pcm = decode_adpcm(payload, samples, channels)
+    else:
+        return None
+    header = {
+        'tap': tap, 'format': fmt, 'channels': channels, 'samples': samples,
+        'sequence': sequence, 'sample_rate': sample_rate, 'timestamp_us': timestamp_us,
+    }
+    return header, pcm
+
+
+class TapRecorder:
+    '''Writes the packets of one tap to a WAV file and tracks the sequence numbers'''
+
+    def __init__(self, output_dir, header):
+        name = TAP_NAMES[header['tap']] if header['tap'] < len(TAP_NAMES) else f"tap{header['tap']}"
+        self.name = name
+        self.channels = header['channels']
+        self.sample_rate = header['sample_rate']
+        self.filename = os.path.join(output_dir, f"{name}_{self.sample_rate}_{self.channels}.wav")
+        self.wav_file = wave.open(self.filename, 'wb')
+        self.wav_file.setnchannels(self.channels)
+        self.wav_file.setsampwidth(2)
+        self.wav_file.setframerate(self.sample_rate)
+        self.next_sequence = header['sequence']
+        self.received = 0
+        self.lost = 0
+        self.late = 0
+
+    def matches(self, header):
+        return header['channels'] == self.channels and header['sample_rate'] == self.sample_rate
+
+    def write(self, header, pcm):
+        gap = (header['sequence'] - self.next_sequence) & 0xFFFFFFFF
+        if gap >= 0x80000000:
+            # Reordered or duplicated, the audio at its position was already filled
+            self.late += 1
+            return
+        if gap > 0:
+            # Assume the lost packets had the size of this one
+            self.lost += gap
+            self.wav_file.writeframes(b'\x00' * (gap * header['samples'] * self.channels * 2))
+            print(f"{self.name}: lost {gap} packets before #{header['sequence']}")
+        self.wav_file.writeframes(pcm)
+        self.received += 1
+        self.next_sequence = (header['sequence'] + 1) & 0xFFFFFFFF
+
+    def close(self):
+        self.wav_file.close()
+        total = self.received + self.lost
+        loss = 100.0 * self.lost / total if total else 0.0
+        print(f"WAV file '{self.filename}' saved, {self.received} packets received, "
+              f"{self.lost} lost ({loss:.1f}%), {self.late} late")
+
+
+def main(port, output_dir):
     # Create a UDP socket
     server_socket = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
-    server_socket.bind(('0.0.0.0', 8000))
+    server_socket.bind(('0.0.0.0', port))
+    os.makedirs(output_dir, exist_ok=True)
 
-    # Create WAV file with parameters
-    filename = f"{samplerate}_{channels}.wav"
-    wav_file = wave.open(filename, "wb")
-    wav_file.setnchannels(channels)     # channels parameter
-    wav_file.setsampwidth(2)            # 2 bytes per sample (16-bit)
-    wav_file.setframerate(samplerate)   # samplerate parameter
-
-    print(f"Start saving audio from 0.0.0.0:8000 to {filename}...")
+    recorders = {}
+    print(f"Start saving audio from 0.0.0.0:{port} to {output_dir}...")
 
     try:
         while True:
-            # Receive a message from the client
-            message, address = server_socket.recvfrom(8000)
-            
-            # Write PCM data to WAV file
-            wav_file.writeframes(message)
-
-            # Print length of the message
-            print(f"Received {len(message)} bytes from {address}")
-    
+            message, address = server_socket.recvfrom(65536)
+            packet = parse_packet(message)
+            if packet is None:
+                print(f"Ignored invalid packet of {len(message)} bytes from {address}")
+                continue
+            header, pcm = packet
+
+            recorder = recorders.get(header['tap'])
+            if recorder is not None and not recorder.matches(header):
+                # The layout of the tap changed, start a new file
+                recorder.close()
+                recorder = None
+            if recorder is None:
+                recorder = TapRecorder(output_dir, header)
+                recorders[header['tap']] = recorder
+                print(f"{recorder.name}: {recorder.sample_rate} Hz, {recorder.channels} channels, "
+                      f"{'ADPCM' if header['format'] == FORMAT_IMA_ADPCM else 'PCM'} -> {recorder.filename}")
+            recorder.write(header, pcm)
+
     except KeyboardInterrupt:
         print("\nStopping recording...")
-    
+
     finally:
         # Close files and socket
-        wav_file.close()
+        for recorder in recorders.values():
+            recorder.close()
         server_socket.close()
-        print(f"WAV file '{filename}' saved successfully")
 
 
 if __name__ == "__main__":
-    parser = argparse.ArgumentParser(description='UDP音频数据接收器，保存为WAV文件')
-    parser.add_argument('--samplerate', '-s', type=int, default=16000, 
-                        help='采样率 (默认: 16000)')
-    parser.add_argument('--channels', '-c', type=int, default=2, 
-                        help='声道数 (默认: 2)')
-    
+    parser = argparse.ArgumentParser(description='UDP音频数据接收器，按采集点保存为WAV文件')
+    parser.add_argument('--port', '-p', type=int, default=8000,
+                        help='UDP端口 (默认: 8000)')
+    parser.add_argument('--output-dir', '-o', default='.',
+                        help='WAV文件保存目录 (默认: 当前目录)')
+
     args = parser.parse_args()
-    main(args.samplerate, args.channels)
+    main(args.port, args.output_dir)
@@ -0,0 +1,6 @@
+#ifndef CJSON_H
+#define CJSON_H
+
+typedef struct cJSON cJSON;
+
+#endif // CJSON_H
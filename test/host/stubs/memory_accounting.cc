@@ -0,0 +1,18 @@
+#include "memory_accounting.h"
+
+#include <cstdlib>
+
+// Host replacement without accounting, the tests only need the allocations
+void* MemoryAccounting::Malloc(MemoryTag tag, size_t size, uint32_t caps) {
+    return malloc(size);
+}
+
+void MemoryAccounting::Free(MemoryTag tag, void* ptr) {
+    free(ptr);
+}
+
+void MemoryAccounting::Record(MemoryTag tag, const void* ptr) {
+}
+
+void MemoryAccounting::Release(MemoryTag tag, const void* ptr) {
+}
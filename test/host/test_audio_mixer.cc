@@ -0,0 +1,97 @@
+#include "audio_mixer.h"
+#include "test_util.h"
+
+#include <algorithm>
+
+#define FRAME_SAMPLES 960
+
+static int MaxMagnitude(const std::vector<int16_t>& pcm) {
+    int result = 0;
+    for (auto sample : pcm) {
+        result = std::max(result, std::abs(int(sample)));
+    }
+    return result;
+}
+
+// After the fade-in, a single stream at unity gain passes unchanged
+static void TestSingleStreamUnchanged() {
+    AudioMixer mixer;
+    mixer.Configure(16000);
+    auto speech = MakeSine(16000, 440, 30000, FRAME_SAMPLES);
+    std::vector<int16_t> output(FRAME_SAMPLES);
+    for (int i = 0; i < 3; i++) {
+        mixer.SetInput(kMixerStreamSpeech, speech.data(), speech.size());
+        mixer.Mix(output.data(), output.size());
+    }
+    CHECK(output == speech);
+}
+
+static void TestFadeIn() {
+    AudioMixer mixer;
+    mixer.Configure(16000);
+    std::vector<int16_t> speech(FRAME_SAMPLES, 20000);
+    std::vector<int16_t> output(FRAME_SAMPLES);
+    mixer.SetInput(kMixerStreamSpeech, speech.data(), speech.size());
+    mixer.Mix(output.data(), output.size());
+    CHECK(output[0] < 1000);
+    CHECK(output[FRAME_SAMPLES - 1] == 20000);
+}
+
+// Two loud streams are limited to full scale without wrapping around
+static void TestLimiter() {
+    AudioMixer mixer;
+    mixer.Configure(16000);
+    mixer.SetDuckingLevel(100);
+    auto speech = MakeSine(16000, 440, 30000, FRAME_SAMPLES);
+    auto alert = MakeSine(16000, 440, 30000, FRAME_SAMPLES);
+    std::vector<int16_t> output(FRAME_SAMPLES);
+    for (int i = 0; i < 3; i++) {
+        mixer.SetInput(kMixerStreamSpeech, speech.data(), speech.size());
+        mixer.SetInput(kMixerStreamAlert, alert.data(), alert.size());
+        mixer.Mix(output.data(), output.size());
+    }
+    CHECK(MaxMagnitude(output) <= INT16_MAX);
+    CHECK(MaxMagnitude(output) > 30000);
+    // The limited sum keeps the sign of the inputs
+    for (size_t i = 0; i < output.size(); i++) {
+        CHECK((output[i] >= 0) == (speech[i] >= 0) || std::abs(speech[i]) < 100);
+    }
+}
+
+static void TestDucking() {
+    AudioMixer mixer;
+    mixer.Configure(16000);
+    mixer.SetDuckingLevel(25);
+    auto speech = MakeSine(16000, 440, 16000, FRAME_SAMPLES);
+    std::vector<int16_t> silence(FRAME_SAMPLES, 0);
+    std::vector<int16_t> output(FRAME_SAMPLES);
+    for (int i = 0; i < 2; i++) {
+        mixer.SetInput(kMixerStreamSpeech, speech.data(), speech.size());
+        mixer.Mix(output.data(), output.size());
+    }
+    // The ducking ramps over 50 ms, check after it settled
+    for (int i = 0; i < 3; i++) {
+        mixer.SetInput(kMixerStreamSpeech, speech.data(), speech.size());
+        mixer.SetInput(kMixerStreamAlert, silence.data(), silence.size());
+        mixer.Mix(output.data(), output.size());
+    }
+    double gain = Rms(output.data(), output.size()) / Rms(speech.data(), speech.size());
+    CHECK(std::abs(gain - 0.25) < 0.01);
+}
+
+static void TestFadeOut() {
+    std::vector<int16_t> pcm(FRAME_SAMPLES, 10000);
+    AudioMixer::FadeOut(pcm, 80);
+    CHECK(pcm.size() == 80);
+    CHECK(pcm[0] == 10000);
+    CHECK(pcm[79] < 200);
+}
+
+int main() {
+    TestSingleStreamUnchanged();
+    TestFadeIn();
+    TestLimiter();
+    TestDucking();
+    TestFadeOut();
+    return TEST_RESULT();
+}
@@ -0,0 +1,77 @@
+#include "energy_vad.h"
+#include "test_util.h"
+
+#include <random>
+
+#define SAMPLE_RATE 16000
+#define FRAME_SAMPLES 160
+
+// Voiced speech stand-in, a 150 Hz fundamental with a few harmonics
+static std::vector<int16_t> MakeVoice(size_t samples, double amplitude) {
+    std::vector<int16_t> pcm(samples);
+    for (size_t i = 0; i < samples; i++) {
+        double t = double(i) / SAMPLE_RATE;
+        double value = 0;
+        for (int harmonic = 1; harmonic <= 5; harmonic++) {
+            value += sin(2 * M_PI * 150 * harmonic * t) / harmonic;
+        }
+        pcm[i] = static_cast<int16_t>(amplitude * value / 2);
+    }
+    return pcm;
+}
+
+// Frames processed until the detector reports `speaking`, or -1
+static int FramesUntil(EnergyVad& vad, const std::vector<int16_t>& pcm, bool speaking) {
+    for (size_t offset = 0; offset + FRAME_SAMPLES <= pcm.size(); offset += FRAME_SAMPLES) {
+        if (vad.Process(pcm.data() + offset, FRAME_SAMPLES) == speaking) {
+            return offset / FRAME_SAMPLES + 1;
+        }
+    }
+    return -1;
+}
+
+static void TestSilence() {
+    EnergyVad vad;
+    vad.Reset();
+    std::vector<int16_t> silence(SAMPLE_RATE, 0);
+    CHECK(FramesUntil(vad, silence, true) == -1);
+}
+
+static void TestSpeechOnsetAndRelease() {
+    EnergyVad vad;
+    vad.Reset();
+    std::mt19937 random(1);
+    std::normal_distribution<double> noise(0, 30);
+    std::vector<int16_t> quiet(SAMPLE_RATE / 2);
+    for (auto& sample : quiet) {
+        sample = static_cast<int16_t>(noise(random));
+    }
+    CHECK(FramesUntil(vad, quiet, true) == -1);
+
+    // Speech is reported after 30 ms and released 100 ms after it stops
+    auto voice = MakeVoice(SAMPLE_RATE / 2, 8000);
+    CHECK(FramesUntil(vad, voice, true) == 3);
+    CHECK(FramesUntil(vad, voice, false) == -1);
+    CHECK(FramesUntil(vad, quiet, false) == 10);
+}
+
+static void TestWhiteNoiseIsNotSpeech() {
+    EnergyVad vad;
+    vad.Reset();
+    std::vector<int16_t> silence(SAMPLE_RATE / 4, 0);
+    vad.Process(silence.data(), silence.size());
+    std::mt19937 random(2);
+    std::uniform_int_distribution<int> noise(-8000, 8000);
+    std::vector<int16_t> hiss(SAMPLE_RATE);
+    for (auto& sample : hiss) {
+        sample = noise(random);
+    }
+    CHECK(FramesUntil(vad, hiss, true) == -1);
+}
+
+int main() {
+    TestSilence();
+    TestSpeechOnsetAndRelease();
+    TestWhiteNoiseIsNotSpeech();
+    return TEST_RESULT();
+}
@@ -0,0 +1,56 @@
+#include "frame_chunker.h"
+#include "test_util.h"
+
+// Chunks of any size come out as whole frames holding the stream in order
+static void TestFrames() {
+    FrameChunker chunker;
+    chunker.Configure(960);
+    std::vector<std::vector<int16_t>> frames;
+    auto emit = [&frames](std::vector<int16_t>&& frame) { frames.push_back(std::move(frame)); };
+
+    int16_t next = 0;
+    size_t total = 0;
+    const size_t chunk_sizes[] = { 512, 1, 2000, 959, 7 };
+    for (int round = 0; round < 20; round++) {
+        for (size_t size : chunk_sizes) {
+            std::vector<int16_t> chunk(size);
+            for (auto& sample : chunk) {
+                sample = next++;
+            }
+            chunker.Push(chunk.data(), chunk.size(), emit);
+            total += size;
+        }
+    }
+    CHECK(frames.size() == total / 960);
+    CHECK(chunker.pending() == total % 960);
+    int16_t expected = 0;
+    for (auto& frame : frames) {
+        CHECK(frame.size() == 960);
+        for (auto sample : frame) {
+            CHECK(sample == expected);
+            expected++;
+        }
+    }
+}
+
+static void TestReset() {
+    FrameChunker chunker;
+    chunker.Configure(160);
+    int frames = 0;
+    auto emit = [&frames](std::vector<int16_t>&& frame) { frames++; };
+    std::vector<int16_t> chunk(100, 1);
+    chunker.Push(chunk.data(), chunk.size(), emit);
+    chunker.Reset();
+    CHECK(chunker.pending() == 0);
+    chunker.Push(chunk.data(), chunk.size(), emit);
+    CHECK(frames == 0);
+    chunker.Push(chunk.data(), chunk.size(), emit);
+    CHECK(frames == 1);
+    CHECK(chunker.pending() == 40);
+}
+
+int main() {
+    TestFrames();
+    TestReset();
+    return TEST_RESULT();
+}
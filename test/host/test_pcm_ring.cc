@@ -0,0 +1,67 @@
+#include "pcm_ring.h"
+#include "test_util.h"
+
+static void TestCapacity() {
+    PcmRing ring(1000);
+    CHECK(ring.capacity() == 1024);
+    CHECK(ring.available() == 0);
+    CHECK(ring.space() == 1024);
+}
+
+// Writing more than the free space stores what fits, reading more than is filled returns what is there
+static void TestOverrunAndUnderrun() {
+    PcmRing ring(256);
+    std::vector<int16_t> input(300);
+    for (size_t i = 0; i < input.size(); i++) {
+        input[i] = int16_t(i);
+    }
+    CHECK(ring.Write(input.data(), input.size()) == 256);
+    CHECK(ring.space() == 0);
+    CHECK(ring.Write(input.data(), 1) == 0);
+
+    std::vector<int16_t> output(300);
+    CHECK(ring.Read(output.data(), output.size()) == 256);
+    for (size_t i = 0; i < 256; i++) {
+        CHECK(output[i] == int16_t(i));
+    }
+    CHECK(ring.available() == 0);
+    CHECK(ring.Read(output.data(), 1) == 0);
+}
+
+// The order is kept across the end of the buffer, and the peeked spans never cross it
+static void TestWrapAround() {
+    PcmRing ring(64);
+    int16_t next_write = 0;
+    int16_t next_read = 0;
+    std::vector<int16_t> chunk(48);
+    for (int round = 0; round < 100; round++) {
+        size_t count = 17 + round % 31;
+        for (size_t i = 0; i < count; i++) {
+            chunk[i] = next_write + i;
+        }
+        size_t written = ring.Write(chunk.data(), count);
+        next_write += written;
+
+        size_t samples = 64;
+        const int16_t* data = ring.PeekRead(samples);
+        CHECK(samples <= ring.available());
+        for (size_t i = 0; i < samples; i++) {
+            CHECK(data[i] == int16_t(next_read + i));
+        }
+        ring.CommitRead(samples);
+        next_read += samples;
+    }
+    std::vector<int16_t> rest(64);
+    size_t read = ring.Read(rest.data(), rest.size());
+    for (size_t i = 0; i < read; i++) {
+        CHECK(rest[i] == int16_t(next_read + i));
+    }
+    CHECK(int16_t(next_read + read) == next_write);
+}
+
+int main() {
+    TestCapacity();
+    TestOverrunAndUnderrun();
+    TestWrapAround();
+    return TEST_RESULT();
+}
@@ -0,0 +1,67 @@
+#include "polyphase_resampler.h"
+#include "test_util.h"
+
+#include <algorithm>
+
+// The samples produced over many calls of odd sizes match GetOutputSamples and the rate ratio
+static void TestOutputCount(int input_rate, int output_rate) {
+    PolyphaseResampler resampler;
+    resampler.Configure(input_rate, output_rate);
+    const int chunk_sizes[] = { 1, 7, 160, 241, 512, 960, 33 };
+    std::vector<int16_t> input(960, 1000);
+    std::vector<int16_t> output;
+    int64_t total_input = 0;
+    int64_t total_output = 0;
+    for (int round = 0; round < 50; round++) {
+        for (int size : chunk_sizes) {
+            int expected = resampler.GetOutputSamples(size);
+            resampler.Process(input.data(), size, output);
+            CHECK(int(output.size()) == expected);
+            total_input += size;
+            total_output += output.size();
+        }
+    }
+    int64_t ideal = total_input * output_rate / input_rate;
+    CHECK(std::abs(total_output - ideal) <= 1);
+}
+
+// Gain of a tone after resampling, skipping the filter delay at the start
+static double ToneGain(int input_rate, int output_rate, double frequency) {
+    PolyphaseResampler resampler;
+    resampler.Configure(input_rate, output_rate);
+    const double amplitude = 10000;
+    auto input = MakeSine(input_rate, frequency, amplitude, input_rate / 2);
+    std::vector<int16_t> output;
+    resampler.Process(input.data(), input.size(), output);
+    size_t skip = output.size() / 4;
+    return Rms(output.data() + skip, output.size() - skip) / (amplitude / sqrt(2));
+}
+
+static void TestResponse() {
+    // Pass band tones keep their level within 0.5 dB
+    CHECK(std::abs(ToneGain(24000, 16000, 1000) - 1) < 0.06);
+    CHECK(std::abs(ToneGain(16000, 24000, 1000) - 1) < 0.06);
+    CHECK(std::abs(ToneGain(24000, 44100, 3000) - 1) < 0.06);
+    // Tones above the output Nyquist frequency are attenuated by at least 40 dB instead of aliasing
+    CHECK(ToneGain(24000, 16000, 10000) < 0.01);
+    CHECK(ToneGain(48000, 16000, 12000) < 0.01);
+}
+
+static void TestSameRate() {
+    PolyphaseResampler resampler;
+    resampler.Configure(16000, 16000);
+    auto input = MakeSine(16000, 440, 8000, 320);
+    std::vector<int16_t> output;
+    resampler.Process(input.data(), input.size(), output);
+    CHECK(output == input);
+}
+
+int main() {
+    TestOutputCount(24000, 16000);
+    TestOutputCount(16000, 24000);
+    TestOutputCount(24000, 44100);
+    TestOutputCount(48000, 16000);
+    TestResponse();
+    TestSameRate();
+    return TEST_RESULT();
+}
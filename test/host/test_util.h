@@ -0,0 +1,36 @@
+#ifndef TEST_UTIL_H
+#define TEST_UTIL_H
+
+#include <cmath>
+#include <cstdio>
+#include <cstdint>
+#include <vector>
+
+static int test_failures = 0;
+
+#define CHECK(condition) do { \
+    if (!(condition)) { \
+        printf("%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #condition); \
+        test_failures++; \
+    } \
+} while (0)
+
+#define TEST_RESULT() (test_failures == 0 ? 0 : 1)
+
+static inline std::vector<int16_t> MakeSine(int sample_rate, double frequency, double amplitude, size_t samples) {
+    std::vector<int16_t> pcm(samples);
+    for (size_t i = 0; i < samples; i++) {
+        pcm[i] = static_cast<int16_t>(lround(amplitude * sin(2 * M_PI * frequency * i / sample_rate)));
+    }
+    return pcm;
+}
+
+static inline double Rms(const int16_t* pcm, size_t samples) {
+    double sum = 0;
+    for (size_t i = 0; i < samples; i++) {
+        sum += double(pcm[i]) * pcm[i];
+    }
+    return samples > 0 ? sqrt(sum / samples) : 0;
+}
+
+#endif // TEST_UTIL_H